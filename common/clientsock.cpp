@@ -28,13 +28,17 @@
 #include <unistd.h>
 #include <limits.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <linux/un.h>
+#include <algorithm>
 
 #include "clientsock.h"
 #include "hdcpdef.h"
 #include "socketdata.h"
 
-LocalClientSocket::LocalClientSocket(void)
+LocalClientSocket::LocalClientSocket(void) :
+                            m_ReadOffset(0),
+                            m_ReadCount(0)
 {
 }
 
@@ -125,6 +129,7 @@ int32_t LocalClientSocket::SendMessage(const SocketData& req)
 }
 
 int32_t LocalClientSocket::SendSrmData(
+                                const SocketData& req,
                                 const uint8_t *data,
                                 const int32_t dataSz)
 {
@@ -142,7 +147,13 @@ int32_t LocalClientSocket::SendSrmData(
         return EMSGSIZE;
     }
 
-    int32_t ret = WriteData(m_Fd, data, dataSz);
+    struct iovec iov[] =
+    {
+        {const_cast<uint8_t *>(&req.Bytes), sizeof(req)},
+        {const_cast<uint8_t *>(data), static_cast<size_t>(dataSz)}
+    };
+
+    int32_t ret = WriteDataV(m_Fd, iov, sizeof(iov) / sizeof(iov[0]));
 
     HDCP_FUNCTION_EXIT(ret);
     return ret;
@@ -167,7 +178,7 @@ int32_t LocalClientSocket::ReceiveKsvList(
     }
 
     // Get the data
-    int32_t ret = ReadData(m_Fd, ksvList, ksvCount * KSV_SIZE);
+    int32_t ret = ReceiveData(ksvList, ksvCount * KSV_SIZE);
 
     HDCP_FUNCTION_EXIT(ret);
     return ret;
@@ -181,8 +192,62 @@ int32_t LocalClientSocket::GetMessage(SocketData& rsp)
             sizeof(rsp) <= SSIZE_MAX,
             "response size is greater than read() can handle!");
 
-    int32_t ret = ReadData(m_Fd, &rsp.Bytes, sizeof(rsp));
+    int32_t ret = ReceiveData(&rsp.Bytes, sizeof(rsp));
 
     HDCP_FUNCTION_EXIT(ret);
     return ret;
 }
+
+int32_t LocalClientSocket::ReceiveData(uint8_t *data, const uint32_t dataSz)
+{
+    HDCP_FUNCTION_ENTER;
+
+    CHECK_PARAM_NULL(data, EINVAL);
+
+    // Whatever the last read brought in ahead goes first
+    uint32_t offset = std::min(dataSz, m_ReadCount);
+    memcpy(data, &m_ReadBuffer[m_ReadOffset], offset);
+    m_ReadOffset    += offset;
+    m_ReadCount     -= offset;
+
+    while (offset < dataSz)
+    {
+        // The read buffer is empty here, so it can start over
+        struct iovec iov[] =
+        {
+            {&data[offset], dataSz - offset},
+            {m_ReadBuffer, sizeof(m_ReadBuffer)}
+        };
+
+        ssize_t count = readv(m_Fd, iov, sizeof(iov) / sizeof(iov[0]));
+        if (-1 == count)
+        {
+            if ((EINTR == errno) || (EAGAIN == errno))
+            {
+                continue;
+            }
+
+            HDCP_ASSERTMESSAGE("Failed to read! Err: %s", strerror(errno));
+            return errno;
+        }
+
+        if (0 == count)
+        {
+            HDCP_NORMALMESSAGE("Success to read, but the content is empty!");
+            return ENOTCONN;
+        }
+
+        if (static_cast<size_t>(count) <= iov[0].iov_len)
+        {
+            offset += count;
+            continue;
+        }
+
+        offset          = dataSz;
+        m_ReadOffset    = 0;
+        m_ReadCount     = count - iov[0].iov_len;
+    }
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return SUCCESS;
+}
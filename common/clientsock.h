@@ -70,16 +70,23 @@ public:
     int32_t SendMessage(const SocketData& req);
 
     ///////////////////////////////////////////////////////////////////////////
-    /// \brief Send SRM data the server process via this socket.
+    /// \brief Send a request immediately followed by SRM data to the server
+    ///        process via this socket, both in a single write.
     ///
+    /// \param[in]  req     SocketData packet to send to the server
     /// \param[in]  data    Buffer containing SRM message
     /// \param[in]  dataSz  Size of the SRM message
     /// \return     SUCCESS or errno otherwise
     ///////////////////////////////////////////////////////////////////////////
-    int32_t SendSrmData(const uint8_t *data, const int32_t dataSz);
+    int32_t SendSrmData(
+                    const SocketData& req,
+                    const uint8_t *data,
+                    const int32_t dataSz);
 
     ///////////////////////////////////////////////////////////////////////////
     /// \brief Receive KsvList data from the socket.
+    /// \par   The list usually arrived with its response already, in which
+    ///        case it is only copied out of the read buffer.
     ///
     /// \param[in]  ksvList    Buffer containing ksvList.
     /// \param[in]  ksvCount   Number of ksv in ksvList (1 ksv = 5 bytes).
@@ -95,6 +102,26 @@ public:
     /// \return     SUCCESS or errno otherwise
     ///////////////////////////////////////////////////////////////////////////
     int32_t GetMessage(SocketData& rsp);
+
+private:
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief Take a specific amount of data from the read buffer, reading
+    ///        from the socket whatever it lacks.
+    /// \par   Each read also fills the read buffer with as much of the data
+    ///        that follows as is already there, so that a response and its
+    ///        ksvList come in with a single syscall.
+    ///
+    /// \param[out] data    Pointer to the buffer to fill with data
+    /// \param[in]  dataSz  Number of bytes to read
+    /// \return     SUCCESS or errno otherwise
+    ///////////////////////////////////////////////////////////////////////////
+    int32_t ReceiveData(uint8_t *data, const uint32_t dataSz);
+
+private:
+    // Only the thread receiving from the daemon uses the read buffer
+    uint8_t     m_ReadBuffer[MAX_KSV_COUNT * KSV_SIZE];
+    uint32_t    m_ReadOffset;
+    uint32_t    m_ReadCount;
 };
 
 #endif  // __HDCP_CLIENTSOCK_H__
@@ -272,3 +272,55 @@ int32_t GenericStreamSocket::WriteData(
     HDCP_FUNCTION_EXIT(SUCCESS);
     return SUCCESS;
 }
+
+int32_t GenericStreamSocket::WriteDataV(
+                                const int32_t fd,
+                                struct iovec *iov,
+                                const int32_t iovCnt)
+{
+    HDCP_FUNCTION_ENTER;
+
+    if ((-1 == fd)      ||
+        (nullptr == iov))
+    {
+        return EINVAL;
+    }
+
+    struct msghdr msg   = {};
+    msg.msg_iov         = iov;
+    msg.msg_iovlen      = iovCnt;
+
+    while (msg.msg_iovlen > 0)
+    {
+        ssize_t count = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (-1 == count)
+        {
+            if ((EINTR == errno) || (EAGAIN == errno))
+            {
+                continue;
+            }
+
+            HDCP_ASSERTMESSAGE("Failed to send! Err: %s", strerror(errno));
+            return errno;
+        }
+
+        // Skip what went out already and carry on with the rest
+        while ((msg.msg_iovlen > 0) &&
+            (static_cast<size_t>(count) >= msg.msg_iov->iov_len))
+        {
+            count -= msg.msg_iov->iov_len;
+            ++msg.msg_iov;
+            --msg.msg_iovlen;
+        }
+
+        if (msg.msg_iovlen > 0)
+        {
+            msg.msg_iov->iov_base =
+                        static_cast<uint8_t *>(msg.msg_iov->iov_base) + count;
+            msg.msg_iov->iov_len -= count;
+        }
+    }
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return SUCCESS;
+}
@@ -28,10 +28,12 @@
 #define __HDCP_GENSOCK_H__
 
 #include <string>
+#include <sys/uio.h>
 
 #include "hdcpdef.h"
 
-#define MAX_SRM_DATA_SZ         (6 * 1024)
+// Whole SRM of either format, with all its generations
+#define MAX_SRM_DATA_SZ         (128 * 1024)
 
 class GenericStreamSocket
 {
@@ -102,6 +104,20 @@ protected:
                     const uint8_t *data,
                     const int32_t dataSz);
 
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Write several buffers back to back in a single syscall, with
+    ///         handling of signals and partial writes.
+    ///
+    /// \param[in]  fd      FileDescriptor used for the communication
+    /// \param[in]  iov     Buffers to write, consumed as they are written
+    /// \param[in]  iovCnt  Number of buffers in iov
+    /// \return     SUCCESS or errno
+    ///////////////////////////////////////////////////////////////////////////
+    int32_t WriteDataV(
+                    const int32_t fd,
+                    struct iovec *iov,
+                    const int32_t iovCnt);
+
 protected:
     int32_t m_Domain;
     int32_t m_Type;
@@ -108,6 +108,7 @@ int32_t LocalServerSocket::SendResponse(const SocketData& rsp, const int32_t fd)
 }
 
 int32_t LocalServerSocket::SendKsvListData(
+                                const SocketData& rsp,
                                 const uint8_t *data,
                                 const int32_t dataSz,
                                 const int32_t fd)
@@ -126,7 +127,13 @@ int32_t LocalServerSocket::SendKsvListData(
         return EMSGSIZE;
     }
 
-    int32_t ret = WriteData(fd, data, dataSz);
+    struct iovec iov[] =
+    {
+        {const_cast<uint8_t *>(&rsp.Bytes), sizeof(rsp)},
+        {const_cast<uint8_t *>(data), static_cast<size_t>(dataSz)}
+    };
+
+    int32_t ret = WriteDataV(fd, iov, sizeof(iov) / sizeof(iov[0]));
 
     HDCP_FUNCTION_EXIT(ret);
     return ret;
@@ -368,19 +375,21 @@ int32_t LocalServerSocket::GetTask(SocketData& req, int32_t& appId)
                     HDCP_ASSERTMESSAGE("Failed to check the status of a fd!");
                 }
 
-                req.Size       = sizeof(SocketData);
-                req.Command    = HDCP_API_DESTROY;
-                close(m_SessionFdArray[i].fd);
-            }
+                // The fd is shared by all sessions of the app, so leave
+                // closing it to the daemon once it has released them
+                req             = {};
+                req.Size        = sizeof(SocketData);
+                req.Command     = HDCP_API_DISCONNECT;
+                req.SessionId   = SESSION_ID_NONE;
 
-            // There are a couple of API's that would cause us to free up the
-            // spot in our list of fd's
-            if ((HDCP_API_CREATE_CALLBACK == req.Command)   ||
-                (HDCP_API_DESTROY == req.Command))
-            {
                 m_SessionFdArray[i] = {};
                 m_SessionFdArray[i].fd = -1;
             }
+            else if (HDCP_API_DISCONNECT == req.Command)
+            {
+                // Only we may tell the daemon a connection is gone
+                req.Command = HDCP_API_ILLEGAL;
+            }
 
             // Found an event, so stop searching
             break;
@@ -395,6 +404,27 @@ int32_t LocalServerSocket::GetTask(SocketData& req, int32_t& appId)
     return SUCCESS;
 }
 
+int32_t LocalServerSocket::RemoveConnection(const int32_t appId)
+{
+    HDCP_FUNCTION_ENTER;
+
+    // The listener is never handed out as a connection
+    for (uint32_t i = 1; i < SESSION_COUNT_MAX; ++i)
+    {
+        if (appId == m_SessionFdArray[i].fd)
+        {
+            m_SessionFdArray[i] = {};
+            m_SessionFdArray[i].fd = -1;
+
+            HDCP_FUNCTION_EXIT(SUCCESS);
+            return SUCCESS;
+        }
+    }
+
+    HDCP_FUNCTION_EXIT(ENOENT);
+    return ENOENT;
+}
+
 int32_t LocalServerSocket::GetSrmData(
                             uint8_t *data,
                             const int32_t dataSz,
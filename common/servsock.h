@@ -35,10 +35,10 @@
 
 #define SESSION_COUNT_MAX       6
 
-// The number of pending connections allowed should account for the total
-// number of allowed sessions as well as the same number of potential requests
-// to register callbacks.
-#define SERV_SOCKET_BACKLOG     (SESSION_COUNT_MAX * 2)
+// Each app carries all of its sessions and events over a single connection,
+// so the number of pending connections allowed only has to account for the
+// total number of allowed connections.
+#define SERV_SOCKET_BACKLOG     SESSION_COUNT_MAX
 
 struct SocketData;
 
@@ -96,14 +96,17 @@ public:
 
     ///////////////////////////////////////////////////////////////////////////
     /// \brief SendKsvListData
-    /// \par   Send a ksvList to the client process via this socket.
+    /// \par   Send a response immediately followed by its ksvList to the
+    ///        client process via this socket, both in a single write.
     ///
+    /// \param[in]  rsp     SocketData structure containing our response
     /// \param[in]  data    KsvList data
     /// \param[in]  dataSz  Size of ksvList in bytes
     /// \param[in]  appId   FileDescriptor used for the communication
     /// \return     SUCCESS or errno otherwise
     ///////////////////////////////////////////////////////////////////////////
     int32_t SendKsvListData(
+                        const SocketData& rsp,
                         const uint8_t *data,
                         const int32_t dataSz,
                         const int32_t appId);
@@ -116,9 +119,22 @@ public:
     /// \param[in]  req     SocketData structure containing the request
     /// \param[in]  appId   FileDescriptor used for the communication
     /// \return     SUCCESS or errno otherwise
+    ///
+    /// A connection that went away is reported as a HDCP_API_DISCONNECT
+    /// request. The fd is no longer polled, but the caller has to close it.
     ///////////////////////////////////////////////////////////////////////////
     int32_t GetTask(SocketData& req, int32_t& appId);
 
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  RemoveConnection
+    /// \par    Stop polling a connection that can't be trusted anymore.
+    ///         GetTask won't report it, the caller has to close the fd.
+    ///
+    /// \param[in]  appId   FileDescriptor used for the communication
+    /// \return     SUCCESS or ENOENT if the fd isn't polled
+    ///////////////////////////////////////////////////////////////////////////
+    int32_t RemoveConnection(const int32_t appId);
+
 private:
     ///////////////////////////////////////////////////////////////////////////
     /// \brief  GetRequest
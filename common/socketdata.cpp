@@ -36,14 +36,21 @@ SocketData::SocketData(void) :
     Size(sizeof(SocketData)),
     Command(HDCP_API_ILLEGAL),
     Status(HDCP_STATUS_ERROR_INTERNAL),
+    SessionId(SESSION_ID_NONE),
+    StatusVersion(STATUS_VERSION_NONE),
+    RevokedKsvCount(0),
     PortCount(0),
-    SrmOrKsvListDataSz(0)
+    SrmOrKsvListDataSz(0),
+    StatusMask(0),
+    TimeoutMs(0)
 {
     uint32_t i = 0;
 
     for (i = 0; i < NUM_PHYSICAL_PORTS_MAX; ++i) {
         Ports[i].Id     = 0;
         Ports[i].status = 0;
+        Levels[i]       = HDCP_LEVEL0;
+        PortResults[i]  = HDCP_STATUS_ERROR_INTERNAL;
     }
 }
 
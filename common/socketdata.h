@@ -43,6 +43,19 @@
 #endif
 #define HDCP_SDK_SOCKET_PATH        HDCP_DIR_BASE ".sdk_socket"
 
+// All sessions of a process share one connection to the daemon, every message
+// on it names the session it belongs to. 0 is not a valid session id, events
+// broadcast to every session of the connection carry it.
+#define SESSION_ID_NONE             0
+#define CONNECTION_SESSION_MAX      32
+
+// Every change of a port status bumps the status version of the daemon, which
+// is reported to every connection as a REPORTSTATUS, with PORT_EVENT_NONE if
+// there is no event to report. Status responses carry the version the daemon
+// had before it looked at the ports, so the SDK can cache them until it gets
+// to know of a later change. 0 is never a valid version.
+#define STATUS_VERSION_NONE         0
+
 typedef enum _HDCP_API_TYPE
 {
     HDCP_API_INVALID,
@@ -60,6 +73,11 @@ typedef enum _HDCP_API_TYPE
     HDCP_API_CREATE_CALLBACK,
     HDCP_API_SET_PROTECTION_LEVEL,
     HDCP_API_CONFIG,
+    HDCP_API_WAIT_STATUS,
+    HDCP_API_SET_PROTECTION_LEVEL_BATCH,
+    HDCP_API_GETSTATUS_BATCH,
+    HDCP_API_SENDSRMDATA_STREAM,    // The SRM data follows the request
+    HDCP_API_DISCONNECT,        // Daemon internal, the connection went away
     HDCP_API_ILLEGAL
 } HDCP_API_TYPE;
 
@@ -77,9 +95,12 @@ public:
             uint32_t        Size;
             HDCP_API_TYPE   Command;
             HDCP_STATUS     Status;
+            uint32_t        SessionId;
+            uint32_t        StatusVersion;
 
             uint8_t         KsvCount;   // Number of KSV in topology
             uint8_t         Depth;      // Depth of topology
+            uint8_t         RevokedKsvCount; // Number of KSV found in SRM
             bool            isType1Capable; // Port whether support HDCP2.2
             union
             {
@@ -95,6 +116,15 @@ public:
             HDCP_CONFIG     Config;
 
             uint8_t         Level;
+
+            // Bits of SinglePort.status HDCP_API_WAIT_STATUS waits for
+            PORT_STATUS     StatusMask;
+            uint32_t        TimeoutMs;
+
+            // Per port levels and results of the batch commands, indexed
+            // like Ports
+            uint8_t         Levels[NUM_PHYSICAL_PORTS_MAX];
+            HDCP_STATUS     PortResults[NUM_PHYSICAL_PORTS_MAX];
         };
     };
 };
@@ -24,6 +24,7 @@
 //! \brief
 //!
 
+#include <algorithm>
 #include <list>
 #include <new>
 #include <stdio.h>
@@ -50,15 +51,36 @@
 #include "xf86drmMode.h"
 
 HdcpDaemon::HdcpDaemon(void) :
+    m_NextAppId(APP_ID_INTERNAL + 1),
+    m_StatusVersion(STATUS_VERSION_NONE + 1),
+    m_NextWaiterId(0),
+    m_IsStatusChanged(false),
+    m_IsStopping(false),
+    m_IsWaitThreadRunning(false),
     m_IsValid(false)
 {
     HDCP_FUNCTION_ENTER;
 
-    if (SUCCESS == pthread_mutex_init(&m_CallBackListMutex, nullptr))
+    if (SUCCESS != pthread_mutex_init(&m_ConnectionMutex, nullptr))
     {
-        m_IsValid = true;
+        return;
+    }
+
+    // Wait deadlines are computed from CLOCK_MONOTONIC, the CV has to match
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    int32_t ret = pthread_cond_init(&m_StatusCV, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (SUCCESS != ret)
+    {
+        DESTROY_LOCK(&m_ConnectionMutex);
+        return;
     }
 
+    m_IsValid = true;
+
     HDCP_FUNCTION_EXIT(SUCCESS);
 }
 
@@ -72,7 +94,17 @@ HdcpDaemon::~HdcpDaemon(void)
         return;
     }
 
-    ACQUIRE_LOCK(&m_CallBackListMutex);
+    if (m_IsWaitThreadRunning)
+    {
+        ACQUIRE_LOCK(&m_ConnectionMutex);
+        m_IsStopping = true;
+        pthread_cond_signal(&m_StatusCV);
+        RELEASE_LOCK(&m_ConnectionMutex);
+
+        pthread_join(m_WaitThread, nullptr);
+    }
+
+    ACQUIRE_LOCK(&m_ConnectionMutex);
     while (!m_CallBackList.empty())
     {
         int32_t fd = m_CallBackList.front();
@@ -85,9 +117,144 @@ HdcpDaemon::~HdcpDaemon(void)
         }
         m_CallBackList.pop_front();
     }
-    RELEASE_LOCK(&m_CallBackListMutex);
+    RELEASE_LOCK(&m_ConnectionMutex);
+
+    DESTROY_CV(&m_StatusCV);
+    DESTROY_LOCK(&m_ConnectionMutex);
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
+
+uint32_t HdcpDaemon::GetAppId(int32_t fd, uint32_t sessionId)
+{
+    HDCP_FUNCTION_ENTER;
+
+    if (SESSION_ID_NONE == sessionId)
+    {
+        return APP_ID_INTERNAL;
+    }
+
+    uint32_t appId          = APP_ID_INTERNAL;
+    uint32_t sessionCount   = 0;
+
+    ACQUIRE_LOCK(&m_ConnectionMutex);
+
+    // There are only a few sessions per connection and a few connections
+    for (auto& entry : m_AppSessions)
+    {
+        if (fd != entry.second.fd)
+        {
+            continue;
+        }
+
+        if (sessionId == entry.second.sessionId)
+        {
+            appId = entry.first;
+            break;
+        }
+
+        ++sessionCount;
+    }
+
+    if (APP_ID_INTERNAL == appId && sessionCount < CONNECTION_SESSION_MAX)
+    {
+        // App ids are never reused, so a late completion for a session that
+        // has gone can't reach a new one
+        appId = m_NextAppId++;
+        m_AppSessions[appId] = {fd, sessionId};
+    }
+
+    RELEASE_LOCK(&m_ConnectionMutex);
+
+    if (APP_ID_INTERNAL == appId)
+    {
+        HDCP_ASSERTMESSAGE("Too many sessions on connection %d!", fd);
+    }
+
+    HDCP_FUNCTION_EXIT(appId);
+    return appId;
+}
+
+void HdcpDaemon::ReleaseSession(int32_t fd, uint32_t sessionId)
+{
+    HDCP_FUNCTION_ENTER;
+
+    uint32_t appId = APP_ID_INTERNAL;
+
+    ACQUIRE_LOCK(&m_ConnectionMutex);
+
+    // Nobody is left to answer
+    m_StatusWaiters.remove_if([=](const StatusWaiter& waiter)
+    {
+        return (fd == waiter.fd) && (sessionId == waiter.sessionId);
+    });
+
+    for (auto entry = m_AppSessions.begin();
+        entry != m_AppSessions.end();
+        ++entry)
+    {
+        if (fd == entry->second.fd && sessionId == entry->second.sessionId)
+        {
+            appId = entry->first;
+            m_PendingBatches.erase(appId);
+            m_AppSessions.erase(entry);
+            break;
+        }
+    }
+    RELEASE_LOCK(&m_ConnectionMutex);
+
+    // Sessions that never enabled a port were never registered
+    if (APP_ID_INTERNAL != appId)
+    {
+        PortManagerHandleAppExit(appId);
+    }
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
+
+void HdcpDaemon::ReleaseConnection(int32_t fd)
+{
+    HDCP_FUNCTION_ENTER;
+
+    std::list<uint32_t> appIds;
+
+    ACQUIRE_LOCK(&m_ConnectionMutex);
+
+    auto entry = m_AppSessions.begin();
+    while (entry != m_AppSessions.end())
+    {
+        if (fd == entry->second.fd)
+        {
+            appIds.push_back(entry->first);
+            m_PendingBatches.erase(entry->first);
+            entry = m_AppSessions.erase(entry);
+            continue;
+        }
+        ++entry;
+    }
+
+    m_CallBackList.remove(fd);
+    m_StatusWaiters.remove_if([=](const StatusWaiter& waiter)
+    {
+        return fd == waiter.fd;
+    });
+
+    // Nobody can write to the fd anymore, so it is safe to hand it back
+    if (SUCCESS != close(fd))
+    {
+        HDCP_WARNMESSAGE(
+                "Failed to close connection %d! Err: %s",
+                fd,
+                strerror(errno));
+    }
+
+    RELEASE_LOCK(&m_ConnectionMutex);
 
-    DESTROY_LOCK(&m_CallBackListMutex);
+    // PortManager may call back into us, so don't hold the lock
+    for (auto appId : appIds)
+    {
+        PortManagerHandleAppExit(appId);
+    }
 
     HDCP_FUNCTION_EXIT(SUCCESS);
 }
@@ -111,13 +278,39 @@ int32_t HdcpDaemon::Init(void)
         return ret;
     }
 
+    ret = pthread_create(&m_WaitThread, nullptr, WaitManager, this);
+    if (SUCCESS != ret)
+    {
+        HDCP_ASSERTMESSAGE("Failed to create wait thread.");
+        return ret;
+    }
+    m_IsWaitThreadRunning = true;
+
     HDCP_FUNCTION_EXIT(SUCCESS);
     return SUCCESS;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Fail a batch request as a whole
+///
+/// \param[in/out]  data    Batch request to answer
+/// \param[in]      status  Status of the request and result of every port
+/// \return         Nothing
+///////////////////////////////////////////////////////////////////////////////
+static void FailBatch(SocketData& data, HDCP_STATUS status)
+{
+    data.Status = status;
+    for (uint32_t i = 0;
+        (i < data.PortCount) && (i < NUM_PHYSICAL_PORTS_MAX);
+        ++i)
+    {
+        data.PortResults[i] = status;
+    }
+}
+
 void HdcpDaemon::DispatchCommand(
                             SocketData& data,
-                            int32_t appId,
+                            int32_t fd,
                             bool& sendResponse)
 {
     HDCP_FUNCTION_ENTER;
@@ -139,7 +332,13 @@ void HdcpDaemon::DispatchCommand(
 
         case HDCP_API_DESTROY:
             HDCP_NORMALMESSAGE("Daemon received 'Destroy' request");
-            PortManagerHandleAppExit(appId);
+            ReleaseSession(fd, data.SessionId);
+            sendResponse = false;
+            break;
+
+        case HDCP_API_DISCONNECT:
+            HDCP_NORMALMESSAGE("Daemon lost connection %d", fd);
+            ReleaseConnection(fd);
             sendResponse = false;
             break;
 
@@ -149,30 +348,62 @@ void HdcpDaemon::DispatchCommand(
             // has gone wrong in our socket interface and we should remove
             // prior instance.
             // If it doesn't exist, then the remove call is harmless.
-            ACQUIRE_LOCK(&m_CallBackListMutex);
-            m_CallBackList.remove(appId);
-            m_CallBackList.push_back(appId);
-            RELEASE_LOCK(&m_CallBackListMutex);
+            ACQUIRE_LOCK(&m_ConnectionMutex);
+            m_CallBackList.remove(fd);
+            m_CallBackList.push_back(fd);
+            RELEASE_LOCK(&m_ConnectionMutex);
             sendResponse = false;
             break;
 
         case HDCP_API_SET_PROTECTION_LEVEL:
+        {
             HDCP_NORMALMESSAGE("Daemon received 'SetProtectionLevel' request");
-            SetProtectionLevel(data,appId);
+            uint32_t appId = GetAppId(fd, data.SessionId);
+            if (APP_ID_INTERNAL == appId)
+            {
+                data.Status = HDCP_STATUS_ERROR_INVALID_PARAMETER;
+                break;
+            }
+            SetProtectionLevel(data, appId, sendResponse);
+            break;
+        }
+
+        case HDCP_API_SET_PROTECTION_LEVEL_BATCH:
+        {
+            HDCP_NORMALMESSAGE(
+                    "Daemon received 'SetProtectionLevelBatch' request");
+            uint32_t appId = GetAppId(fd, data.SessionId);
+            if (APP_ID_INTERNAL == appId)
+            {
+                FailBatch(data, HDCP_STATUS_ERROR_INVALID_PARAMETER);
+                break;
+            }
+            SetProtectionLevelBatch(data, appId, sendResponse);
             break;
+        }
 
         case HDCP_API_GETSTATUS:
             HDCP_NORMALMESSAGE("Daemon received 'GetStatus' request");
             GetStatus(data);
             break;
 
+        case HDCP_API_GETSTATUS_BATCH:
+            HDCP_NORMALMESSAGE("Daemon received 'GetStatusBatch' request");
+            GetStatusBatch(data);
+            break;
+
+        case HDCP_API_WAIT_STATUS:
+            HDCP_NORMALMESSAGE("Daemon received 'WaitStatus' request");
+            WaitStatus(data, fd, sendResponse);
+            break;
+
         case HDCP_API_GETKSVLIST:
             HDCP_NORMALMESSAGE("daemon received 'GetKsvList' request");
             // No need to send response after success function call,
             // since this function already done the communication itself.
             // For unsuccess call, no response sent as break out,
             // need do it after this function call.
-            GetKsvList(data, appId);
+            GetKsvList(data, fd);
             if (HDCP_STATUS_SUCCESSFUL == data.Status)
             {
                 sendResponse = false;
@@ -181,7 +412,12 @@ void HdcpDaemon::DispatchCommand(
 
         case HDCP_API_SENDSRMDATA:
             HDCP_NORMALMESSAGE("Daemon received 'SendSrmData' request");
-            SendSRMData(data, appId);
+            SendSRMData(data, fd);
+            break;
+
+        case HDCP_API_SENDSRMDATA_STREAM:
+            HDCP_NORMALMESSAGE("Daemon received 'SendSrmDataStream' request");
+            SendSRMDataStream(data, fd, sendResponse);
             break;
 
         case HDCP_API_GETSRMVERSION:
@@ -217,8 +453,8 @@ void HdcpDaemon::MessageResponseLoop(void)
         SocketData data;
 
         // No need to zero-out data, it's done in the SocketData constructor
-        int32_t appId  = -1;
-        int32_t sts = m_SdkSocket.GetTask(data, appId);
+        int32_t fd  = -1;
+        int32_t sts = m_SdkSocket.GetTask(data, fd);
         if (SUCCESS != sts)
         {
             if (ECANCELED == sts)
@@ -242,20 +478,22 @@ void HdcpDaemon::MessageResponseLoop(void)
         }
         else
         {
-            DispatchCommand(data, appId, sendResponse);
+            DispatchCommand(data, fd, sendResponse);
         }
 
         if (sendResponse)
         {
             // The protocol requires that the packet sent back match the request
-            // in size.
-            sts = m_SdkSocket.SendResponse(data, appId);
+            // in size. It still carries the session id of the request.
+            ACQUIRE_LOCK(&m_ConnectionMutex);
+            sts = m_SdkSocket.SendResponse(data, fd);
+            RELEASE_LOCK(&m_ConnectionMutex);
+
             if (SUCCESS != sts)
             {
+                // If we can't communicate with the app, the connection is
+                // gone and will be reported as such by GetTask
                 HDCP_ASSERTMESSAGE("SendResponse failed. %d", data.Status);
-
-                // If we can't communicate with the app, destroy the connection
-                PortManagerHandleAppExit(appId);
             }
         }
     } while (true);
@@ -269,40 +507,39 @@ void HdcpDaemon::ReportStatus(PORT_EVENT event, uint32_t portId)
 
     data.Size               = sizeof(data);
     data.Command            = HDCP_API_REPORTSTATUS;
+    data.SessionId          = SESSION_ID_NONE;
     data.PortCount          = 1;
     data.SinglePort.Event   = event;
     data.SinglePort.Id      = portId;
 
-    ACQUIRE_LOCK(&m_CallBackListMutex);
+    ACQUIRE_LOCK(&m_ConnectionMutex);
 
-    auto next = m_CallBackList.begin();
-    while (next != m_CallBackList.end())
+    // Bump and report in one go, so that no response stamped with the new
+    // version can get ahead of the report on a connection
+    uint32_t version = m_StatusVersion.load(std::memory_order_relaxed) + 1;
+    if (STATUS_VERSION_NONE == version)
     {
-        auto fd = next;
+        ++version;
+    }
+    m_StatusVersion.store(version, std::memory_order_release);
+    data.StatusVersion = version;
+
+    // The parked waits may be done now
+    m_IsStatusChanged = true;
+    pthread_cond_signal(&m_StatusCV);
 
-        int32_t sts = m_SdkSocket.SendResponse(data, *fd);
+    for (auto fd : m_CallBackList)
+    {
+        // If we failed then the connection is bad or gone. The message loop
+        // gets to know and releases it, it still polls the fd.
+        int32_t sts = m_SdkSocket.SendResponse(data, fd);
         if (SUCCESS != sts)
         {
-            // If we failed then the connection is bad or gone and
-            // we should just go ahead and clean it up
-            sts = close(*fd);
-            if (SUCCESS != sts)
-            {
-                HDCP_WARNMESSAGE(
-                        "Failed to close fd of a bad socket %d! Err: %s",
-                        *fd,
-                        strerror(errno));
-            }
-
-            HDCP_VERBOSEMESSAGE("Remove unavailable callback socket from list");
-            next = m_CallBackList.erase(fd);
-            continue;
+            HDCP_WARNMESSAGE("Failed to report status on connection %d", fd);
         }
-
-        next++;
     }
 
-    RELEASE_LOCK(&m_CallBackListMutex);
+    RELEASE_LOCK(&m_ConnectionMutex);
 
     HDCP_FUNCTION_EXIT(SUCCESS);
 }
@@ -311,6 +548,9 @@ void HdcpDaemon::EnumeratePorts(SocketData& data)
 {
     HDCP_FUNCTION_ENTER;
 
+    // Any change from here on is reported after this version
+    data.StatusVersion = m_StatusVersion.load(std::memory_order_acquire);
+
     int32_t sts = PortManagerEnumeratePorts(data.Ports, data.PortCount);
     if (SUCCESS != sts)
     {
@@ -325,7 +565,29 @@ void HdcpDaemon::EnumeratePorts(SocketData& data)
     HDCP_FUNCTION_EXIT(SUCCESS);
 }
 
-void HdcpDaemon::SetProtectionLevel(SocketData& data, uint32_t appId)
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Translate the PortManager result of a port request to a status
+///
+/// \param[in]  sts     SUCCESS or errno
+/// \return     HDCP_STATUS reported to the SDK
+///////////////////////////////////////////////////////////////////////////////
+static HDCP_STATUS GetPortResultStatus(int32_t sts)
+{
+    switch (sts)
+    {
+        case SUCCESS:
+            return HDCP_STATUS_SUCCESSFUL;
+        case ENOENT:
+            return HDCP_STATUS_ERROR_NO_DISPLAY;
+        default:
+            return HDCP_STATUS_ERROR_INTERNAL;
+    }
+}
+
+void HdcpDaemon::SetProtectionLevel(
+                            SocketData& data,
+                            uint32_t appId,
+                            bool& sendResponse)
 {
     HDCP_FUNCTION_ENTER;
 
@@ -359,23 +621,213 @@ void HdcpDaemon::SetProtectionLevel(SocketData& data, uint32_t appId)
         return;
     }
 
+    if (EINPROGRESS == sts)
+    {
+        // The port state machine answers once authentication settles
+        HDCP_NORMALMESSAGE("SetProtectionLevel %d is pending", data.Level);
+        sendResponse = false;
+        return;
+    }
+
+    data.Status = GetPortResultStatus(sts);
     if (SUCCESS != sts)
     {
         HDCP_ASSERTMESSAGE("SetProtectionLevel failed!");
-        switch (sts)
+        return;
+    }
+
+    HDCP_NORMALMESSAGE("SetProtectionLevel %d successfully", data.Level);
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
+
+void HdcpDaemon::SetProtectionLevelBatch(
+                            SocketData& data,
+                            uint32_t appId,
+                            bool& sendResponse)
+{
+    HDCP_FUNCTION_ENTER;
+
+    if ((0 == data.PortCount) || (data.PortCount > NUM_PHYSICAL_PORTS_MAX))
+    {
+        FailBatch(data, HDCP_STATUS_ERROR_INVALID_PARAMETER);
+        return;
+    }
+
+    PendingBatch batch  = {};
+    batch.data          = data;
+    batch.pendingPorts  = (1 << data.PortCount) - 1;
+
+    ACQUIRE_LOCK(&m_ConnectionMutex);
+    if (!m_PendingBatches.insert({appId, batch}).second)
+    {
+        RELEASE_LOCK(&m_ConnectionMutex);
+        HDCP_ASSERTMESSAGE("Session %d has a batch pending already!", appId);
+        FailBatch(data, HDCP_STATUS_ERROR_INVALID_PARAMETER);
+        return;
+    }
+    RELEASE_LOCK(&m_ConnectionMutex);
+
+    // From here on the response is sent by whoever settles the last port
+    sendResponse = false;
+
+    for (uint32_t i = 0; i < data.PortCount; ++i)
+    {
+        uint32_t    portId  = data.Ports[i].Id;
+        uint8_t     level   = data.Levels[i];
+        bool        isValid = (portId <= PORT_ID_MAX);
+
+        for (uint32_t j = 0; j < i; ++j)
         {
-            case ENOENT:
-                data.Status = HDCP_STATUS_ERROR_NO_DISPLAY;
-                break;
-            default:
-                data.Status = HDCP_STATUS_ERROR_INTERNAL;
-                break;
+            if (portId == data.Ports[j].Id)
+            {
+                isValid = false;
+            }
+        }
+
+        HDCP_STATUS status = HDCP_STATUS_ERROR_INVALID_PARAMETER;
+        if (isValid && (HDCP_LEVEL1 == level || HDCP_LEVEL2 == level))
+        {
+            int32_t sts = PortManagerEnablePort(portId, appId, level);
+            if (EINPROGRESS == sts)
+            {
+                // The port state machine completes this port
+                continue;
+            }
+            status = GetPortResultStatus(sts);
         }
+        else if (isValid && HDCP_LEVEL0 == level)
+        {
+            status = GetPortResultStatus(
+                                PortManagerDisablePort(portId, appId));
+        }
+        else
+        {
+            HDCP_ASSERTMESSAGE("Invalid port %d or level %d", portId, level);
+        }
+
+        ACQUIRE_LOCK(&m_ConnectionMutex);
+        CompleteBatchPort(appId, i, status);
+        RELEASE_LOCK(&m_ConnectionMutex);
+    }
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
+
+void HdcpDaemon::CompleteBatchPort(
+                            uint32_t appId,
+                            uint32_t index,
+                            HDCP_STATUS status)
+{
+    HDCP_FUNCTION_ENTER;
+
+    auto batch = m_PendingBatches.find(appId);
+    if (m_PendingBatches.end() == batch)
+    {
+        // The session went away in the meantime
         return;
     }
 
-    HDCP_NORMALMESSAGE("SetProtectionLevel %d successfully", data.Level);
+    SocketData& data        = batch->second.data;
+    data.PortResults[index] = status;
+    batch->second.pendingPorts &= ~(1 << index);
+    if (0 != batch->second.pendingPorts)
+    {
+        return;
+    }
+
+    // The first port that failed tells the whole batch failed
     data.Status = HDCP_STATUS_SUCCESSFUL;
+    for (uint32_t i = 0; i < data.PortCount; ++i)
+    {
+        if (HDCP_STATUS_SUCCESSFUL != data.PortResults[i])
+        {
+            data.Status = data.PortResults[i];
+            break;
+        }
+    }
+
+    HDCP_NORMALMESSAGE(
+                "SetProtectionLevelBatch of %d ports completed with %d",
+                data.PortCount,
+                data.Status);
+
+    auto entry = m_AppSessions.find(appId);
+    if ((m_AppSessions.end() != entry) &&
+        (SUCCESS != m_SdkSocket.SendResponse(data, entry->second.fd)))
+    {
+        HDCP_ASSERTMESSAGE("SendResponse failed. %d", data.Status);
+    }
+
+    m_PendingBatches.erase(batch);
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
+
+void HdcpDaemon::CompleteSetProtectionLevel(
+                                    uint32_t appId,
+                                    uint32_t portId,
+                                    uint8_t level,
+                                    int32_t sts)
+{
+    HDCP_FUNCTION_ENTER;
+
+    SocketData data;
+    AppSession app      = {};
+
+    ACQUIRE_LOCK(&m_ConnectionMutex);
+
+    auto batch = m_PendingBatches.find(appId);
+    if (m_PendingBatches.end() != batch)
+    {
+        // A port listed twice was rejected right away, so the first one
+        // still pending is the one that settled
+        const SocketData& request = batch->second.data;
+        for (uint32_t i = 0; i < request.PortCount; ++i)
+        {
+            if ((portId == request.Ports[i].Id) &&
+                (batch->second.pendingPorts & (1 << i)))
+            {
+                CompleteBatchPort(appId, i, GetPortResultStatus(sts));
+                break;
+            }
+        }
+
+        RELEASE_LOCK(&m_ConnectionMutex);
+        HDCP_FUNCTION_EXIT(SUCCESS);
+        return;
+    }
+
+    auto entry = m_AppSessions.find(appId);
+    if (m_AppSessions.end() == entry)
+    {
+        // The session or its whole app went away in the meantime
+        RELEASE_LOCK(&m_ConnectionMutex);
+        HDCP_WARNMESSAGE("No session to complete the request of %d", appId);
+        return;
+    }
+    app = entry->second;
+
+    data.Size           = sizeof(data);
+    data.Command        = HDCP_API_SET_PROTECTION_LEVEL;
+    data.SessionId      = app.sessionId;
+    data.Status         = GetPortResultStatus(sts);
+    data.PortCount      = ONE_PORT;
+    data.SinglePort.Id  = portId;
+    data.Level          = level;
+
+    HDCP_NORMALMESSAGE(
+                "SetProtectionLevel %d on port %d completed with %d",
+                level,
+                portId,
+                data.Status);
+
+    if (SUCCESS != m_SdkSocket.SendResponse(data, app.fd))
+    {
+        HDCP_ASSERTMESSAGE("SendResponse failed. %d", data.Status);
+    }
+
+    RELEASE_LOCK(&m_ConnectionMutex);
 
     HDCP_FUNCTION_EXIT(SUCCESS);
 }
@@ -397,6 +849,9 @@ void HdcpDaemon::GetStatus(SocketData& data)
         return;
     }
 
+    // Any change from here on is reported after this version
+    data.StatusVersion = m_StatusVersion.load(std::memory_order_acquire);
+
     int32_t sts = PortManagerGetStatus(
                         data.SinglePort.Id,
                         &data.SinglePort.status);
@@ -419,39 +874,262 @@ void HdcpDaemon::GetStatus(SocketData& data)
     HDCP_FUNCTION_EXIT(SUCCESS);
 }
 
-void HdcpDaemon::GetKsvList(SocketData& data, uint32_t appId)
+void HdcpDaemon::GetStatusBatch(SocketData& data)
 {
     HDCP_FUNCTION_ENTER;
 
-    // this API expects one and only one port to be spec'd
+    if ((0 == data.PortCount) || (data.PortCount > NUM_PHYSICAL_PORTS_MAX))
+    {
+        FailBatch(data, HDCP_STATUS_ERROR_INVALID_PARAMETER);
+        return;
+    }
+
+    // Any change from here on is reported after this version
+    data.StatusVersion = m_StatusVersion.load(std::memory_order_acquire);
+
+    // The first port that failed tells the whole batch failed
+    data.Status = HDCP_STATUS_SUCCESSFUL;
+    for (uint32_t i = 0; i < data.PortCount; ++i)
+    {
+        if (data.Ports[i].Id > PORT_ID_MAX)
+        {
+            data.PortResults[i] = HDCP_STATUS_ERROR_INVALID_PARAMETER;
+        }
+        else
+        {
+            data.PortResults[i] = GetPortResultStatus(
+                                        PortManagerGetStatus(
+                                                data.Ports[i].Id,
+                                                &data.Ports[i].status));
+        }
+
+        if ((HDCP_STATUS_SUCCESSFUL == data.Status) &&
+            (HDCP_STATUS_SUCCESSFUL != data.PortResults[i]))
+        {
+            data.Status = data.PortResults[i];
+        }
+    }
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
+
+void HdcpDaemon::WaitStatus(
+                        SocketData& data,
+                        int32_t fd,
+                        bool& sendResponse)
+{
+    HDCP_FUNCTION_ENTER;
+
+    // should be one and only one port specified
     if (ONE_PORT != data.PortCount)
     {
-        HDCP_ASSERTMESSAGE("We expect only 1 PORT!");
         data.Status = HDCP_STATUS_ERROR_INVALID_PARAMETER;
         return;
     }
 
     if (data.SinglePort.Id > PORT_ID_MAX)
     {
-        HDCP_ASSERTMESSAGE("Invalid Port ID");
         data.Status = HDCP_STATUS_ERROR_INVALID_PARAMETER;
         return;
     }
-    
-    std::unique_ptr<uint8_t> ksvList(
-                    new (std::nothrow) uint8_t[MAX_KSV_COUNT * KSV_SIZE]);
-    if (nullptr == ksvList.get())
+
+    ACQUIRE_LOCK(&m_ConnectionMutex);
+
+    // The SDK waits for one request per session at a time
+    uint32_t waiterCount = std::count_if(
+                                m_StatusWaiters.begin(),
+                                m_StatusWaiters.end(),
+                                [=](const StatusWaiter& waiter)
+                                {
+                                    return fd == waiter.fd;
+                                });
+    if (waiterCount >= CONNECTION_SESSION_MAX)
     {
-        HDCP_ASSERTMESSAGE("Unable to allocate ksvList buffer");
-        data.Status = HDCP_STATUS_ERROR_INSUFFICIENT_MEMORY;
+        RELEASE_LOCK(&m_ConnectionMutex);
+        HDCP_ASSERTMESSAGE("Too many waits on connection %d!", fd);
+        data.Status = HDCP_STATUS_ERROR_INVALID_PARAMETER;
+        return;
+    }
+
+    StatusWaiter waiter = {};
+    waiter.id           = m_NextWaiterId++;
+    waiter.fd           = fd;
+    waiter.sessionId    = data.SessionId;
+    waiter.portId       = data.SinglePort.Id;
+    waiter.statusMask   = data.StatusMask;
+    waiter.status       = data.SinglePort.status;
+    waiter.deadline     = GetMonotonicTimeMs() + data.TimeoutMs;
+    m_StatusWaiters.push_back(waiter);
+
+    // Have the wait thread check the status right away, it may match already
+    m_IsStatusChanged = true;
+    pthread_cond_signal(&m_StatusCV);
+
+    RELEASE_LOCK(&m_ConnectionMutex);
+
+    sendResponse = false;
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
+
+void *HdcpDaemon::WaitManager(void *data)
+{
+    HDCP_FUNCTION_ENTER;
+
+    static_cast<HdcpDaemon *>(data)->ProcessStatusWaiters();
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return nullptr;
+}
+
+void HdcpDaemon::ProcessStatusWaiters(void)
+{
+    HDCP_FUNCTION_ENTER;
+
+    ACQUIRE_LOCK(&m_ConnectionMutex);
+
+    while (!m_IsStopping)
+    {
+        uint64_t now        = GetMonotonicTimeMs();
+        uint64_t deadline   = UINT64_MAX;
+        for (auto& waiter : m_StatusWaiters)
+        {
+            deadline = std::min(deadline, waiter.deadline);
+        }
+
+        if (!m_IsStatusChanged && deadline > now)
+        {
+            if (UINT64_MAX == deadline)
+            {
+                WAIT_CV(&m_StatusCV, &m_ConnectionMutex);
+            }
+            else
+            {
+                struct timespec ts = {};
+                ts.tv_sec = deadline / 1000;
+                ts.tv_nsec = (deadline % 1000) * 1000000;
+                pthread_cond_timedwait(&m_StatusCV, &m_ConnectionMutex, &ts);
+            }
+            continue;
+        }
+
+        m_IsStatusChanged = false;
+
+        // Only the requests parked by now get answered from the status read
+        // below, the ones parked later flag another round
+        uint64_t lastId     = m_NextWaiterId;
+        uint32_t portMask   = 0;
+        for (auto& waiter : m_StatusWaiters)
+        {
+            portMask |= 1 << waiter.portId;
+        }
+
+        RELEASE_LOCK(&m_ConnectionMutex);
+
+        // Any change from here on is reported after this version
+        uint32_t version = m_StatusVersion.load(std::memory_order_acquire);
+
+        int32_t     results[PORT_ID_MAX + 1]    = {};
+        PORT_STATUS statuses[PORT_ID_MAX + 1]   = {};
+        for (uint32_t portId = 0; portId <= PORT_ID_MAX; ++portId)
+        {
+            if (portMask & (1 << portId))
+            {
+                results[portId] = PortManagerGetStatus(
+                                            portId,
+                                            &statuses[portId]);
+            }
+        }
+
+        ACQUIRE_LOCK(&m_ConnectionMutex);
+
+        now = GetMonotonicTimeMs();
+
+        auto waiter = m_StatusWaiters.begin();
+        while (m_StatusWaiters.end() != waiter)
+        {
+            if (waiter->id >= lastId)
+            {
+                ++waiter;
+                continue;
+            }
+
+            int32_t     sts     = results[waiter->portId];
+            PORT_STATUS status  = statuses[waiter->portId];
+
+            SocketData data;
+            data.Size               = sizeof(data);
+            data.Command            = HDCP_API_WAIT_STATUS;
+            data.SessionId          = waiter->sessionId;
+            data.StatusVersion      = version;
+            data.PortCount          = ONE_PORT;
+            data.SinglePort.Id      = waiter->portId;
+            data.SinglePort.status  = (SUCCESS == sts) ?
+                                        status :
+                                        PORT_STATUS_INVALID;
+
+            if ((SUCCESS == sts) &&
+                (0 == ((status ^ waiter->status) & waiter->statusMask)))
+            {
+                data.Status = HDCP_STATUS_SUCCESSFUL;
+            }
+            else if (ENOENT == sts)
+            {
+                data.Status = HDCP_STATUS_ERROR_NO_DISPLAY;
+            }
+            else if (waiter->deadline <= now)
+            {
+                data.Status = HDCP_STATUS_ERROR_TIMEOUT;
+            }
+            else
+            {
+                // Still waiting, a failure to read the status may be passing
+                ++waiter;
+                continue;
+            }
+
+            if (SUCCESS != m_SdkSocket.SendResponse(data, waiter->fd))
+            {
+                HDCP_ASSERTMESSAGE("SendResponse failed. %d", data.Status);
+            }
+
+            waiter = m_StatusWaiters.erase(waiter);
+        }
+    }
+
+    RELEASE_LOCK(&m_ConnectionMutex);
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
+
+void HdcpDaemon::GetKsvList(SocketData& data, int32_t fd)
+{
+    HDCP_FUNCTION_ENTER;
+
+    // this API expects one and only one port to be spec'd
+    if (ONE_PORT != data.PortCount)
+    {
+        HDCP_ASSERTMESSAGE("We expect only 1 PORT!");
+        data.Status = HDCP_STATUS_ERROR_INVALID_PARAMETER;
         return;
     }
 
+    if (data.SinglePort.Id > PORT_ID_MAX)
+    {
+        HDCP_ASSERTMESSAGE("Invalid Port ID");
+        data.Status = HDCP_STATUS_ERROR_INVALID_PARAMETER;
+        return;
+    }
+
+    // Small enough for the stack, no need to allocate it for each request
+    uint8_t ksvList[MAX_KSV_COUNT * KSV_SIZE];
+
     int32_t sts = PortManagerGetKsvList(
                                 data.SinglePort.Id,
                                 &data.KsvCount,
                                 &data.Depth,
-                                ksvList.get());
+                                ksvList,
+                                &data.RevokedKsvCount);
     if (SUCCESS != sts)
     {
         data.Status = HDCP_STATUS_ERROR_INTERNAL;
@@ -472,21 +1150,19 @@ void HdcpDaemon::GetKsvList(SocketData& data, uint32_t appId)
         return;
     }
     
-    // Send Ksv Count and depth across the socket
+    // Send Ksv Count and depth across the socket, immediately followed by
+    // the Ksv List in the same write. Nothing else may get in between on the
+    // connection, should the write be split.
     data.Status = HDCP_STATUS_SUCCESSFUL;
-    sts = m_SdkSocket.SendResponse(data, appId);
-    if (SUCCESS != sts)
-    {
-        HDCP_ASSERTMESSAGE("SendKsvCount failed");
-        data.Status = HDCP_STATUS_ERROR_INTERNAL;
-        return;
-    }
 
-    // Send Ksv List across the socket
+    ACQUIRE_LOCK(&m_ConnectionMutex);
     sts = m_SdkSocket.SendKsvListData(
-                            ksvList.get(),
-                            data.KsvCount * KSV_SIZE,
-                            appId);
+                                data,
+                                ksvList,
+                                data.KsvCount * KSV_SIZE,
+                                fd);
+    RELEASE_LOCK(&m_ConnectionMutex);
+
     if (SUCCESS != sts)
     {
         HDCP_ASSERTMESSAGE("SendKsvListData failed");
@@ -500,12 +1176,13 @@ void HdcpDaemon::GetKsvList(SocketData& data, uint32_t appId)
     HDCP_FUNCTION_EXIT(SUCCESS);
 }
 
-void HdcpDaemon::SendSRMData(SocketData& data, uint32_t appId)
+void HdcpDaemon::SendSRMData(SocketData& data, int32_t fd)
 {
     HDCP_FUNCTION_ENTER;
 
-    // According to HDCP spec, 5kb limit on 1st generation SRM Message
-    if (data.SrmOrKsvListDataSz > SRM_FIRST_GEN_MAX_SIZE)
+    // The limit of the first generation depends on the format, it is checked
+    // once the SRM is parsed
+    if (data.SrmOrKsvListDataSz > MAX_SRM_DATA_SZ)
     {
         HDCP_ASSERTMESSAGE(
                     "SRM message size %d is too large!",
@@ -525,7 +1202,11 @@ void HdcpDaemon::SendSRMData(SocketData& data, uint32_t appId)
 
     // We received the size successfully, so respond with such
     data.Status = HDCP_STATUS_SUCCESSFUL;
-    int32_t sts = m_SdkSocket.SendResponse(data, appId);
+
+    ACQUIRE_LOCK(&m_ConnectionMutex);
+    int32_t sts = m_SdkSocket.SendResponse(data, fd);
+    RELEASE_LOCK(&m_ConnectionMutex);
+
     if (SUCCESS != sts)
     {
         HDCP_ASSERTMESSAGE("SendResponse failed");
@@ -535,8 +1216,71 @@ void HdcpDaemon::SendSRMData(SocketData& data, uint32_t appId)
 
     // We need the first socket communication to get the size of the srm
     // buffer, then the second communication fills the buffer we allocate
-    // based on that size.
-    sts = m_SdkSocket.GetSrmData(srmData.get(), data.SrmOrKsvListDataSz, appId);
+    // based on that size. The SDK holds back the other sessions of the app
+    // until it has sent the buffer.
+    sts = m_SdkSocket.GetSrmData(srmData.get(), data.SrmOrKsvListDataSz, fd);
+    if (SUCCESS != sts)
+    {
+        HDCP_ASSERTMESSAGE("Failed to receive srm buffer");
+        data.Status = HDCP_STATUS_ERROR_INTERNAL;
+        return;
+    }
+
+    StoreSRMData(data, srmData.get());
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
+
+void HdcpDaemon::SendSRMDataStream(
+                        SocketData& data,
+                        int32_t fd,
+                        bool& sendResponse)
+{
+    HDCP_FUNCTION_ENTER;
+
+    // The SRM data is on its way already. Past the largest one the SDK
+    // sends, there is no telling where the next request starts anymore, so
+    // nothing more is read from that connection.
+    if (data.SrmOrKsvListDataSz > MAX_SRM_DATA_SZ)
+    {
+        HDCP_ASSERTMESSAGE(
+                    "SRM message size %d is too large, dropping connection",
+                    data.SrmOrKsvListDataSz);
+        data.Status = HDCP_STATUS_ERROR_INVALID_PARAMETER;
+
+        ACQUIRE_LOCK(&m_ConnectionMutex);
+        m_SdkSocket.SendResponse(data, fd);
+        RELEASE_LOCK(&m_ConnectionMutex);
+
+        // Stop polling the fd before it is closed and can be handed out again
+        m_SdkSocket.RemoveConnection(fd);
+        ReleaseConnection(fd);
+        sendResponse = false;
+        return;
+    }
+
+    std::unique_ptr<uint8_t[]> srmData(
+                        new (std::nothrow) uint8_t[data.SrmOrKsvListDataSz]);
+    if (nullptr == srmData.get())
+    {
+        HDCP_ASSERTMESSAGE("Unable to allocate srm buffer");
+        data.Status = HDCP_STATUS_ERROR_INSUFFICIENT_MEMORY;
+
+        // The SRM data can't be skipped without a buffer to read it into
+        ACQUIRE_LOCK(&m_ConnectionMutex);
+        m_SdkSocket.SendResponse(data, fd);
+        RELEASE_LOCK(&m_ConnectionMutex);
+
+        m_SdkSocket.RemoveConnection(fd);
+        ReleaseConnection(fd);
+        sendResponse = false;
+        return;
+    }
+
+    int32_t sts = m_SdkSocket.GetSrmData(
+                                    srmData.get(),
+                                    data.SrmOrKsvListDataSz,
+                                    fd);
     if (SUCCESS != sts)
     {
         HDCP_ASSERTMESSAGE("Failed to receive srm buffer");
@@ -544,7 +1288,24 @@ void HdcpDaemon::SendSRMData(SocketData& data, uint32_t appId)
         return;
     }
 
-    sts = StoreSrm(srmData.get(), data.SrmOrKsvListDataSz);
+    // The limit of the first generation depends on the format, it is checked
+    // once the SRM is parsed
+    StoreSRMData(data, srmData.get());
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
+
+void HdcpDaemon::StoreSRMData(SocketData& data, const uint8_t *srmData)
+{
+    HDCP_FUNCTION_ENTER;
+
+    int32_t sts = StoreSrm(srmData, data.SrmOrKsvListDataSz);
+    if (EALREADY == sts)
+    {
+        // Identical to the SRM in use, nothing to store
+        data.Status = HDCP_STATUS_SUCCESSFUL;
+        return;
+    }
     if (SUCCESS != sts)
     {
         switch(sts)
@@ -560,13 +1321,6 @@ void HdcpDaemon::SendSRMData(SocketData& data, uint32_t appId)
         }
         return;
     }
-    
-    sts = PortManagerSendSRMDdata(srmData.get(), data.SrmOrKsvListDataSz);
-    if (SUCCESS != sts)
-    {
-        data.Status = HDCP_STATUS_ERROR_INTERNAL;
-        return;
-    }
 
     data.Status = HDCP_STATUS_SUCCESSFUL;
 
@@ -595,7 +1349,24 @@ void HdcpDaemon::Config(SocketData& data)
 {
     HDCP_FUNCTION_ENTER;
 
-    int32_t sts = SrmConfig(data.Config.disableSrmStorage);
+    int32_t sts = EINVAL;
+    switch (data.Config.type)
+    {
+        case SRM_STORAGE_CONFIG:
+            sts = SrmConfig(data.Config.disableSrmStorage);
+            break;
+        case AUTO_REAUTH_CONFIG:
+            sts = PortManagerConfigAutoReauth(data.Config.enableAutoReauth);
+            break;
+        case DISABLE_LINGER_CONFIG:
+            sts = PortManagerConfigLingerTime(data.Config.disableLingerMs);
+            break;
+        default:
+            HDCP_ASSERTMESSAGE("Invalid config type %d", data.Config.type);
+            data.Status = HDCP_STATUS_ERROR_INVALID_PARAMETER;
+            return;
+    }
+
     if (SUCCESS != sts)
     {
         data.Status = HDCP_STATUS_ERROR_INTERNAL;
@@ -27,7 +27,9 @@
 #ifndef __HDCP_DAEMON_H__
 #define __HDCP_DAEMON_H__
 
+#include <atomic>
 #include <list>
+#include <map>
 #include <pthread.h>
 
 #include "hdcpdef.h"
@@ -44,15 +46,134 @@
 #define HDCP_PIDFILE    "/var/run/hdcpd.pid"
 #endif
 
+// SDK session known to the daemon, identified by the connection of its process
+// and the session id the SDK tags its messages with
+typedef struct _AppSession
+{
+    int32_t     fd;
+    uint32_t    sessionId;
+} AppSession;
+
+// HDCP_API_WAIT_STATUS request parked until the status of its port matches
+typedef struct _StatusWaiter
+{
+    uint64_t    id;
+    int32_t     fd;
+    uint32_t    sessionId;
+    uint32_t    portId;
+    PORT_STATUS statusMask;
+    PORT_STATUS status;
+    uint64_t    deadline;   // GetMonotonicTimeMs based
+} StatusWaiter;
+
+// HDCP_API_SET_PROTECTION_LEVEL_BATCH request of a session, answered once the
+// last of its ports settled
+typedef struct _PendingBatch
+{
+    SocketData  data;           // Request, filled with the results
+    uint32_t    pendingPorts;   // Bit per index of data.Ports not settled yet
+} PendingBatch;
+
 class HdcpDaemon
 {
 private:
     LocalServerSocket   m_SdkSocket;
     std::list<int32_t>  m_CallBackList;
-    pthread_mutex_t     m_CallBackListMutex;
+
+    // Sessions that enabled ports, by the app id the PortManager knows them as
+    std::map<uint32_t, AppSession>  m_AppSessions;
+    uint32_t                        m_NextAppId;
+
+    // Batches with ports still authenticating, by app id. The SDK sends one
+    // request per session at a time, so there is at most one per session.
+    std::map<uint32_t, PendingBatch> m_PendingBatches;
+
+    // Bumped along with reporting the change to the connections, see
+    // STATUS_VERSION_NONE. Only written under m_ConnectionMutex.
+    std::atomic<uint32_t>           m_StatusVersion;
+
+    // Requests waiting for a port status, checked again by the wait thread
+    // whenever a status change is reported or a deadline passes
+    std::list<StatusWaiter>         m_StatusWaiters;
+    uint64_t                        m_NextWaiterId;
+    bool                            m_IsStatusChanged;
+    bool                            m_IsStopping;
+    bool                            m_IsWaitThreadRunning;
+    pthread_t                       m_WaitThread;
+
+    // Guards the lists above and every write to a connection, which are made
+    // both from the message loop and the PortManager threads
+    pthread_mutex_t     m_ConnectionMutex;
+
+    // Wakes the wait thread, used with m_ConnectionMutex
+    pthread_cond_t      m_StatusCV;
 
     bool                m_IsValid;
 
+    ////////////////////////////////////////////////////////////////////////////
+    /// \brief      Get the app id of a session, registering it on first use
+    ///
+    /// \param[in]  fd          Connection the session's messages arrive on
+    /// \param[in]  sessionId   Session id the SDK tagged the message with
+    /// \return     App id, or APP_ID_INTERNAL if the session can't be tracked
+    ////////////////////////////////////////////////////////////////////////////
+    uint32_t GetAppId(int32_t fd, uint32_t sessionId);
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// \brief      Release the ports held by a session that was destroyed
+    ///
+    /// \param[in]  fd          Connection the session's messages arrive on
+    /// \param[in]  sessionId   Session id the SDK tagged the message with
+    /// \return     Nothing
+    ////////////////////////////////////////////////////////////////////////////
+    void ReleaseSession(int32_t fd, uint32_t sessionId);
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// \brief      Release every session of a connection that went away and
+    ///             close it
+    ///
+    /// \param[in]  fd      Connection that was lost
+    /// \return     Nothing
+    ////////////////////////////////////////////////////////////////////////////
+    void ReleaseConnection(int32_t fd);
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// \brief      Main function of the wait thread
+    ///
+    /// \param[in]  data    The HdcpDaemon
+    /// \return     Nothing, but pthread requires pointer, so nullptr
+    ///
+    /// Answers the parked HDCP_API_WAIT_STATUS requests once the status of
+    /// their port matches or their deadline passes. The status is read off
+    /// the connection lock, since the PortManager reports with its port
+    /// locks held.
+    ////////////////////////////////////////////////////////////////////////////
+    static void *WaitManager(void *data);
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// \brief      Answer the parked requests until the daemon is destroyed,
+    ///             see WaitManager
+    ///
+    /// \return     Nothing
+    ////////////////////////////////////////////////////////////////////////////
+    void ProcessStatusWaiters(void);
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// \brief      Record the result of one port of a pending batch, and send
+    ///             the response once it was the last one
+    ///
+    /// \param[in]  appId   Id of the requesting session
+    /// \param[in]  index   Index of the port in the batch
+    /// \param[in]  status  Result for that port
+    /// \return     Nothing
+    ///
+    /// Must be called with m_ConnectionMutex held.
+    ////////////////////////////////////////////////////////////////////////////
+    void CompleteBatchPort(
+                        uint32_t appId,
+                        uint32_t index,
+                        HDCP_STATUS status);
+
 public:
     ////////////////////////////////////////////////////////////////////////////
     /// \brief      Construct the HdcpDaemon object
@@ -88,10 +209,11 @@ public:
     ///
     /// \param[in/out]  data   General message packet, it contains a port list
     ///                         the daemon can use to fill in port information
+    /// \param[in]      fd     Connection the message arrived on
     /// \param[out]     sendResponse whether need to send response to SDK or not
     /// \return         Nothing (Status is embedded in the SocketData structure)
     ////////////////////////////////////////////////////////////////////////////
-    void DispatchCommand(SocketData& data, int32_t appId, bool& sendResponse);
+    void DispatchCommand(SocketData& data, int32_t fd, bool& sendResponse);
 
     ////////////////////////////////////////////////////////////////////////////
     /// \brief      Enumerate connected HDCP-capabile displays.
@@ -116,14 +238,63 @@ public:
     ///
     /// \param[in/out]  data    General message packet. The user has filled in
     ///                         PortId.
-    /// \param[in]      appId   Id of the corresponding app's connection
+    /// \param[in]      appId   Id of the requesting session
+    /// \return         Nothing (Status is embedded in the SocketData structure)
+    ///
+    /// \param[out]     sendResponse whether need to send response to SDK or not
     /// \return         Nothing (Status is embedded in the SocketData structure)
     ///
     /// This function will add the appId to a list of active apps for the
     /// specified port. If this is the first app to request HDCP encryption on
-    /// the port, then it will also perform the steps of authentication.
+    /// the port, then it will also start the steps of authentication. In that
+    /// case the response is sent by CompleteSetProtectionLevel once the port
+    /// state machine settles.
+    ////////////////////////////////////////////////////////////////////////////
+    void SetProtectionLevel(
+                        SocketData& data,
+                        uint32_t appId,
+                        bool& sendResponse);
+
     ////////////////////////////////////////////////////////////////////////////
-    void SetProtectionLevel(SocketData& data, uint32_t appId);
+    /// \brief      Enable/Disable HDCP on several ports in one request
+    ///
+    /// \param[in/out]  data    General message packet. The user has filled in
+    ///                         the ports and a level for each.
+    /// \param[in]      appId   Id of the requesting session
+    /// \param[out]     sendResponse whether need to send response to SDK or not
+    /// \return         Nothing (Status is embedded in the SocketData structure)
+    ///
+    /// Every port is started before any is waited for, so the ports
+    /// authenticate at the same time. The response carries a result per port
+    /// and is sent by CompleteBatchPort once the last port settled.
+    ////////////////////////////////////////////////////////////////////////////
+    void SetProtectionLevelBatch(
+                        SocketData& data,
+                        uint32_t appId,
+                        bool& sendResponse);
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// \brief      Send the response of a SetProtectionLevel request that was
+    ///             left pending on an authentication in progress.
+    ///
+    /// \param[in]  appId   Id of the requesting session
+    /// \param[in]  portId  Port the request was made on
+    /// \param[in]  level   Level that was requested
+    /// \param[in]  sts     SUCCESS or errno result of the enable
+    /// \return     Nothing
+    ///
+    /// Completes the port within the pending batch of the session if any.
+    /// Called from the port timer and hotplug threads, so the session is
+    /// looked up by its app id and the response is written under
+    /// m_ConnectionMutex like every other write to the connection. App ids
+    /// are never reused, a completion for a session that has gone is
+    /// dropped. Must be called without m_ConnectionMutex held.
+    ////////////////////////////////////////////////////////////////////////////
+    void CompleteSetProtectionLevel(
+                        uint32_t appId,
+                        uint32_t portId,
+                        uint8_t level,
+                        int32_t sts);
 
     ////////////////////////////////////////////////////////////////////////////
     /// \brief       Get the HDCP enabled/disabled status of the specified port.
@@ -134,15 +305,39 @@ public:
     ////////////////////////////////////////////////////////////////////////////
     void GetStatus(SocketData& data);
 
+    ////////////////////////////////////////////////////////////////////////////
+    /// \brief       Get the status of several ports in one request.
+    ///
+    /// \param[in/out]  data    General message packet. The user has filled in
+    ///                         the ports.
+    /// \return         Nothing (Status is embedded in the SocketData structure)
+    ////////////////////////////////////////////////////////////////////////////
+    void GetStatusBatch(SocketData& data);
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// \brief       Wait until the status of the specified port matches.
+    ///
+    /// \param[in/out]  data    General message packet. The user has filled in
+    ///                         PortId, the awaited status, its mask and the
+    ///                         timeout.
+    /// \param[in]      fd      Connection the request arrived on
+    /// \param[out]     sendResponse whether need to send response to SDK or not
+    /// \return         Nothing (Status is embedded in the SocketData structure)
+    ///
+    /// A valid request is parked and answered by the wait thread, the message
+    /// loop goes on with other requests meanwhile.
+    ////////////////////////////////////////////////////////////////////////////
+    void WaitStatus(SocketData& data, int32_t fd, bool& sendResponse);
+
     ////////////////////////////////////////////////////////////////////////////
     /// \brief       Get the KsvList of connected HDCP1.X devices
     ///
     /// \param[in/out]  data    General message packet. The user has filled in
     ///                         PortId.
-    /// \param[in]      appId   Id of the corresponding app's connection
+    /// \param[in]      fd      Connection the request arrived on
     /// \return         Nothing (Status is embedded in the SocketData structure)
     ////////////////////////////////////////////////////////////////////////////
-    void GetKsvList(SocketData& data, uint32_t appId);
+    void GetKsvList(SocketData& data, int32_t fd);
 
     ////////////////////////////////////////////////////////////////////////////
     /// \brief       Get the ksv count (number of ksv in the topology)
@@ -166,13 +361,41 @@ public:
     /// \brief      Send SRM data.
     ///
     /// \param[in/out]  data    General message packet.
-    /// \param[in]      appId   Id of the corresponding app's connection
+    /// \param[in]      fd      Connection the request arrived on
     /// \return         Nothing (Status is embedded in the SocketData structure)
     ///
     /// This function will parse the SRM data from application, and update the
     /// daemon's local copy if it is newer and valid.
     ////////////////////////////////////////////////////////////////////////////
-    void SendSRMData(SocketData& data, uint32_t appId);
+    void SendSRMData(SocketData& data, int32_t fd);
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// \brief      Send SRM data that arrived right behind the request.
+    ///
+    /// \param[in/out]  data    General message packet.
+    /// \param[in]      fd      Connection the request arrived on
+    /// \param[out]     sendResponse whether need to send response to SDK or not
+    /// \return         Nothing (Status is embedded in the SocketData structure)
+    ///
+    /// Same as SendSRMData, without acknowledging the size before the SRM
+    /// data is sent. The size is checked before the data is read. Data too
+    /// large to ever be read gets its response here, then the connection is
+    /// closed.
+    ////////////////////////////////////////////////////////////////////////////
+    void SendSRMDataStream(
+                        SocketData& data,
+                        int32_t fd,
+                        bool& sendResponse);
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// \brief      Update the daemon's local copy of the SRM with SRM data
+    ///             received from an application.
+    ///
+    /// \param[in/out]  data    General message packet.
+    /// \param[in]      srmData SRM data of SrmOrKsvListDataSz bytes
+    /// \return         Nothing (Status is embedded in the SocketData structure)
+    ////////////////////////////////////////////////////////////////////////////
+    void StoreSRMData(SocketData& data, const uint8_t *srmData);
 
     ////////////////////////////////////////////////////////////////////////////
     /// \brief      Get current SRM version.
@@ -193,13 +416,15 @@ public:
     void Config(SocketData& data);
 
     ////////////////////////////////////////////////////////////////////////////
-    /// \brief      Report an event to the apps using the callback sockets
+    /// \brief      Report an event to every app that registered for callbacks
     ///
     /// \param[in]  event   Specific event we have encountered
     /// \param[in]  portId  Port on which the event has occurred
     /// \return     SUCCESS or errno
     ///
-    /// Used to report hotplug events, link lost, etc.
+    /// Used to report hotplug events, link lost, etc. Every call bumps the
+    /// status version, so it has to follow every change of a port status;
+    /// PORT_EVENT_NONE only invalidates the status the apps cached.
     ////////////////////////////////////////////////////////////////////////////
     void ReportStatus(PORT_EVENT event, uint32_t portId);
 
@@ -31,6 +31,7 @@
 #include <new>
 #include <list>
 #include <random>
+#include <time.h>
 
 #include "port.h"
 #include "hdcpdef.h"
@@ -38,6 +39,27 @@
 #include "daemon.h"
 #include "srm.h"
 
+uint64_t GetMonotonicTimeMs()
+{
+    struct timespec ts = {};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+const char *GetPortStateName(PORT_STATE state)
+{
+    switch (state)
+    {
+        case PORT_STATE_IDLE:           return "Idle";
+        case PORT_STATE_DESIRED:        return "Desired";
+        case PORT_STATE_AUTHENTICATING: return "Authenticating";
+        case PORT_STATE_ENABLED:        return "Enabled";
+        case PORT_STATE_LINK_LOST:      return "LinkLost";
+        case PORT_STATE_RETRYING:       return "Retrying";
+        default:                        return "Unknown";
+    }
+}
+
 DrmObject::DrmObject(uint32_t drm_id, uint32_t port_id)
     :m_DrmId(drm_id)
 {
@@ -47,15 +69,24 @@ DrmObject::DrmObject(uint32_t drm_id, uint32_t port_id)
     m_Depth = UINT32_MAX;
     m_DeviceCount = UINT32_MAX;
     m_PropertyList = {};
+    m_State = PORT_STATE_IDLE;
+    m_StateSeq = 0;
+    m_StateTime = 0;
+    m_Deadline = UINT64_MAX;
+    m_Level = HDCP_LEVEL0;
+    m_FallbackLevel = HDCP_LEVEL0;
+    m_RetryCount = 0;
+    m_IsRestoring = false;
+    m_RevokedKsvCount = 0;
 
     pthread_mutex_init(&m_ConnectionMutex, nullptr);
-    pthread_mutex_init(&m_CpTypeMutex, nullptr);
+    pthread_mutex_init(&m_StateMutex, nullptr);
 }
 
 DrmObject::~DrmObject()
 {
     DESTROY_LOCK(&m_ConnectionMutex);
-    DESTROY_LOCK(&m_CpTypeMutex);
+    DESTROY_LOCK(&m_StateMutex);
 }
 
 uint32_t DrmObject::GetDrmId()
@@ -144,26 +175,101 @@ void DrmObject::SetCpType(uint8_t cpType)
     m_CpType = cpType;
 }
 
+PORT_STATE DrmObject::GetState()
+{
+    return m_State;
+}
+
+void DrmObject::SetState(PORT_STATE state, uint64_t now)
+{
+    m_State = state;
+    m_StateTime = now;
+    ++m_StateSeq;
+}
+
+uint32_t DrmObject::GetStateSeq()
+{
+    return m_StateSeq;
+}
+
+uint64_t DrmObject::GetStateTime()
+{
+    return m_StateTime;
+}
+
+uint64_t DrmObject::GetDeadline()
+{
+    return m_Deadline;
+}
+
+void DrmObject::SetDeadline(uint64_t deadline)
+{
+    m_Deadline = deadline;
+}
+
+uint8_t DrmObject::GetLevel()
+{
+    return m_Level;
+}
+
+void DrmObject::SetLevel(uint8_t level)
+{
+    m_Level = level;
+}
+
+uint8_t DrmObject::GetFallbackLevel()
+{
+    return m_FallbackLevel;
+}
+
+void DrmObject::SetFallbackLevel(uint8_t level)
+{
+    m_FallbackLevel = level;
+}
+
+uint32_t DrmObject::GetRetryCount()
+{
+    return m_RetryCount;
+}
+
+void DrmObject::SetRetryCount(uint32_t retryCount)
+{
+    m_RetryCount = retryCount;
+}
+
+uint32_t DrmObject::GetRevokedKsvCount()
+{
+    return m_RevokedKsvCount;
+}
+
+void DrmObject::SetRevokedKsvCount(uint32_t count)
+{
+    m_RevokedKsvCount = count;
+}
+
+bool DrmObject::IsRestoring()
+{
+    return m_IsRestoring;
+}
+
+void DrmObject::SetRestoring(bool isRestoring)
+{
+    m_IsRestoring = isRestoring;
+}
+
 void DrmObject::AddRefAppId(uint32_t appId)
 {
-    bool exist = false;
-    for (auto id : m_AppIds)
-    {
-        if (id == appId)
-        {
-            exist = true;
-        }
-    }
-    
-    if (!exist)
-    {
-        m_AppIds.push_back(appId);
-    }
+    m_AppIds.insert(appId);
 }
 
 void DrmObject::RemoveRefAppId(uint32_t appId)
 {
-    m_AppIds.remove(appId);
+    m_AppIds.erase(appId);
+}
+
+bool DrmObject::HasRefAppId(uint32_t appId)
+{
+    return m_AppIds.end() != m_AppIds.find(appId);
 }
 
 uint32_t DrmObject::GetRefAppCount()
@@ -176,6 +282,58 @@ void DrmObject::ClearRefAppId()
     m_AppIds.clear();
 }
 
+void DrmObject::AddWaiter(uint32_t appId, uint8_t level)
+{
+    m_Waiters.push_back({appId, level});
+}
+
+void DrmObject::RemoveWaiter(uint32_t appId)
+{
+    m_Waiters.remove_if(
+                [appId](const EnableWaiter& waiter)
+                {
+                    return waiter.appId == appId;
+                });
+}
+
+bool DrmObject::HasWaiters()
+{
+    return !m_Waiters.empty();
+}
+
+void DrmObject::TakeWaiters(std::list<EnableWaiter>& waiters)
+{
+    waiters.splice(waiters.end(), m_Waiters);
+}
+
+void DrmObject::AddPendingEvent(PORT_EVENT event)
+{
+    if (PORT_EVENT_NONE == event)
+    {
+        if (m_PendingEvents.empty())
+        {
+            m_PendingEvents.push_back(event);
+        }
+        return;
+    }
+
+    m_PendingEvents.remove(PORT_EVENT_NONE);
+    m_PendingEvents.push_back(event);
+}
+
+void DrmObject::AddPendingResult(uint32_t appId, uint8_t level, int32_t sts)
+{
+    m_PendingResults.push_back({appId, level, sts});
+}
+
+void DrmObject::TakePending(
+                    std::list<PORT_EVENT>& events,
+                    std::list<EnableResult>& results)
+{
+    events.splice(events.end(), m_PendingEvents);
+    results.splice(results.end(), m_PendingResults);
+}
+
 void DrmObject::ConnAtomicBegin()
 {
     ACQUIRE_LOCK(&m_ConnectionMutex);
@@ -186,12 +344,12 @@ void DrmObject::ConnAtomicEnd()
     RELEASE_LOCK(&m_ConnectionMutex);
 }
 
-void DrmObject::CpTypeAtomicBegin()
+void DrmObject::StateAtomicBegin()
 {
-    ACQUIRE_LOCK(&m_CpTypeMutex);
+    ACQUIRE_LOCK(&m_StateMutex);
 }
 
-void DrmObject::CpTypeAtomicEnd()
+void DrmObject::StateAtomicEnd()
 {
-    RELEASE_LOCK(&m_CpTypeMutex);
+    RELEASE_LOCK(&m_StateMutex);
 }
@@ -31,11 +31,56 @@
 #include <memory>
 #include <map>
 #include <string>
+#include <unordered_set>
 #include <pthread.h>
 
 #include "hdcpdef.h"
 #include "hdcpapi.h"
 
+/// \typedef PORT_STATE
+/// \brief  States of the per-port HDCP state machine run by the PortManager
+typedef enum _PORT_STATE
+{
+    PORT_STATE_IDLE = 0,            // protection is off, nothing requested
+    PORT_STATE_DESIRED,             // enable requested, properties not written
+    PORT_STATE_AUTHENTICATING,      // CP_DESIRED written, waiting for enabled
+    PORT_STATE_ENABLED,             // KMD reports CP_ENABLED
+    PORT_STATE_LINK_LOST,           // CP_ENABLED dropped on an enabled port
+    PORT_STATE_RETRYING,            // waiting for the backoff timer to expire
+} PORT_STATE;
+
+/// \typedef EnableWaiter
+/// \brief  A SetProtectionLevel request waiting on the port state machine
+typedef struct _EnableWaiter
+{
+    uint32_t appId;
+    uint8_t level;
+} EnableWaiter;
+
+/// \typedef EnableResult
+/// \brief  Result of an EnableWaiter, sent once the port state lock is released
+typedef struct _EnableResult
+{
+    uint32_t appId;
+    uint8_t level;
+    int32_t sts;
+} EnableResult;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Get current CLOCK_MONOTONIC time in milliseconds
+///
+/// \return     monotonic time (ms)
+///////////////////////////////////////////////////////////////////////////////
+uint64_t GetMonotonicTimeMs();
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Get printable name of a port state
+///
+/// \param[in] state
+/// \return     name of the state
+///////////////////////////////////////////////////////////////////////////////
+const char *GetPortStateName(PORT_STATE state);
+
 class DrmObject
 {
 private: 
@@ -69,15 +114,52 @@ private:
     // content type of this port
     uint32_t m_CpType;
 
-    // PortManager integrity check thread will read and write m_CpTye,
-    // need a dedicate lock to protect it
-    pthread_mutex_t m_CpTypeMutex;
+    // State of the HDCP state machine of this port
+    PORT_STATE m_State;
+
+    // Incremented on every state transition
+    uint32_t m_StateSeq;
+
+    // Monotonic time (ms) of the last state transition
+    uint64_t m_StateTime;
+
+    // Monotonic time (ms) at which the state machine needs to run again
+    uint64_t m_Deadline;
+
+    // HDCP level requested for this port
+    uint8_t m_Level;
+
+    // Level the apps holding the port were enabled with before the current
+    // upgrade, HDCP_LEVEL0 if the current enable request is no upgrade
+    uint8_t m_FallbackLevel;
+
+    // Number of failed attempts of the current enable request
+    uint32_t m_RetryCount;
+
+    // The current enable request was issued by the daemon after link lost
+    bool m_IsRestoring;
+
+    // Number of devices of the authenticated topology found in the SRM
+    uint32_t m_RevokedKsvCount;
+
+    // PortManager timer thread, integrity check thread and the daemon
+    // dispatch thread all drive the state machine, so m_State, m_CpType and
+    // the fields above need a dedicate lock to protect them
+    pthread_mutex_t m_StateMutex;
 
     // DrmProperties of this port
     std::list<DrmProperty> m_PropertyList;
 
     // processes tha enabled this port
-    std::list<uint32_t>   m_AppIds;
+    std::unordered_set<uint32_t> m_AppIds;
+
+    // enable requests waiting for the in-flight authentication
+    std::list<EnableWaiter> m_Waiters;
+
+    // Status reports and enable results produced under m_StateMutex. Writing
+    // them to the apps can block, so that happens after it is released.
+    std::list<PORT_EVENT> m_PendingEvents;
+    std::list<EnableResult> m_PendingResults;
 
 public:
 
@@ -188,6 +270,120 @@ public:
     ///////////////////////////////////////////////////////////////////////////
     uint8_t GetCpType();
 
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Get state of the port state machine
+    ///
+    /// \return     state
+    ///////////////////////////////////////////////////////////////////////////
+    PORT_STATE GetState();
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Move the port state machine to a new state and update the
+    ///         transition bookkeeping
+    ///
+    /// \param[in] state, new state
+    /// \param[in] now,   monotonic time (ms) of the transition
+    ///////////////////////////////////////////////////////////////////////////
+    void SetState(PORT_STATE state, uint64_t now);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Get the number of state transitions done so far
+    ///
+    /// \return     transition sequence number
+    ///////////////////////////////////////////////////////////////////////////
+    uint32_t GetStateSeq();
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Get the monotonic time (ms) of the last state transition
+    ///
+    /// \return     time of the last transition
+    ///////////////////////////////////////////////////////////////////////////
+    uint64_t GetStateTime();
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Get the time the state machine needs to run again
+    ///
+    /// \return     monotonic deadline in ms, UINT64_MAX if none
+    ///////////////////////////////////////////////////////////////////////////
+    uint64_t GetDeadline();
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Set the time the state machine needs to run again
+    ///
+    /// \param[in] deadline, monotonic deadline in ms, UINT64_MAX if none
+    ///////////////////////////////////////////////////////////////////////////
+    void SetDeadline(uint64_t deadline);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Get HDCP level requested for this port
+    ///
+    /// \return     level
+    ///////////////////////////////////////////////////////////////////////////
+    uint8_t GetLevel();
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Set HDCP level requested for this port
+    ///
+    /// \param[in] level
+    ///////////////////////////////////////////////////////////////////////////
+    void SetLevel(uint8_t level);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Get level to go back to if the current upgrade fails
+    ///
+    /// \return     level, HDCP_LEVEL0 if the current request is no upgrade
+    ///////////////////////////////////////////////////////////////////////////
+    uint8_t GetFallbackLevel();
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Set level to go back to if the current upgrade fails
+    ///
+    /// \param[in] level
+    ///////////////////////////////////////////////////////////////////////////
+    void SetFallbackLevel(uint8_t level);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Get number of failed attempts of the current enable request
+    ///
+    /// \return     retry count
+    ///////////////////////////////////////////////////////////////////////////
+    uint32_t GetRetryCount();
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Set number of failed attempts of the current enable request
+    ///
+    /// \param[in] retryCount
+    ///////////////////////////////////////////////////////////////////////////
+    void SetRetryCount(uint32_t retryCount);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Get number of revoked devices in the authenticated topology
+    ///
+    /// \return     revoked device count
+    ///////////////////////////////////////////////////////////////////////////
+    uint32_t GetRevokedKsvCount();
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Set number of revoked devices in the authenticated topology
+    ///
+    /// \param[in] count
+    ///////////////////////////////////////////////////////////////////////////
+    void SetRevokedKsvCount(uint32_t count);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Check if the current enable request restores a lost link
+    ///
+    /// \return     true if the daemon re-requested protection by itself
+    ///////////////////////////////////////////////////////////////////////////
+    bool IsRestoring();
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Mark whether the current enable request restores a lost link
+    ///
+    /// \param[in] isRestoring
+    ///////////////////////////////////////////////////////////////////////////
+    void SetRestoring(bool isRestoring);
+
     ///////////////////////////////////////////////////////////////////////////
     /// \brief  Add appId to appId list
     ///
@@ -209,11 +405,78 @@ public:
     ///////////////////////////////////////////////////////////////////////////
     uint32_t GetRefAppCount();
 
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Check if appId is in appId list
+    ///
+    /// \param[in] appId
+    /// \return     true if the app holds a reference on this port
+    ///////////////////////////////////////////////////////////////////////////
+    bool HasRefAppId(uint32_t appId);
+
     ///////////////////////////////////////////////////////////////////////////
     /// \brief  Remove all AppId 
     ///////////////////////////////////////////////////////////////////////////
     void ClearRefAppId();
 
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Queue an enable request until the state machine settles
+    ///
+    /// \param[in] appId
+    /// \param[in] level, requested HDCP level
+    ///////////////////////////////////////////////////////////////////////////
+    void AddWaiter(uint32_t appId, uint8_t level);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Drop the queued enable requests of an app
+    ///
+    /// \param[in] appId
+    ///////////////////////////////////////////////////////////////////////////
+    void RemoveWaiter(uint32_t appId);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Check if enable requests are queued on this port
+    ///
+    /// \return     true if at least one request is waiting
+    ///////////////////////////////////////////////////////////////////////////
+    bool HasWaiters();
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Move all queued enable requests out of the port
+    ///
+    /// \param[out] waiters, list receiving the queued requests
+    ///////////////////////////////////////////////////////////////////////////
+    void TakeWaiters(std::list<EnableWaiter>& waiters);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Queue a status report to send once the state lock is released.
+    ///         PORT_EVENT_NONE is only queued if nothing else is, any report
+    ///         invalidates the status the apps cached.
+    ///
+    /// \param[in] event, event to report
+    ///////////////////////////////////////////////////////////////////////////
+    void AddPendingEvent(PORT_EVENT event);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Queue the result of an enable request to send once the state
+    ///         lock is released
+    ///
+    /// \param[in] appId
+    /// \param[in] level, requested HDCP level
+    /// \param[in] sts,   SUCCESS or errno result of the request
+    ///////////////////////////////////////////////////////////////////////////
+    void AddPendingResult(uint32_t appId, uint8_t level, int32_t sts);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Move all queued status reports and enable results out of the
+    ///         port
+    ///
+    /// \param[out] events,  list receiving the reports
+    /// \param[out] results, list receiving the enable results
+    ///////////////////////////////////////////////////////////////////////////
+    void TakePending(
+            std::list<PORT_EVENT>& events,
+            std::list<EnableResult>& results);
+
     ///////////////////////////////////////////////////////////////////////////
     /// \brief  Begin atomic operation for m_Connection 
     ///////////////////////////////////////////////////////////////////////////
@@ -225,14 +488,14 @@ public:
     void ConnAtomicEnd();
 
     ///////////////////////////////////////////////////////////////////////////
-    /// \brief  Begin atomic operation for m_CpType 
+    /// \brief  Begin atomic operation for m_State and m_CpType
     ///////////////////////////////////////////////////////////////////////////
-    void CpTypeAtomicBegin();
+    void StateAtomicBegin();
 
     ///////////////////////////////////////////////////////////////////////////
-    /// \brief  End atomic operation for m_CpType 
+    /// \brief  End atomic operation for m_State and m_CpType
     ///////////////////////////////////////////////////////////////////////////
-    void CpTypeAtomicEnd();
+    void StateAtomicEnd();
 };
 
 #endif // __HDCP_PORT_H__
@@ -26,6 +26,9 @@
 
 #include <list>
 #include <new>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <string>
 #include <pthread.h>
@@ -69,13 +72,35 @@
 static PortManager          *portMgr = nullptr;
 static pthread_t            uEventThread;
 static pthread_t            integrityCheckThread;
+static pthread_t            shutdownThread;
 
 static int32_t              eventSocket = -1;
 
 static bool                 isDestroyThreads = false;
 
+// Self-pipe the terminate signal handler writes to, the shutdown thread
+// turns the ports off once it reads from it
+static int32_t              shutdownPipe[2] = { -1, -1 };
+
 static pthread_barrier_t    createThreadBarrier;
 
+// The integrity check thread also drives the port state machines, it sleeps
+// on this CV until the next deadline or until it gets kicked
+static pthread_mutex_t      portTimerMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t       portTimerCV;
+static bool                 isPortTimerKicked = false;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Wake up the port timer thread to re-evaluate the port deadlines
+///////////////////////////////////////////////////////////////////////////////
+static void KickPortTimer()
+{
+    ACQUIRE_LOCK(&portTimerMutex);
+    isPortTimerKicked = true;
+    pthread_cond_signal(&portTimerCV);
+    RELEASE_LOCK(&portTimerMutex);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /// \brief  Exit the thread when receiving the SIGUSR1 signal
 ///
@@ -103,7 +128,7 @@ static void ExitThread(int32_t sig)
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-/// \brief  Wrapper for the port manager's Auth Step 3 work
+/// \brief  Wrapper for the port manager's Auth Step 3 work and port timers
 ///
 /// \return     Nothing, but pthread requires pointer, so nullptr
 ///////////////////////////////////////////////////////////////////////////////
@@ -123,6 +148,8 @@ static void *InitPeriodicIntegrityCheck(void *data)
     
     HDCP_NORMALMESSAGE("Periodic link integrity thread is active");
 
+    uint64_t nextIntegrityCheck = GetMonotonicTimeMs();
+
     while (true)
     {
         // Declare local variable to calm the KW violation..
@@ -133,16 +160,68 @@ static void *InitPeriodicIntegrityCheck(void *data)
             break;
         }
 
-        portMgr->CheckIntegrity();
+        uint64_t now = GetMonotonicTimeMs();
 
         // Only check integrity periodically 
-        SLEEP_MSEC(INTEGRITY_CHECK_DELAY_MS);
+        if (now >= nextIntegrityCheck)
+        {
+            portMgr->CheckIntegrity();
+            nextIntegrityCheck = now + INTEGRITY_CHECK_DELAY_MS;
+        }
+
+        uint64_t deadline = std::min(
+                                nextIntegrityCheck,
+                                portMgr->ProcessPortTimers(now));
+
+        struct timespec ts = {};
+        ts.tv_sec = deadline / 1000;
+        ts.tv_nsec = (deadline % 1000) * 1000000;
+
+        ACQUIRE_LOCK(&portTimerMutex);
+        if (!isPortTimerKicked && !isDestroyThreads)
+        {
+            pthread_cond_timedwait(&portTimerCV, &portTimerMutex, &ts);
+        }
+        isPortTimerKicked = false;
+        RELEASE_LOCK(&portTimerMutex);
     }
 
     HDCP_FUNCTION_EXIT(SUCCESS);
     return nullptr;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Wait for a terminate signal, then disable all ports and exit.
+///         The signal handler can only write to the pipe, everything that
+///         takes locks or sleeps has to run here.
+///
+/// \return     Nothing, but pthread requires pointer, so nullptr
+///////////////////////////////////////////////////////////////////////////////
+static void *InitShutdownHandler(void *data)
+{
+    HDCP_FUNCTION_ENTER;
+
+    uint8_t sig = 0;
+    ssize_t ret = ERROR;
+    do
+    {
+        ret = read(shutdownPipe[0], &sig, sizeof(sig));
+    } while (ERROR == ret && EINTR == errno);
+
+    // Woken up by the destructor, the daemon is already going down
+    bool localIsDestroyThreads = isDestroyThreads;
+    if (localIsDestroyThreads)
+    {
+        HDCP_NORMALMESSAGE("Shutdown thread is being destroyed");
+        HDCP_FUNCTION_EXIT(SUCCESS);
+        return nullptr;
+    }
+
+    HDCP_NORMALMESSAGE("Received signal %d, disabling all ports", sig);
+    PortManagerDisableAllPorts();
+    exit(SUCCESS);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /// \brief  Wrapper for the port manager's UEvent handler thread
 ///
@@ -391,6 +470,36 @@ int32_t PortManagerDisablePort(const uint32_t portId, const uint32_t appId)
     return ret;
 }
 
+int32_t PortManagerConfigAutoReauth(const bool enable)
+{
+    HDCP_FUNCTION_ENTER;
+
+    CHECK_PARAM_NULL(portMgr, ENODEV);
+
+    portMgr->SetAutoReauth(enable);
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return SUCCESS;
+}
+
+int32_t PortManagerConfigLingerTime(const uint32_t lingerTimeMs)
+{
+    HDCP_FUNCTION_ENTER;
+
+    CHECK_PARAM_NULL(portMgr, ENODEV);
+
+    if (lingerTimeMs > DISABLE_LINGER_MAX_MS)
+    {
+        HDCP_ASSERTMESSAGE("Linger time %d ms is too long", lingerTimeMs);
+        return EINVAL;
+    }
+
+    portMgr->SetLingerTime(lingerTimeMs);
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return SUCCESS;
+}
+
 int32_t PortManagerGetStatus(
                         const uint32_t portId,
                         PORT_STATUS *portStatus)
@@ -410,26 +519,21 @@ int32_t PortManagerGetKsvList(
                         const uint32_t portId,
                         uint8_t *ksvCount,
                         uint8_t *depth,
-                        uint8_t *ksvList)
+                        uint8_t *ksvList,
+                        uint8_t *revokedCount)
 {
     CHECK_PARAM_NULL(ksvCount, EINVAL); 
     CHECK_PARAM_NULL(depth, EINVAL); 
     CHECK_PARAM_NULL(ksvList, EINVAL); 
+    CHECK_PARAM_NULL(revokedCount, EINVAL); 
     CHECK_PARAM_NULL(portMgr, ENODEV);
 
-    uint32_t ret = portMgr->GetKsvList(portId, ksvCount, depth, ksvList);
-    return ret;
-}
-
-int32_t PortManagerSendSRMDdata(const uint8_t *data, const uint32_t size)
-{
-    HDCP_FUNCTION_ENTER;
-
-    CHECK_PARAM_NULL(portMgr, ENODEV);
-
-    int32_t ret = portMgr->SendSRMData(data, size);
-
-    HDCP_FUNCTION_EXIT(ret);
+    uint32_t ret = portMgr->GetKsvList(
+                                portId,
+                                ksvCount,
+                                depth,
+                                ksvList,
+                                revokedCount);
     return ret;
 }
 
@@ -467,11 +571,13 @@ void PortManagerDisableAllPorts()
 
 void PortManager::SigCatcher(int sig)
 {
-    if (SIGTERM == sig || SIGINT == sig || SIGKILL == sig)
-    {
-        PortManagerDisableAllPorts();
-    }
-    exit(SUCCESS);
+    // Only async-signal-safe calls here, hand the work to the shutdown thread.
+    // The write end doesn't block, if the pipe is full a shutdown is pending.
+    int32_t savedErrno = errno;
+    uint8_t value = static_cast<uint8_t>(sig);
+    ssize_t ret = write(shutdownPipe[1], &value, sizeof(value));
+    (void)ret;
+    errno = savedErrno;
 }
 
 PortManager::PortManager(HdcpDaemon& daemonSocket) :
@@ -482,6 +588,13 @@ PortManager::PortManager(HdcpDaemon& daemonSocket) :
     // Set default state
     m_IsValid = false;
 
+    m_IsAutoReauthEnabled.store(false, std::memory_order_relaxed);
+    m_LingerTimeMs.store(0, std::memory_order_relaxed);
+
+    pthread_mutex_init(&m_PropertyMutex, nullptr);
+    pthread_mutex_init(&m_AppPortsMutex, nullptr);
+    m_Rng.seed(static_cast<uint32_t>(GetMonotonicTimeMs()));
+
     m_DrmFd = drmOpen("i915", nullptr);
     if (m_DrmFd < 0)
     {
@@ -501,6 +614,13 @@ PortManager::PortManager(HdcpDaemon& daemonSocket) :
         return;
     }
 
+    // Port deadlines are computed from CLOCK_MONOTONIC, the CV has to match
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&portTimerCV, &attr);
+    pthread_condattr_destroy(&attr);
+
     int32_t sts = pthread_create(
                 &integrityCheckThread,
                 nullptr,
@@ -523,6 +643,28 @@ PortManager::PortManager(HdcpDaemon& daemonSocket) :
         return;
     }
 
+    if (ERROR == pipe2(shutdownPipe, O_CLOEXEC) ||
+        ERROR == fcntl(shutdownPipe[1], F_SETFL, O_NONBLOCK))
+    {
+        HDCP_ASSERTMESSAGE("Failed to create shutdown pipe!");
+        return;
+    }
+
+    sts = pthread_create(
+                &shutdownThread,
+                nullptr,
+                InitShutdownHandler,
+                nullptr);
+    if (SUCCESS != sts)
+    {
+        HDCP_ASSERTMESSAGE("Failed to create shutdown thread!");
+        close(shutdownPipe[0]);
+        close(shutdownPipe[1]);
+        shutdownPipe[0] = -1;
+        shutdownPipe[1] = -1;
+        return;
+    }
+
     // Regster terminate signal hanler, to destory all enabled ports
     struct sigaction actions = {};
 
@@ -542,11 +684,10 @@ PortManager::~PortManager(void)
 {
     HDCP_FUNCTION_ENTER;
 
-    if (!(m_DrmFd < 0))
-        drmClose(m_DrmFd);
-
+    // Both threads use m_DrmFd, stop them before closing it
     isDestroyThreads = true;
 
+    KickPortTimer();
     pthread_join(integrityCheckThread, nullptr);
     HDCP_NORMALMESSAGE("Destroyed Periodic Integrity Check thread");
     
@@ -569,10 +710,27 @@ PortManager::~PortManager(void)
         eventSocket = -1;
     }
 
+    if (-1 != shutdownPipe[1])
+    {
+        uint8_t value = 0;
+        if (ERROR != write(shutdownPipe[1], &value, sizeof(value)))
+        {
+            pthread_join(shutdownThread, nullptr);
+            HDCP_NORMALMESSAGE("Destroyed Shutdown thread");
+        }
+    }
+
+    if (!(m_DrmFd < 0))
+        drmClose(m_DrmFd);
+
     //Free m_DrmObjects
     for (auto drmObject : m_DrmObjects)
         delete drmObject;
 
+    DESTROY_CV(&portTimerCV);
+    DESTROY_LOCK(&m_PropertyMutex);
+    DESTROY_LOCK(&m_AppPortsMutex);
+
     HDCP_FUNCTION_EXIT(SUCCESS);
 }
 
@@ -692,6 +850,15 @@ int32_t PortManager::EnumeratePorts(
             portCount++;
         }
 
+        // The hotplug handler won't see this change anymore, so make sure
+        // nobody keeps using the status cached before it
+        if (connector->connection != drmObject->GetConnection())
+        {
+            m_DaemonSocket.ReportStatus(
+                            PORT_EVENT_NONE,
+                            drmObject->GetPortId());
+        }
+
         drmObject->SetConnection(connector->connection);
         drmModeFreeConnector(connector);
 
@@ -729,94 +896,130 @@ int32_t PortManager::EnablePort(
         }
     }
 
-    uint8_t cpType  = CP_VALUE_INVALID;
-    int32_t ret     = EINVAL;
-    
+    drmObject->StateAtomicBegin();
+
     // Check if the port is already enabled, do not enable it any more
     // if level == 1, then content type == 0 or 1 means enabled
     // if level == 2, then content type == 1 means enabled,
     //                     content type == 0 means upgrade to type 1.
     uint8_t currCpType = drmObject->GetCpType();
-    if (CP_TYPE_INVALID != currCpType && (uint32_t)(level - 1) <= currCpType)
+    if (PORT_STATE_ENABLED == drmObject->GetState() &&
+        CP_TYPE_INVALID != currCpType &&
+        (uint32_t)(level - 1) <= currCpType)
     {
         drmObject->AddRefAppId(appId);
+        AddAppPort(appId, portId);
+
+        // Cancel the linger timer if the port was about to be disabled
+        drmObject->SetDeadline(UINT64_MAX);
+        EndPortUpdate(drmObject);
         HDCP_NORMALMESSAGE("Port with id %d is already enabled", portId);
         return SUCCESS;
     }
 
-    // Only set Cp_Content_Type property when the port is HDCP type1 capable  
-    if (type1Capable)
+    // Hand the request over to the port state machine and answer it once the
+    // state machine settles. If an enable is already in flight just wait for
+    // its result. If its properties are not written yet it can still be
+    // raised to a higher level, otherwise a higher level request is handled
+    // as an upgrade once the in-flight enable completes.
+    uint64_t now = GetMonotonicTimeMs();
+    switch (drmObject->GetState())
     {
-        // Translate level to cpType
-        switch (level)
-        {
-            case HDCP_LEVEL1: cpType = CP_TYPE_0; break;
-            case HDCP_LEVEL2: cpType = CP_TYPE_1; break;
-            default : break;
-        }
-
-        // Set CP_Content_Type property, try at most AUTH_NUM_RETRY times
-        ret = SetPortProperty(
-                        drmObject->GetDrmId(),
-                        drmObject->GetPropertyId(CP_CONTENT_TYPE),
-                        sizeof(uint8_t),
-                        &cpType,
-                        AUTH_NUM_RETRY);
-        if (SUCCESS != ret)
-        {
-            HDCP_ASSERTMESSAGE(
-                        "Failed to enable port with id %d,"
-                        "set content_type property faild",
-                        portId);
-            return EBUSY;
-        }
+        case PORT_STATE_DESIRED:
+        case PORT_STATE_RETRYING:
+            drmObject->SetLevel(std::max(drmObject->GetLevel(), level));
+            break;
+        case PORT_STATE_AUTHENTICATING:
+            break;
+        default:
+            // If the upgrade fails, go back to what the current users have
+            drmObject->SetFallbackLevel(
+                    (PORT_STATE_ENABLED == drmObject->GetState() &&
+                     CP_TYPE_INVALID != currCpType) ?
+                    currCpType + 1 : HDCP_LEVEL0);
+            drmObject->SetLevel(level);
+            drmObject->SetRestoring(false);
+            drmObject->SetRetryCount(0);
+            drmObject->SetDeadline(now);
+            SetPortState(drmObject, PORT_STATE_DESIRED, now);
+            KickPortTimer();
+            break;
     }
 
-    // The port hasn't been enabled so far
-    // Set Content Protection property, try at most AUTH_NUM_RETRY times
-    uint8_t cpValue = CP_DESIRED;
-    ret = SetPortProperty(
-                    drmObject->GetDrmId(),
-                    drmObject->GetPropertyId(CONTENT_PROTECTION),
-                    sizeof(uint8_t),
-                    &cpValue,
-                    AUTH_NUM_RETRY);
-    if (SUCCESS != ret)
+    drmObject->AddWaiter(appId, level);
+    AddAppPort(appId, portId);
+    EndPortUpdate(drmObject);
+
+    HDCP_FUNCTION_EXIT(EINPROGRESS);
+    return EINPROGRESS;
+}
+
+void PortManager::CompleteWaiters(DrmObject *drmObject, uint64_t now)
+{
+    HDCP_FUNCTION_ENTER;
+
+    if (PORT_STATE_ENABLED != drmObject->GetState())
     {
-        HDCP_ASSERTMESSAGE(
-                    "Failed to enable port with id %d, set property faild",
-                    portId);
-        return EBUSY;
+        FailWaiters(drmObject);
+        HDCP_FUNCTION_EXIT(SUCCESS);
+        return;
     }
 
-    // Wait for the authentication complete
-    SLEEP_MSEC(AUTH_CHECK_DELAY_MS);
+    std::list<EnableWaiter> waiters;
+    drmObject->TakeWaiters(waiters);
 
-    // Check whether Content Protection property is CP_ENABLED or not 
-    drmObject->CpTypeAtomicBegin();
-    ret = GetProtectionInfo(drmObject, &cpValue, &cpType);
-    if (SUCCESS != ret) 
+    uint8_t cpType      = drmObject->GetCpType();
+    uint8_t upgradeLevel = HDCP_LEVEL0;
+
+    for (auto waiter : waiters)
     {
-        drmObject->CpTypeAtomicEnd();
-        HDCP_ASSERTMESSAGE("Failed to get protection info");
-        return EBUSY;
+        if (CP_TYPE_INVALID != cpType &&
+            (uint32_t)(waiter.level - 1) <= cpType)
+        {
+            drmObject->AddRefAppId(waiter.appId);
+            drmObject->AddPendingResult(waiter.appId, waiter.level, SUCCESS);
+        }
+        else
+        {
+            // Enabled at a lower level than this waiter asked for
+            upgradeLevel = std::max(upgradeLevel, waiter.level);
+            drmObject->AddWaiter(waiter.appId, waiter.level);
+        }
     }
 
-    if (cpValue != CP_ENABLED)
+    if (HDCP_LEVEL0 != upgradeLevel)
     {
-        drmObject->CpTypeAtomicEnd();
-        HDCP_ASSERTMESSAGE(
-                    "Failed to enable port with id %d, check property failed",
-                    portId);
-        return EBUSY;
-    }
+        HDCP_NORMALMESSAGE(
+                    "Port %d upgrade to level %d",
+                    drmObject->GetPortId(),
+                    upgradeLevel);
 
-    drmObject->SetCpType(cpType);
-    drmObject->AddRefAppId(appId);
-    drmObject->CpTypeAtomicEnd();
+        drmObject->SetFallbackLevel(
+                    CP_TYPE_INVALID != cpType ? cpType + 1 : HDCP_LEVEL0);
+        drmObject->SetLevel(upgradeLevel);
+        drmObject->SetRetryCount(0);
+        drmObject->SetDeadline(now);
+        SetPortState(drmObject, PORT_STATE_DESIRED, now);
+    }
 
     HDCP_FUNCTION_EXIT(SUCCESS);
-    return SUCCESS;
+}
+
+void PortManager::FailWaiters(DrmObject *drmObject)
+{
+    std::list<EnableWaiter> waiters;
+    drmObject->TakeWaiters(waiters);
+
+    for (auto waiter : waiters)
+    {
+        // Keep the app indexed if it still holds a reference on the port
+        if (!drmObject->HasRefAppId(waiter.appId))
+        {
+            RemoveAppPort(waiter.appId, drmObject->GetPortId());
+        }
+
+        drmObject->AddPendingResult(waiter.appId, waiter.level, EBUSY);
+    }
 }
 
 int32_t PortManager::DisablePort(const uint32_t portId, const uint32_t appId)
@@ -835,11 +1038,17 @@ int32_t PortManager::DisablePort(const uint32_t portId, const uint32_t appId)
         return SUCCESS;
     }
 
-    // We should not disable the port if other session still use it,
-    // just remove current appId from the m_AppIds list
+    drmObject->StateAtomicBegin();
+
+    // We should not disable the port if other session still use it or is
+    // waiting for it to be enabled, just remove current appId from the
+    // m_AppIds list
     drmObject->RemoveRefAppId(appId);
-    if (drmObject->GetRefAppCount() >= 1)
+    drmObject->RemoveWaiter(appId);
+    RemoveAppPort(appId, portId);
+    if (drmObject->GetRefAppCount() >= 1 || drmObject->HasWaiters())
     {
+        EndPortUpdate(drmObject);
         HDCP_NORMALMESSAGE(
                     "Port %d is in use by other app,"
                     "romove app Id %d from appId list",
@@ -849,6 +1058,40 @@ int32_t PortManager::DisablePort(const uint32_t portId, const uint32_t appId)
         return SUCCESS;
     }
 
+    // Keep the authenticated link around for a while, the next enable
+    // request coming in before the linger timer expires will reuse it
+    uint32_t lingerTimeMs = m_LingerTimeMs.load(std::memory_order_relaxed);
+    if (lingerTimeMs > 0 && PORT_STATE_ENABLED == drmObject->GetState())
+    {
+        // Already lingering, don't push the timer out
+        if (UINT64_MAX != drmObject->GetDeadline())
+        {
+            EndPortUpdate(drmObject);
+            return SUCCESS;
+        }
+
+        HDCP_NORMALMESSAGE(
+                    "Port %d is no longer used, disable in %d ms",
+                    portId,
+                    lingerTimeMs);
+
+        drmObject->SetDeadline(GetMonotonicTimeMs() + lingerTimeMs);
+        EndPortUpdate(drmObject);
+        KickPortTimer();
+        return SUCCESS;
+    }
+
+    int32_t ret = TurnOffPort(drmObject);
+    EndPortUpdate(drmObject);
+
+    HDCP_FUNCTION_EXIT(ret);
+    return ret;
+}
+
+int32_t PortManager::TurnOffPort(DrmObject *drmObject)
+{
+    HDCP_FUNCTION_ENTER;
+
     //Disable the port
     uint8_t cpValue = CP_OFF;
     int32_t ret = SetPortProperty(
@@ -861,34 +1104,39 @@ int32_t PortManager::DisablePort(const uint32_t portId, const uint32_t appId)
     {
         HDCP_ASSERTMESSAGE(
                     "Failed to disable port with id %d, set property faild",
-                    portId);
+                    drmObject->GetPortId());
         return EBUSY;
     }
 
     // Check whether Content Protection property is CP_OFF or not
-    drmObject->CpTypeAtomicBegin();
     uint8_t cpType = CP_TYPE_INVALID;
     ret = GetProtectionInfo(drmObject, &cpValue, &cpType);
     if (SUCCESS != ret)
     {
-        drmObject->CpTypeAtomicEnd();
         HDCP_ASSERTMESSAGE("Failed to get protection info");
         return EBUSY;
     }
 
     if (CP_OFF != cpValue)
     {
-        drmObject->CpTypeAtomicEnd();
         HDCP_ASSERTMESSAGE(
                     "Failed to disable port with id %d, check property failed",
-                    portId);
+                    drmObject->GetPortId());
         return EBUSY;
     }
 
+    // This also cancels an enable still in flight on the port
     drmObject->SetCpType(CP_TYPE_INVALID);
-    drmObject->CpTypeAtomicEnd();
+    drmObject->SetRestoring(false);
+    drmObject->SetDeadline(UINT64_MAX);
+    if (PORT_STATE_IDLE != drmObject->GetState())
+    {
+        SetPortState(drmObject, PORT_STATE_IDLE, GetMonotonicTimeMs());
+    }
 
-    HDCP_NORMALMESSAGE("Success to disable port with id %d", portId);
+    HDCP_NORMALMESSAGE(
+                "Success to disable port with id %d",
+                drmObject->GetPortId());
 
     HDCP_FUNCTION_EXIT(SUCCESS);
     return SUCCESS;
@@ -947,6 +1195,14 @@ int32_t PortManager::GetStatus(const uint32_t portId, PORT_STATUS *portStatus)
             default:
                 break;
         }
+
+        // Result of the revocation check done when the port authenticated
+        drmObject->StateAtomicBegin();
+        if (drmObject->GetRevokedKsvCount() > 0)
+        {
+            *portStatus |= PORT_STATUS_REVOKED_DEVICE_ATTACHED;
+        }
+        drmObject->StateAtomicEnd();
     }
     
     drmModeFreeConnector(connector);
@@ -959,13 +1215,15 @@ int32_t PortManager::GetKsvList(
                         const uint32_t portId,
                         uint8_t *ksvCount,
                         uint8_t *depth,
-                        uint8_t *ksvList)
+                        uint8_t *ksvList,
+                        uint8_t *revokedCount)
 {
     HDCP_FUNCTION_ENTER;
 
     CHECK_PARAM_NULL(ksvCount, EINVAL);
     CHECK_PARAM_NULL(depth, EINVAL);
     CHECK_PARAM_NULL(ksvList, EINVAL);
+    CHECK_PARAM_NULL(revokedCount, EINVAL);
 
     DownstreamInfo dsInfo;
     int32_t ret = GetDownstreamInfo(
@@ -977,91 +1235,323 @@ int32_t PortManager::GetKsvList(
         return EBUSY;
     }
 
-    *depth = dsInfo.depth + 1;
-    *ksvCount = dsInfo.deviceCount + 1;
-
     HDCP_NORMALMESSAGE(
                 "Downstream Info : device count %d depth %d",
                 dsInfo.deviceCount,
                 dsInfo.depth);
 
-    memmove(ksvList, dsInfo.bksv, KSV_SIZE);
-    memmove(ksvList + KSV_SIZE, dsInfo.ksvList, (*ksvCount) * KSV_SIZE);
+    uint32_t count = GetTopologyKsvs(dsInfo, ksvList);
+
+    *depth = dsInfo.depth + 1;
+    *revokedCount = 0;
+    if (count > MAX_KSV_COUNT)
+    {
+        // Let the caller report the topology as too large
+        *ksvCount = MAX_KSV_COUNT + 1;
+        HDCP_FUNCTION_EXIT(SUCCESS);
+        return SUCCESS;
+    }
+
+    *ksvCount = count;
+
+    // The topology may have changed since authentication, so check the list
+    // the caller actually gets
+    // HDCP 2.x topologies hold receiver IDs, revoked by HDCP 2.x SRMs
+    SrmFormat format = (dsInfo.hdcpVersion & HDCP_VERSION_22_IN_FORCE) ?
+                            SRM_FORMAT_HDCP2 :
+                            SRM_FORMAT_HDCP1;
+
+    std::vector<uint32_t> revoked;
+    if (EACCES == CheckSrmRevokeList(format, ksvList, count, revoked))
+    {
+        HDCP_WARNMESSAGE(
+                    "Port %d has %d revoked devices in its topology",
+                    portId,
+                    static_cast<uint32_t>(revoked.size()));
+        *revokedCount = revoked.size();
+    }
 
     HDCP_FUNCTION_EXIT(SUCCESS);
     return SUCCESS;
 }
 
-int32_t PortManager::SendSRMData(const uint8_t *data, const uint32_t size)
+uint32_t PortManager::GetTopologyKsvs(
+                        const DownstreamInfo& dsInfo,
+                        uint8_t *ksvList)
+{
+    // Never trust the device count further than the size of the list
+    uint32_t deviceCount = std::min<uint32_t>(
+                                    dsInfo.deviceCount,
+                                    MAX_KSV_COUNT);
+
+    memmove(ksvList, dsInfo.bksv, KSV_SIZE);
+    memmove(
+        ksvList + KSV_SIZE,
+        dsInfo.ksvList,
+        std::min<uint32_t>(deviceCount, MAX_KSV_COUNT - 1) * KSV_SIZE);
+
+    return deviceCount + 1;
+}
+
+void PortManager::CheckTopologyRevocation(DrmObject *drmObject)
 {
     HDCP_FUNCTION_ENTER;
 
-    CHECK_PARAM_NULL(data, EINVAL);
+    drmObject->SetRevokedKsvCount(0);
 
-    //Write srm data into fw file
-    int32_t ret = -1;
-    size_t total = 0;
-    int fd = open(DISPLAY_SRM_STORAGE_FILE, O_WRONLY|O_CREAT, S_IRUSR|S_IWUSR);
-    if (0 > fd)
+    DownstreamInfo dsInfo;
+    int32_t ret = GetDownstreamInfo(drmObject, (uint8_t *)&dsInfo);
+    if (SUCCESS != ret)
     {
-        HDCP_ASSERTMESSAGE("Could not open file Err: %s!", strerror(errno));
-        return -errno;
+        HDCP_WARNMESSAGE(
+                    "Port %d topology is unknown, skip revocation check",
+                    drmObject->GetPortId());
+        return;
     }
-    do
-    {
-        ret = write(fd, data + total, size - total);
-        if (0 >= ret)
-        {
-            if (EINTR == errno || EAGAIN == errno)
-                continue;
-            else
-                break;
-        }
-        total += ret;
-    } while(total != size);
 
-    if (total != static_cast<size_t>(size))
+    uint8_t ksvList[MAX_KSV_COUNT * KSV_SIZE];
+    uint32_t count = std::min<uint32_t>(
+                            GetTopologyKsvs(dsInfo, ksvList),
+                            MAX_KSV_COUNT);
+
+    SrmFormat format = (dsInfo.hdcpVersion & HDCP_VERSION_22_IN_FORCE) ?
+                            SRM_FORMAT_HDCP2 :
+                            SRM_FORMAT_HDCP1;
+
+    std::vector<uint32_t> revoked;
+    if (EACCES != CheckSrmRevokeList(format, ksvList, count, revoked))
     {
-        HDCP_ASSERTMESSAGE("Failed to write srm to file. Err: %s", strerror(errno));
-        ret = -EIO;
+        HDCP_FUNCTION_EXIT(SUCCESS);
+        return;
     }
-    else
+
+    for (auto it = revoked.begin(); it != revoked.end(); ++it)
     {
-        ret = SUCCESS;
+        HDCP_WARNMESSAGE(
+                    "Port %d device %d of the topology is revoked",
+                    drmObject->GetPortId(),
+                    *it);
     }
 
-    close(fd);
+    drmObject->SetRevokedKsvCount(revoked.size());
 
-    HDCP_FUNCTION_EXIT(ret);
-    return ret;
+    HDCP_FUNCTION_EXIT(SUCCESS);
 }
 
 void PortManager::RemoveAppFromPorts(const uint32_t appId)
 {
     HDCP_FUNCTION_ENTER;
 
-    for (auto drmObject : m_DrmObjects)
+    // Only visit the ports this app actually enabled or waits for
+    std::unordered_set<uint32_t> portIds;
+
+    ACQUIRE_LOCK(&m_AppPortsMutex);
+    auto entry = m_AppPorts.find(appId);
+    if (m_AppPorts.end() != entry)
+    {
+        portIds.swap(entry->second);
+        m_AppPorts.erase(entry);
+    }
+    RELEASE_LOCK(&m_AppPortsMutex);
+
+    for (auto portId : portIds)
     {
-        DisablePort(drmObject->GetPortId(), appId);
+        DisablePort(portId, appId);
     }
 
     HDCP_FUNCTION_EXIT(SUCCESS);
 }
 
+void PortManager::AddAppPort(const uint32_t appId, const uint32_t portId)
+{
+    ACQUIRE_LOCK(&m_AppPortsMutex);
+    m_AppPorts[appId].insert(portId);
+    RELEASE_LOCK(&m_AppPortsMutex);
+}
+
+void PortManager::RemoveAppPort(const uint32_t appId, const uint32_t portId)
+{
+    ACQUIRE_LOCK(&m_AppPortsMutex);
+    auto entry = m_AppPorts.find(appId);
+    if (m_AppPorts.end() != entry)
+    {
+        entry->second.erase(portId);
+        if (entry->second.empty())
+        {
+            m_AppPorts.erase(entry);
+        }
+    }
+    RELEASE_LOCK(&m_AppPortsMutex);
+}
+
 void PortManager::DisableAllPorts()
 {
     HDCP_FUNCTION_ENTER;
-    
+
+    ACQUIRE_LOCK(&m_AppPortsMutex);
+    m_AppPorts.clear();
+    RELEASE_LOCK(&m_AppPortsMutex);
+
+    // Shutting down, don't let any port linger or retry
+    std::list<DrmObject *> ports;
     for (auto drmObject : m_DrmObjects)
     {
+        if (DRM_MODE_DISCONNECTED == drmObject->GetConnection() ||
+            UINT32_MAX == drmObject->GetPropertyId(CONTENT_PROTECTION))
+        {
+            continue;
+        }
+
+        drmObject->StateAtomicBegin();
         drmObject->ClearRefAppId();
-        drmObject->AddRefAppId(0);
-        DisablePort(drmObject->GetPortId(), 0);
+        drmObject->SetDeadline(UINT64_MAX);
+        drmObject->StateAtomicEnd();
+
+        ports.push_back(drmObject);
+    }
+
+    uint64_t deadline = GetMonotonicTimeMs() + SHUTDOWN_DEADLINE_MS;
+
+    // Turn all ports off with a single commit where we can, otherwise issue
+    // the writes back to back and check them all together afterwards
+    char *ias_env = getenv("XDG_RUNTIME_DIR");
+    if (nullptr != ias_env || SUCCESS != CommitPortsOff(ports))
+    {
+        uint8_t cpValue = CP_OFF;
+        for (auto drmObject : ports)
+        {
+            SetPortProperty(
+                    drmObject->GetDrmId(),
+                    drmObject->GetPropertyId(CONTENT_PROTECTION),
+                    sizeof(uint8_t),
+                    &cpValue,
+                    1);
+        }
+    }
+
+    // Poll every port until it reads back off or the deadline passes
+    while (true)
+    {
+        auto it = ports.begin();
+        while (ports.end() != it)
+        {
+            DrmObject *drmObject = *it;
+            uint8_t cpValue = CP_VALUE_INVALID;
+            uint8_t cpType = CP_TYPE_INVALID;
+
+            drmObject->StateAtomicBegin();
+            int32_t ret = GetProtectionInfo(drmObject, &cpValue, &cpType);
+            bool isOff = (SUCCESS == ret && CP_OFF == cpValue);
+            if (isOff)
+            {
+                drmObject->SetCpType(CP_TYPE_INVALID);
+                drmObject->SetRestoring(false);
+                if (PORT_STATE_IDLE != drmObject->GetState())
+                {
+                    SetPortState(
+                            drmObject,
+                            PORT_STATE_IDLE,
+                            GetMonotonicTimeMs());
+                }
+            }
+
+            // The daemon is going down with all its connections, don't
+            // report every port going idle to the apps
+            std::list<PORT_EVENT> events;
+            std::list<EnableResult> results;
+            drmObject->TakePending(events, results);
+            drmObject->StateAtomicEnd();
+
+            if (isOff)
+            {
+                it = ports.erase(it);
+                continue;
+            }
+            ++it;
+        }
+
+        if (ports.empty() || GetMonotonicTimeMs() >= deadline)
+        {
+            break;
+        }
+
+        SLEEP_MSEC(SHUTDOWN_POLL_INTERVAL_MS);
+    }
+
+    for (auto it = ports.begin(); ports.end() != it; ++it)
+    {
+        HDCP_ASSERTMESSAGE(
+                    "Port %d could not be confirmed off within %d ms",
+                    (*it)->GetPortId(),
+                    SHUTDOWN_DEADLINE_MS);
     }
 
     HDCP_FUNCTION_EXIT(SUCCESS);
 }
 
+int32_t PortManager::CommitPortsOff(const std::list<DrmObject *>& ports)
+{
+    HDCP_FUNCTION_ENTER;
+
+    if (ports.empty())
+    {
+        return SUCCESS;
+    }
+
+    if (SUCCESS != drmSetClientCap(m_DrmFd, DRM_CLIENT_CAP_ATOMIC, 1))
+    {
+        HDCP_WARNMESSAGE("Atomic modesetting is not supported");
+        return ENOTSUP;
+    }
+
+    drmModeAtomicReqPtr req = drmModeAtomicAlloc();
+    if (nullptr == req)
+    {
+        return ENOMEM;
+    }
+
+    int32_t ret = SUCCESS;
+    for (auto drmObject : ports)
+    {
+        if (0 > drmModeAtomicAddProperty(
+                            req,
+                            drmObject->GetDrmId(),
+                            drmObject->GetPropertyId(CONTENT_PROTECTION),
+                            CP_OFF))
+        {
+            HDCP_ASSERTMESSAGE("Could not add port property to commit");
+            ret = EINVAL;
+            break;
+        }
+    }
+
+    if (SUCCESS == ret)
+    {
+        ACQUIRE_LOCK(&m_PropertyMutex);
+        if (drmSetMaster(m_DrmFd) < 0)
+        {
+            HDCP_ASSERTMESSAGE("Could not get drm master privilege");
+            ret = EBUSY;
+        }
+        else
+        {
+            if (SUCCESS != drmModeAtomicCommit(m_DrmFd, req, 0, nullptr))
+            {
+                HDCP_WARNMESSAGE("Atomic commit of CP_OFF failed");
+                ret = EBUSY;
+            }
+
+            drmDropMaster(m_DrmFd);
+        }
+        RELEASE_LOCK(&m_PropertyMutex);
+    }
+
+    drmModeAtomicFree(req);
+
+    HDCP_FUNCTION_EXIT(ret);
+    return ret;
+}
+
 void PortManager::ProcessHotPlug()
 {
     HDCP_FUNCTION_ENTER;
@@ -1090,6 +1580,20 @@ void PortManager::ProcessHotPlug()
         switch(connector->connection)
         {
             case DRM_MODE_DISCONNECTED:
+                // No point retrying authentication without a sink
+                drmObject->StateAtomicBegin();
+                if (PORT_STATE_DESIRED == drmObject->GetState()         ||
+                    PORT_STATE_AUTHENTICATING == drmObject->GetState()  ||
+                    PORT_STATE_RETRYING == drmObject->GetState())
+                {
+                    drmObject->SetDeadline(UINT64_MAX);
+                    SetPortState(
+                            drmObject,
+                            PORT_STATE_IDLE,
+                            GetMonotonicTimeMs());
+                }
+                EndPortUpdate(drmObject);
+
                 m_DaemonSocket.ReportStatus(
                                 PORT_EVENT_PLUG_OUT,
                                 drmObject->GetPortId());
@@ -1128,10 +1632,10 @@ void PortManager::CheckIntegrity()
     for (auto drmObject : m_DrmObjects)
     {
         // Skip if the port has not been enabled yet
-        drmObject->CpTypeAtomicBegin();
-        if (CP_TYPE_INVALID == drmObject->GetCpType())
+        drmObject->StateAtomicBegin();
+        if (PORT_STATE_ENABLED != drmObject->GetState())
         {
-            drmObject->CpTypeAtomicEnd();
+            EndPortUpdate(drmObject);
             continue;
         }
          
@@ -1143,27 +1647,352 @@ void PortManager::CheckIntegrity()
         if (SUCCESS != ret)
         {
             HDCP_WARNMESSAGE("Failed to get protection info");
-            drmObject->CpTypeAtomicEnd();
+            EndPortUpdate(drmObject);
             continue;
         }
 
         if (CP_ENABLED != cpValue)
         {
-            m_DaemonSocket.ReportStatus(
-                            PORT_EVENT_LINK_LOST,
-                            drmObject->GetPortId());
+            SetPortState(drmObject, PORT_STATE_LINK_LOST, GetMonotonicTimeMs());
+            drmObject->AddPendingEvent(PORT_EVENT_LINK_LOST);
 
             HDCP_WARNMESSAGE(
                         "Link lost with port %d",
                         drmObject->GetPortId());
 
             drmObject->SetCpType(CP_TYPE_INVALID);
+
+            // Nobody uses a lingering port, just finish disabling it
+            if (0 == drmObject->GetRefAppCount())
+            {
+                TurnOffPort(drmObject);
+            }
+
+            // Apps still rely on this port, re-request protection at the
+            // last requested level right away instead of waiting for them
+            if (m_IsAutoReauthEnabled.load(std::memory_order_relaxed) &&
+                drmObject->GetRefAppCount() > 0)
+            {
+                uint64_t now = GetMonotonicTimeMs();
+                drmObject->SetFallbackLevel(HDCP_LEVEL0);
+                drmObject->SetRestoring(true);
+                drmObject->SetRetryCount(0);
+                drmObject->SetDeadline(now);
+                SetPortState(drmObject, PORT_STATE_RETRYING, now);
+            }
         }
 
-        drmObject->CpTypeAtomicEnd();
+        EndPortUpdate(drmObject);
     }
 }
 
+void PortManager::SetLingerTime(const uint32_t lingerTimeMs)
+{
+    HDCP_FUNCTION_ENTER;
+
+    HDCP_NORMALMESSAGE("Disable linger time set to %d ms", lingerTimeMs);
+
+    m_LingerTimeMs.store(lingerTimeMs, std::memory_order_relaxed);
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
+
+void PortManager::SetAutoReauth(const bool enable)
+{
+    HDCP_FUNCTION_ENTER;
+
+    HDCP_NORMALMESSAGE(
+                "Automatic re-authentication %s",
+                enable ? "enabled" : "disabled");
+
+    m_IsAutoReauthEnabled.store(enable, std::memory_order_relaxed);
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
+
+uint64_t PortManager::ProcessPortTimers(uint64_t now)
+{
+    uint64_t nextDeadline = UINT64_MAX;
+
+    for (auto drmObject : m_DrmObjects)
+    {
+        drmObject->StateAtomicBegin();
+
+        if (drmObject->GetDeadline() <= now)
+        {
+            RunPortState(drmObject, now);
+        }
+
+        nextDeadline = std::min(nextDeadline, drmObject->GetDeadline());
+
+        EndPortUpdate(drmObject);
+    }
+
+    return nextDeadline;
+}
+
+void PortManager::SetPortState(
+                        DrmObject *drmObject,
+                        PORT_STATE state,
+                        uint64_t now)
+{
+    HDCP_NORMALMESSAGE(
+                "Port %d state %s -> %s",
+                drmObject->GetPortId(),
+                GetPortStateName(drmObject->GetState()),
+                GetPortStateName(state));
+
+    PORT_STATE oldState = drmObject->GetState();
+    drmObject->SetState(state, now);
+
+    // The revocation result only holds for the authenticated topology
+    if (PORT_STATE_ENABLED != state)
+    {
+        drmObject->SetRevokedKsvCount(0);
+    }
+
+    // Only entering or leaving enabled and going idle change the status
+    // reported for the port. Invalidate what the apps cached before they
+    // get any response that depends on the new state.
+    if (PORT_STATE_ENABLED == state     ||
+        PORT_STATE_ENABLED == oldState  ||
+        PORT_STATE_IDLE == state)
+    {
+        drmObject->AddPendingEvent(PORT_EVENT_NONE);
+    }
+
+    // Answer the enable requests waiting on the port once it settles
+    if (drmObject->HasWaiters() &&
+        (PORT_STATE_ENABLED == state || PORT_STATE_IDLE == state))
+    {
+        CompleteWaiters(drmObject, now);
+    }
+}
+
+void PortManager::EndPortUpdate(DrmObject *drmObject)
+{
+    std::list<PORT_EVENT> events;
+    std::list<EnableResult> results;
+    drmObject->TakePending(events, results);
+    drmObject->StateAtomicEnd();
+
+    // A stalled app only holds up this thread from here, not the port
+    for (auto event : events)
+    {
+        m_DaemonSocket.ReportStatus(event, drmObject->GetPortId());
+    }
+
+    for (auto& result : results)
+    {
+        m_DaemonSocket.CompleteSetProtectionLevel(
+                                result.appId,
+                                drmObject->GetPortId(),
+                                result.level,
+                                result.sts);
+    }
+}
+
+void PortManager::RunPortState(DrmObject *drmObject, uint64_t now)
+{
+    uint8_t cpValue = CP_VALUE_INVALID;
+    uint8_t cpType  = CP_TYPE_INVALID;
+    int32_t ret     = EINVAL;
+
+    switch (drmObject->GetState())
+    {
+        case PORT_STATE_DESIRED:
+            // A failed attempt may have left the KMD stuck in desired,
+            // start over from off
+            if (drmObject->GetRetryCount() > 0)
+            {
+                cpValue = CP_OFF;
+                SetPortProperty(
+                        drmObject->GetDrmId(),
+                        drmObject->GetPropertyId(CONTENT_PROTECTION),
+                        sizeof(uint8_t),
+                        &cpValue,
+                        1);
+            }
+
+            // Only set Cp_Content_Type property when the port is HDCP type1
+            // capable
+            if (UINT32_MAX != drmObject->GetPropertyId(CP_CONTENT_TYPE))
+            {
+                // Translate level to cpType
+                cpType = (HDCP_LEVEL2 == drmObject->GetLevel()) ?
+                            CP_TYPE_1 : CP_TYPE_0;
+
+                ret = SetPortProperty(
+                                drmObject->GetDrmId(),
+                                drmObject->GetPropertyId(CP_CONTENT_TYPE),
+                                sizeof(uint8_t),
+                                &cpType,
+                                1);
+                if (SUCCESS != ret)
+                {
+                    HDCP_WARNMESSAGE(
+                                "Port %d set content_type property failed",
+                                drmObject->GetPortId());
+                    ScheduleRetry(drmObject, now);
+                    break;
+                }
+            }
+
+            cpValue = CP_DESIRED;
+            ret = SetPortProperty(
+                            drmObject->GetDrmId(),
+                            drmObject->GetPropertyId(CONTENT_PROTECTION),
+                            sizeof(uint8_t),
+                            &cpValue,
+                            1);
+            if (SUCCESS != ret)
+            {
+                HDCP_WARNMESSAGE(
+                            "Port %d set content protection property failed",
+                            drmObject->GetPortId());
+                ScheduleRetry(drmObject, now);
+                break;
+            }
+
+            SetPortState(drmObject, PORT_STATE_AUTHENTICATING, now);
+            drmObject->SetDeadline(now + AUTH_POLL_INTERVAL_MS);
+            break;
+
+        case PORT_STATE_AUTHENTICATING:
+            // Check whether Content Protection property is CP_ENABLED or not
+            ret = GetProtectionInfo(drmObject, &cpValue, &cpType);
+            if (SUCCESS == ret && CP_ENABLED == cpValue)
+            {
+                drmObject->SetCpType(cpType);
+                drmObject->SetRetryCount(0);
+                drmObject->SetDeadline(UINT64_MAX);
+                CheckTopologyRevocation(drmObject);
+                SetPortState(drmObject, PORT_STATE_ENABLED, now);
+
+                if (drmObject->IsRestoring())
+                {
+                    drmObject->SetRestoring(false);
+                    drmObject->AddPendingEvent(PORT_EVENT_LINK_RESTORED);
+
+                    HDCP_NORMALMESSAGE(
+                                "Link restored with port %d",
+                                drmObject->GetPortId());
+                }
+                break;
+            }
+
+            if (now - drmObject->GetStateTime() >= AUTH_CHECK_DELAY_MS)
+            {
+                HDCP_WARNMESSAGE(
+                            "Port %d authentication timed out",
+                            drmObject->GetPortId());
+                ScheduleRetry(drmObject, now);
+                break;
+            }
+
+            drmObject->SetDeadline(now + AUTH_POLL_INTERVAL_MS);
+            break;
+
+        case PORT_STATE_RETRYING:
+            SetPortState(drmObject, PORT_STATE_DESIRED, now);
+            drmObject->SetDeadline(now);
+            break;
+
+        case PORT_STATE_ENABLED:
+            // Linger timer expired without a new enable request
+            if (0 == drmObject->GetRefAppCount())
+            {
+                HDCP_NORMALMESSAGE(
+                            "Port %d linger time expired",
+                            drmObject->GetPortId());
+                if (SUCCESS == TurnOffPort(drmObject))
+                {
+                    break;
+                }
+            }
+            drmObject->SetDeadline(UINT64_MAX);
+            break;
+
+        default:
+            drmObject->SetDeadline(UINT64_MAX);
+            break;
+    }
+}
+
+void PortManager::ScheduleRetry(DrmObject *drmObject, uint64_t now)
+{
+    uint32_t retryCount = drmObject->GetRetryCount() + 1;
+    drmObject->SetRetryCount(retryCount);
+
+    if (retryCount >= AUTH_MAX_ATTEMPTS)
+    {
+        HDCP_ASSERTMESSAGE(
+                    "Port %d failed to authenticate after %d attempts",
+                    drmObject->GetPortId(),
+                    retryCount);
+
+        // Don't leave the KMD retrying on its own, the daemon and the KMD
+        // must agree the port is off
+        uint8_t cpValue = CP_OFF;
+        SetPortProperty(
+                drmObject->GetDrmId(),
+                drmObject->GetPropertyId(CONTENT_PROTECTION),
+                sizeof(uint8_t),
+                &cpValue,
+                1);
+        drmObject->SetCpType(CP_TYPE_INVALID);
+
+        // If apps still hold the port this was a failed upgrade and they
+        // lost their protection. A failed restore already reported it.
+        bool inUse = drmObject->GetRefAppCount() > 0;
+        if (inUse && !drmObject->IsRestoring())
+        {
+            drmObject->AddPendingEvent(PORT_EVENT_LINK_LOST);
+        }
+
+        // Fail the upgrade requests and restore the level the current users
+        // were enabled with, the link restored report tells them it is back
+        uint8_t fallbackLevel = drmObject->GetFallbackLevel();
+        if (inUse && HDCP_LEVEL0 != fallbackLevel)
+        {
+            HDCP_NORMALMESSAGE(
+                        "Port %d fall back to level %d",
+                        drmObject->GetPortId(),
+                        fallbackLevel);
+
+            FailWaiters(drmObject);
+            drmObject->SetLevel(fallbackLevel);
+            drmObject->SetFallbackLevel(HDCP_LEVEL0);
+            drmObject->SetRestoring(true);
+            drmObject->SetRetryCount(0);
+            drmObject->SetDeadline(now);
+            SetPortState(drmObject, PORT_STATE_DESIRED, now);
+            return;
+        }
+
+        drmObject->SetRestoring(false);
+        drmObject->SetDeadline(UINT64_MAX);
+        SetPortState(drmObject, PORT_STATE_IDLE, now);
+        return;
+    }
+
+    // Exponential backoff plus up to 50% random jitter, so that ports which
+    // failed together don't retry in lockstep
+    uint64_t backoff = std::min(
+                        AUTH_RETRY_BACKOFF_BASE_MS << (retryCount - 1),
+                        AUTH_RETRY_BACKOFF_MAX_MS);
+    backoff += m_Rng() % (backoff / 2 + 1);
+
+    HDCP_NORMALMESSAGE(
+                "Port %d retry %d in %d ms",
+                drmObject->GetPortId(),
+                retryCount,
+                static_cast<uint32_t>(backoff));
+
+    drmObject->SetDeadline(now + backoff);
+    SetPortState(drmObject, PORT_STATE_RETRYING, now);
+}
+
 int32_t PortManager::SetPortProperty(
                             int32_t drmId,
                             int32_t propId,
@@ -1185,8 +2014,10 @@ int32_t PortManager::SetPortProperty(
     }
 
     if(!ias_env) {
+        ACQUIRE_LOCK(&m_PropertyMutex);
         if (drmSetMaster(m_DrmFd) < 0)
 	{
+	    RELEASE_LOCK(&m_PropertyMutex);
 	    HDCP_ASSERTMESSAGE("Could not get drm master privilege");
 	    return EBUSY;
 	}
@@ -1198,6 +2029,8 @@ int32_t PortManager::SetPortProperty(
 	    ret = drmModeCreatePropertyBlob(m_DrmFd, value, size, &propValue);
 	    if (SUCCESS != ret)
 	    {
+	        drmDropMaster(m_DrmFd);
+	        RELEASE_LOCK(&m_PropertyMutex);
 	        HDCP_ASSERTMESSAGE("Could not create blob");
 	        return EBUSY;
 	    }
@@ -1219,15 +2052,19 @@ int32_t PortManager::SetPortProperty(
 	}
 	if (SUCCESS != ret)
 	{
+	    drmDropMaster(m_DrmFd);
+	    RELEASE_LOCK(&m_PropertyMutex);
 	    HDCP_ASSERTMESSAGE("Could not set port property");
 	    return EBUSY;
 	}
         //We must drop master privilege here
         if (drmDropMaster(m_DrmFd) < 0)
         {
+            RELEASE_LOCK(&m_PropertyMutex);
             HDCP_ASSERTMESSAGE("Could not drop drm master privilege");
 	    return EBUSY;
 	}
+        RELEASE_LOCK(&m_PropertyMutex);
     }
     else
     {
@@ -1465,4 +2302,11 @@ int32_t PortManagerHWComposer::SetPortProperty(
     HDCP_FUNCTION_EXIT(ret);
     return ret;
 }
+
+int32_t PortManagerHWComposer::CommitPortsOff(
+                            const std::list<DrmObject *>& ports)
+{
+    // Hardware Composer owns the display, properties only go through it
+    return ENOTSUP;
+}
 #endif
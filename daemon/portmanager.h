@@ -27,7 +27,11 @@
 #ifndef __HDCP_PORTMANAGER_H__
 #define __HDCP_PORTMANAGER_H__
 
+#include <atomic>
 #include <list>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
 #include <pthread.h>
 #include <time.h>
 
@@ -48,7 +52,17 @@
 #define THREAD_STARTUP_BACKOFF_DELAY_US     100
 #define AUTH_CHECK_DELAY_MS                 1000
 #define INTEGRITY_CHECK_DELAY_MS            500
-#define AUTH_NUM_RETRY                      3
+
+// Port state machine timing
+#define AUTH_POLL_INTERVAL_MS               50
+#define AUTH_MAX_ATTEMPTS                   3
+#define AUTH_RETRY_BACKOFF_BASE_MS          200
+#define AUTH_RETRY_BACKOFF_MAX_MS           2000
+#define DISABLE_LINGER_MAX_MS               60000
+
+// Bound on the time DisableAllPorts waits for all ports to read back off
+#define SHUTDOWN_DEADLINE_MS                500
+#define SHUTDOWN_POLL_INTERVAL_MS           10
 
 //KMD content protection value
 #define CP_VALUE_INVALID    UINT8_MAX
@@ -67,6 +81,10 @@
 #define CP_DOWNSTREAM_INFO          "CP_Downstream_Info"
 #define CP_SRM                      "CP_SRM"
 
+// Values of DownstreamInfo hdcpVersion
+#define HDCP_VERSION_14_IN_FORCE    (1 << 0)
+#define HDCP_VERSION_22_IN_FORCE    (1 << 1)
+
 typedef struct _DownstreamInfo
 {
     // HDCP ver in force
@@ -106,6 +124,26 @@ private:
     int32_t                 m_DrmFd;
     std::list<DrmObject *>  m_DrmObjects;
 
+    // drmSetMaster/drmDropMaster bracket every property write, and writes
+    // come from both the dispatch thread and the port timer thread
+    pthread_mutex_t         m_PropertyMutex;
+
+    // Source of the retry backoff jitter, only used by the timer thread
+    std::minstd_rand        m_Rng;
+
+    // Re-enable ports that lost the link while apps still reference them.
+    // Set by the dispatch thread, read by the timer thread.
+    std::atomic<bool>       m_IsAutoReauthEnabled;
+
+    // Time a port stays enabled after its last app released it.
+    // Set by the dispatch thread, read by the timer thread.
+    std::atomic<uint32_t>   m_LingerTimeMs;
+
+    // Ports each app holds a reference on or waits for, so that app exit
+    // only visits those. Lock order is port state lock, then this lock.
+    std::unordered_map<uint32_t, std::unordered_set<uint32_t>> m_AppPorts;
+    pthread_mutex_t         m_AppPortsMutex;
+
     // Declare public interface functions
 public:
 
@@ -155,7 +193,11 @@ public:
     ///
     /// \param[in]  portId, Port Id on which to enable HDCP
     /// \param[in]  appId,  Id corresponding to the calling application
-    /// \return     SUCCESS or errno otherwise
+    /// \return     SUCCESS if already enabled, EINPROGRESS if the request
+    ///             waits on the state machine, errno otherwise
+    ///
+    /// For EINPROGRESS, the result is sent to the app through
+    /// HdcpDaemon::CompleteSetProtectionLevel once the port settles.
     ///////////////////////////////////////////////////////////////////////////
     int32_t EnablePort(
                     const uint32_t portId,
@@ -185,22 +227,15 @@ public:
     ///
     /// \param[in]   portId,  Port Id on which to get ksv list
     /// \param[out]  ksvList, list of ksvs connected/enabled in topology
+    /// \param[out]  revokedCount, number of ksvs of the list found in the SRM
     /// \return      SUCCESS or errno otherwise
     ///////////////////////////////////////////////////////////////////////////
     int32_t GetKsvList(
                     const uint32_t portId,
                     uint8_t *ksvCount,
                     uint8_t *depth,
-                    uint8_t *ksvList);
-
-    ///////////////////////////////////////////////////////////////////////////
-    /// \brief  Store the SRM Data to fw file
-    ///
-    /// \param[in]   portId,  Port Id on which to get ksv list
-    /// \param[out]  ksvCount, the number of KSVs in the topology
-    /// \return      SUCCESS or errno otherwise
-    ///////////////////////////////////////////////////////////////////////////
-    int32_t SendSRMData(const uint8_t *data, const uint32_t size);
+                    uint8_t *ksvList,
+                    uint8_t *revokedCount);
 
     ///////////////////////////////////////////////////////////////////////////
     /// \brief  Process an HDCP hotplug in or out uEvent
@@ -212,6 +247,28 @@ public:
     ///////////////////////////////////////////////////////////////////////////
     void CheckIntegrity();
 
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Enable or disable automatic re-authentication after link lost
+    ///
+    /// \param[in]  enable, true to re-enable ports by the daemon itself
+    ///////////////////////////////////////////////////////////////////////////
+    void SetAutoReauth(const bool enable);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Set how long a port stays enabled after its last release
+    ///
+    /// \param[in]  lingerTimeMs, linger time in ms, 0 disables immediately
+    ///////////////////////////////////////////////////////////////////////////
+    void SetLingerTime(const uint32_t lingerTimeMs);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Run the state machine of every port whose deadline expired
+    ///
+    /// \param[in]  now,    current monotonic time (ms)
+    /// \return     earliest deadline of all ports, UINT64_MAX if none
+    ///////////////////////////////////////////////////////////////////////////
+    uint64_t ProcessPortTimers(uint64_t now);
+
     ///////////////////////////////////////////////////////////////////////////
     /// \brief  Remove an appId from the active lists of all ports
     ///
@@ -221,6 +278,12 @@ public:
 
     ///////////////////////////////////////////////////////////////////////////
     /// \brief  Disable all ports
+    ///
+    /// All ports are turned off together and then polled until they read
+    /// back off, at most SHUTDOWN_DEADLINE_MS. Ports that could not be
+    /// confirmed off by then are reported in the log. Only used on shutdown,
+    /// the apps are not told about the ports going idle. Takes locks and
+    /// sleeps, so it must not run in a signal handler.
     ///////////////////////////////////////////////////////////////////////////
     void DisableAllPorts();
 
@@ -243,6 +306,109 @@ protected:
     ///////////////////////////////////////////////////////////////////////////
     DrmObject* GetDrmObjectByDrmId(const uint32_t id);
 
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Move a port to a new state, every transition goes through here
+    ///         so that it is logged and waiters on the port are woken up.
+    ///         Must be called between StateAtomicBegin and EndPortUpdate.
+    ///
+    /// \param[in]  drmObject,  drm object
+    /// \param[in]  state,      new state
+    /// \param[in]  now,        current monotonic time (ms)
+    ///////////////////////////////////////////////////////////////////////////
+    void SetPortState(DrmObject *drmObject, PORT_STATE state, uint64_t now);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Release the state lock of a port, then send the status reports
+    ///         and enable results queued under it.
+    ///         Every StateAtomicBegin that may change the state ends here.
+    ///
+    /// \param[in]  drmObject,  drm object
+    ///////////////////////////////////////////////////////////////////////////
+    void EndPortUpdate(DrmObject *drmObject);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Run one step of the state machine of a port.
+    ///         Must be called between StateAtomicBegin and EndPortUpdate.
+    ///
+    /// \param[in]  drmObject,  drm object
+    /// \param[in]  now,        current monotonic time (ms)
+    ///////////////////////////////////////////////////////////////////////////
+    void RunPortState(DrmObject *drmObject, uint64_t now);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Account a failed enable attempt and arm the backoff timer, or
+    ///         give up once AUTH_MAX_ATTEMPTS is reached. A failed upgrade
+    ///         falls back to the level the port was enabled with before.
+    ///         Must be called between StateAtomicBegin and EndPortUpdate.
+    ///
+    /// \param[in]  drmObject,  drm object
+    /// \param[in]  now,        current monotonic time (ms)
+    ///////////////////////////////////////////////////////////////////////////
+    void ScheduleRetry(DrmObject *drmObject, uint64_t now);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Answer the enable requests waiting on a port that settled.
+    ///         Requests for a higher level than the port got enabled with
+    ///         stay queued and start an upgrade.
+    ///         Must be called between StateAtomicBegin and EndPortUpdate.
+    ///
+    /// \param[in]  drmObject,  drm object
+    /// \param[in]  now,        current monotonic time (ms)
+    ///////////////////////////////////////////////////////////////////////////
+    void CompleteWaiters(DrmObject *drmObject, uint64_t now);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Fail all enable requests waiting on a port with EBUSY.
+    ///         Must be called between StateAtomicBegin and EndPortUpdate.
+    ///
+    /// \param[in]  drmObject,  drm object
+    ///////////////////////////////////////////////////////////////////////////
+    void FailWaiters(DrmObject *drmObject);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Write CP_OFF to a port, check it and move the port to idle.
+    ///         Must be called between StateAtomicBegin and EndPortUpdate.
+    ///
+    /// \param[in]  drmObject,  drm object
+    /// \return     SUCCESS or errno otherwise
+    ///////////////////////////////////////////////////////////////////////////
+    int32_t TurnOffPort(DrmObject *drmObject);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Check the authenticated topology of a port against the SRM and
+    ///         record the number of revoked devices on the port.
+    ///         Must be called between StateAtomicBegin and StateAtomicEnd.
+    ///
+    /// \param[in]  drmObject,  drm object
+    ///////////////////////////////////////////////////////////////////////////
+    void CheckTopologyRevocation(DrmObject *drmObject);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Flatten a topology into a ksv list, BKSV first
+    ///
+    /// \param[in]  dsInfo,     downstream info of the port
+    /// \param[out] ksvList,    receives up to MAX_KSV_COUNT ksvs
+    /// \return     number of ksvs in the topology, which may be larger than
+    ///             the number copied
+    ///////////////////////////////////////////////////////////////////////////
+    uint32_t GetTopologyKsvs(const DownstreamInfo& dsInfo, uint8_t *ksvList);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Record that an app references or waits for a port
+    ///
+    /// \param[in]  appId,  Id of the app
+    /// \param[in]  portId, Id of the port
+    ///////////////////////////////////////////////////////////////////////////
+    void AddAppPort(const uint32_t appId, const uint32_t portId);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Forget that an app references or waits for a port
+    ///
+    /// \param[in]  appId,  Id of the app
+    /// \param[in]  portId, Id of the port
+    ///////////////////////////////////////////////////////////////////////////
+    void RemoveAppPort(const uint32_t appId, const uint32_t portId);
+
     ///////////////////////////////////////////////////////////////////////////
     /// \brief  Get Content Protection Value
     ///
@@ -276,6 +442,16 @@ protected:
                         const uint8_t *value,
                         uint32_t numRetry);
 
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Virtual function to turn off content protection on several
+    ///         ports with a single atomic commit.
+    ///
+    /// \param[in]  ports,      ports to turn off
+    /// \return     int32_t     SUCCESS, or errno if the caller has to fall
+    ///                         back to SetPortProperty on each port
+    ///////////////////////////////////////////////////////////////////////////
+    virtual int32_t CommitPortsOff(const std::list<DrmObject *>& ports);
+
     ///////////////////////////////////////////////////////////////////////////
     /// \brief  Get DownStreamInfo
     ///
@@ -292,6 +468,11 @@ protected:
     ///////////////////////////////////////////////////////////////////////////
     int32_t InitDrmObjects();
 
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Terminate signal handler, wakes up the shutdown thread
+    ///
+    /// \param[in]  sig,    signal being received
+    ///////////////////////////////////////////////////////////////////////////
     static void SigCatcher(int sig);
 };
 
@@ -329,6 +510,15 @@ public:
                         int32_t size,
                         const uint8_t *value,
                         uint32_t numRetry);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Atomic commits are not available through Hardware Composer,
+    ///         always fall back to SetPortProperty.
+    ///
+    /// \param[in]  ports,      ports to turn off
+    /// \return     int32_t     ENOTSUP
+    ///////////////////////////////////////////////////////////////////////////
+    virtual int32_t CommitPortsOff(const std::list<DrmObject *>& ports);
 };
 #endif
 
@@ -372,7 +562,8 @@ int32_t PortManagerEnumeratePorts(
 ///
 /// \param[in]  portId, Port Id on which to enable HDCP
 /// \param[in]  appId,  Id corresponding to the calling application
-/// \return     SUCCESS or errno otherwise
+/// \return     SUCCESS, EINPROGRESS if the result is sent later through
+///             HdcpDaemon::CompleteSetProtectionLevel, or errno otherwise
 ///////////////////////////////////////////////////////////////////////////////
 int32_t PortManagerEnablePort(
                         const uint32_t portId,
@@ -388,6 +579,22 @@ int32_t PortManagerEnablePort(
 ///////////////////////////////////////////////////////////////////////////////
 int32_t PortManagerDisablePort(const uint32_t portId, const uint32_t appId);
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Enable or disable automatic re-authentication after link lost
+///
+/// \param[in]  enable, true to re-enable ports with active apps by the daemon
+/// \return     SUCCESS or errno otherwise
+///////////////////////////////////////////////////////////////////////////////
+int32_t PortManagerConfigAutoReauth(const bool enable);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Set how long a port stays enabled after its last app released it
+///
+/// \param[in]  lingerTimeMs, linger time in ms, 0 disables immediately
+/// \return     SUCCESS or errno otherwise
+///////////////////////////////////////////////////////////////////////////////
+int32_t PortManagerConfigLingerTime(const uint32_t lingerTimeMs);
+
 ///////////////////////////////////////////////////////////////////////////////
 /// \brief  Get the status of the specified port
 ///
@@ -404,19 +611,15 @@ int32_t PortManagerGetStatus(const uint32_t portId, PORT_STATUS *portStatus);
 /// \param[out]  ksvCount, number of KSVs in the topology
 /// \param[out]  depth, depth of the HDCP1 topology
 /// \param[out]  ksvList, list of ksvs connected/enabled in topology
+/// \param[out]  revokedCount, number of ksvs of the list found in the SRM
 /// \return      SUCCESS or errno otherwise
 ///////////////////////////////////////////////////////////////////////////////
 int32_t PortManagerGetKsvList(
                         const uint32_t portId,
                         uint8_t *ksvCount,
                         uint8_t *depth,
-                        uint8_t *ksvList);
-
-///////////////////////////////////////////////////////////////////////////////
-/// \brief  Send SRM Data to the fw file
-///
-///////////////////////////////////////////////////////////////////////////////
-int32_t PortManagerSendSRMDdata(const uint8_t *data, const uint32_t size);
+                        uint8_t *ksvList,
+                        uint8_t *revokedCount);
 
 ///////////////////////////////////////////////////////////////////////////////
 /// \brief  Process an HDCP hotplug in or out uEvent
@@ -26,16 +26,30 @@
 
 #include <list>
 #include <new>
+#include <vector>
+#include <memory>
+#include <string>
+#include <algorithm>
 #include <openssl/dsa.h>
 #include <openssl/sha.h>
 #include <openssl/bn.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
 #include <openssl/opensslv.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/param_build.h>
+#endif
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <unistd.h>
-#include <sys/mman.h>
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <limits.h>
 #include <string.h>
 #include <memory.h>
 
@@ -45,6 +59,10 @@
 // Add compatibility layer for openssl 1.0 as suggested by openssl
 // https://wiki.openssl.org/index.php/OpenSSL_1.1.0_Changes#Compatibility_Layer
 #if OPENSSL_VERSION_NUMBER < 0x10100000
+#define EVP_MD_CTX_new      EVP_MD_CTX_create
+#define EVP_MD_CTX_free     EVP_MD_CTX_destroy
+#define EVP_MD_CTX_reset    EVP_MD_CTX_cleanup
+
 int32_t DSA_set0_pqg(DSA *d, BIGNUM *p, BIGNUM *q, BIGNUM *g)
 {
     // If the fields p, q and g in d are nullptr, the corresponding input
@@ -121,6 +139,207 @@ int32_t DSA_set0_key(DSA *d, BIGNUM *pub_key, BIGNUM *priv_key)
 // Global Variables
 static SrmTable* g_pSrmTable = nullptr;
 
+// Files of each SrmFormat
+static const struct
+{
+    const char  *storage;
+    const char  *storageBasename;
+} g_SrmFiles[SRM_FORMAT_COUNT] =
+{
+    {SRM_STORAGE_FILENAME, SRM_STORAGE_BASENAME},
+    {SRM2_STORAGE_FILENAME, SRM2_STORAGE_BASENAME},
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Replace a file by writing a temporary file next to it, syncing it
+///         and renaming it over the original, so a crash leaves either the
+///         old or the new content
+///
+/// \param[in]  path    file to replace
+/// \param[in]  data    new content
+/// \param[in]  size    size in bytes of the new content
+/// \return     SUCCESS or errno otherwise
+///////////////////////////////////////////////////////////////////////////////
+static int32_t WriteFileAtomic(
+                    const char *path,
+                    const uint8_t *data,
+                    const size_t size)
+{
+    HDCP_FUNCTION_ENTER;
+
+    std::string tmpPath = std::string(path) + ".tmp";
+
+    int32_t fd = open(
+                    tmpPath.c_str(),
+                    O_WRONLY|O_CREAT|O_TRUNC,
+                    S_IRUSR|S_IWUSR);
+    if (ERROR == fd)
+    {
+        int32_t ret = errno;
+        HDCP_ASSERTMESSAGE(
+                "Could not open %s. Err: %s",
+                tmpPath.c_str(),
+                strerror(ret));
+        return ret;
+    }
+
+    size_t total = 0;
+    while (total < size)
+    {
+        ssize_t written = write(fd, data + total, size - total);
+        if (0 >= written)
+        {
+            if (ERROR == written && EINTR == errno)
+            {
+                continue;
+            }
+            break;
+        }
+        total += written;
+    }
+
+    int32_t ret = SUCCESS;
+    if (total != size)
+    {
+        ret = EIO;
+    }
+    else if (ERROR == fsync(fd))
+    {
+        ret = errno;
+    }
+
+    if (SUCCESS != ret)
+    {
+        HDCP_ASSERTMESSAGE(
+                "Failed to write %s. Err: %s",
+                tmpPath.c_str(),
+                strerror(ret));
+    }
+
+    close(fd);
+
+    if (SUCCESS == ret && ERROR == rename(tmpPath.c_str(), path))
+    {
+        ret = errno;
+        HDCP_ASSERTMESSAGE(
+                "Failed to rename to %s. Err: %s",
+                path,
+                strerror(ret));
+    }
+
+    if (SUCCESS != ret)
+    {
+        unlink(tmpPath.c_str());
+        return ret;
+    }
+
+    // Make the rename itself durable
+    std::string dirPath(path, strrchr(path, '/') - path);
+    int32_t dirFd = open(dirPath.c_str(), O_RDONLY|O_DIRECTORY);
+    if (ERROR != dirFd)
+    {
+        fsync(dirFd);
+        close(dirFd);
+    }
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Check if a file already holds the given content
+///
+/// \param[in]  path    file to check
+/// \param[in]  data    expected content
+/// \param[in]  size    size in bytes of the expected content
+/// \return     true if the file content matches
+///////////////////////////////////////////////////////////////////////////////
+static bool IsFileContent(
+                const char *path,
+                const uint8_t *data,
+                const size_t size)
+{
+    int32_t fd = open(path, O_RDONLY);
+    if (ERROR == fd)
+    {
+        return false;
+    }
+
+    struct stat sb  = {};
+    if (ERROR == fstat(fd, &sb) || static_cast<size_t>(sb.st_size) != size)
+    {
+        close(fd);
+        return false;
+    }
+
+    std::vector<uint8_t> content(size);
+    ssize_t bytesRead = read(fd, content.data(), size);
+    close(fd);
+
+    return bytesRead == static_cast<ssize_t>(size) &&
+           0 == memcmp(content.data(), data, size);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Read a whole regular file
+///
+/// \param[in]  path    file to read
+/// \param[out] data    content of the file, empty for an empty file
+/// \return     SUCCESS or errno otherwise
+///////////////////////////////////////////////////////////////////////////////
+static int32_t ReadFile(const char *path, std::vector<uint8_t>& data)
+{
+    int32_t fd = open(path, O_RDONLY);
+    if (ERROR == fd)
+    {
+        return errno;
+    }
+
+    struct stat sb  = {};
+    if (ERROR == fstat(fd, &sb) || !S_ISREG(sb.st_mode))
+    {
+        close(fd);
+        return EINVAL;
+    }
+
+    data.resize(sb.st_size);
+    ssize_t bytesRead = 0;
+    if (!data.empty())
+    {
+        bytesRead = read(fd, data.data(), data.size());
+    }
+    close(fd);
+
+    if (bytesRead != static_cast<ssize_t>(data.size()))
+    {
+        return EIO;
+    }
+
+    return SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Compute the SHA-256 of a buffer through EVP
+///
+/// \param[in]  data    buffer to hash
+/// \param[in]  size    size in bytes of the buffer
+/// \param[out] digest  SHA-256 of the buffer
+/// \return     digest
+///////////////////////////////////////////////////////////////////////////////
+static uint8_t *Sha256(
+                    const uint8_t *data,
+                    const size_t size,
+                    uint8_t digest[SHA256_DIGEST_LENGTH])
+{
+    if (1 != EVP_Digest(data, size, digest, nullptr, EVP_sha256(), nullptr))
+    {
+        // Only on allocation failure, never leave the digest undefined
+        memset(digest, 0, SHA256_DIGEST_LENGTH);
+    }
+
+    return digest;
+}
+
 // prime modulus for DSA
 static const uint8_t g_dsaP[] =
 {
@@ -209,29 +428,182 @@ void DisableFacsimileKeyUse(void)
 }
 #endif
 
-int32_t SrmTable::VerifySignature(
-                const uint8_t   *pMsg,
+SignatureEngine::SignatureEngine(EVP_PKEY *key, const char *mdName) :
+            m_Key(key),
+            m_Md(nullptr),
+            m_IsDsa(false)
+{
+    HDCP_FUNCTION_ENTER;
+
+    if (nullptr == m_Key)
+    {
+        return;
+    }
+
+    m_IsDsa = (EVP_PKEY_DSA == EVP_PKEY_id(m_Key));
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    m_Md = EVP_MD_fetch(nullptr, mdName, nullptr);
+#else
+    m_Md = EVP_get_digestbyname(mdName);
+#endif
+    if (nullptr == m_Md)
+    {
+        HDCP_ASSERTMESSAGE("Digest %s is not available", mdName);
+    }
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
+
+SignatureEngine::~SignatureEngine(void)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_MD_free(m_Md);
+#endif
+    EVP_PKEY_free(m_Key);
+}
+
+bool SignatureEngine::IsValid(void) const
+{
+    return nullptr != m_Key && nullptr != m_Md;
+}
+
+int32_t SignatureEngine::Verify(
+                EVP_MD_CTX      *ctx,
+                const uint8_t   *msg,
                 const uint32_t  msgLen,
-                const uint8_t   pR[DSA_SIG_LENGTH],
-                const uint8_t   pS[DSA_SIG_LENGTH])
+                const uint8_t   *sig,
+                const uint32_t  sigLen) const
 {
     HDCP_FUNCTION_ENTER;
 
-    DSA *dsa = DSA_new();
-    if (nullptr == dsa)
+    CHECK_PARAM_NULL(ctx, EINVAL);
+    CHECK_PARAM_NULL(msg, EINVAL);
+    CHECK_PARAM_NULL(sig, EINVAL);
+
+    const uint8_t   *encodedSig     = sig;
+    size_t          encodedSigLen   = sigLen;
+    uint8_t         *der            = nullptr;
+
+    if (m_IsDsa)
     {
-        return ENOMEM;
+        if (2 * DSA_SIG_LENGTH != sigLen)
+        {
+            return EINVAL;
+        }
+
+        DSA_SIG *dsaSig = DSA_SIG_new();
+        if (nullptr == dsaSig)
+        {
+            return ENOMEM;
+        }
+
+        BIGNUM *r = BN_bin2bn(sig, DSA_SIG_LENGTH, nullptr);
+        BIGNUM *s = BN_bin2bn(sig + DSA_SIG_LENGTH, DSA_SIG_LENGTH, nullptr);
+
+        if (DSA_SUCCESS != DSA_SIG_set0(dsaSig, r, s))
+        {
+            DSA_SIG_free(dsaSig);
+            BN_free(r);
+            BN_free(s);
+            return EINVAL;
+        }
+
+        // EVP verifies DER encoded signatures
+        int32_t derLen = i2d_DSA_SIG(dsaSig, &der);
+        DSA_SIG_free(dsaSig);
+        if (0 >= derLen)
+        {
+            return ENOMEM;
+        }
+
+        encodedSig      = der;
+        encodedSigLen   = derLen;
     }
 
-    DSA_SIG *sig = DSA_SIG_new();
-    if (nullptr == sig)
+    // EVP functions return 1 on success
+    int32_t ret = EINVAL;
+    EVP_PKEY_CTX *pkeyCtx = nullptr;
+    EVP_MD_CTX_reset(ctx);
+    if (1 == EVP_DigestVerifyInit(ctx, &pkeyCtx, m_Md, nullptr, m_Key) &&
+        (m_IsDsa ||
+         1 == EVP_PKEY_CTX_set_rsa_padding(pkeyCtx, RSA_PKCS1_PADDING)) &&
+        1 == EVP_DigestVerifyUpdate(ctx, msg, msgLen) &&
+        1 == EVP_DigestVerifyFinal(ctx, encodedSig, encodedSigLen))
     {
-        DSA_free(dsa);
-        return ENOMEM;
+        ret = SUCCESS;
+    }
+
+    OPENSSL_free(der);
+
+    HDCP_FUNCTION_EXIT(ret);
+    return ret;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+EVP_PKEY *SignatureEngine::CreateDsaKey(
+                const uint8_t   *pubKey,
+                const size_t    pubKeySize)
+{
+    HDCP_FUNCTION_ENTER;
+
+    EVP_PKEY        *key    = nullptr;
+    OSSL_PARAM      *params = nullptr;
+    OSSL_PARAM_BLD  *bld    = OSSL_PARAM_BLD_new();
+    EVP_PKEY_CTX    *ctx    = EVP_PKEY_CTX_new_from_name(
+                                                nullptr,
+                                                "DSA",
+                                                nullptr);
+
+    // Do an endian conversion and convert type to BIGNUM for the values
+    BIGNUM *p       = BN_bin2bn(g_dsaP, sizeof(g_dsaP), nullptr);
+    BIGNUM *q       = BN_bin2bn(g_dsaQ, sizeof(g_dsaQ), nullptr);
+    BIGNUM *g       = BN_bin2bn(g_dsaG, sizeof(g_dsaG), nullptr);
+    BIGNUM *pub_key = BN_bin2bn(pubKey, pubKeySize, nullptr);
+
+    if (nullptr != bld && nullptr != ctx &&
+        1 == OSSL_PARAM_BLD_push_BN(bld, OSSL_PKEY_PARAM_FFC_P, p) &&
+        1 == OSSL_PARAM_BLD_push_BN(bld, OSSL_PKEY_PARAM_FFC_Q, q) &&
+        1 == OSSL_PARAM_BLD_push_BN(bld, OSSL_PKEY_PARAM_FFC_G, g) &&
+        1 == OSSL_PARAM_BLD_push_BN(bld, OSSL_PKEY_PARAM_PUB_KEY, pub_key))
+    {
+        params = OSSL_PARAM_BLD_to_param(bld);
+    }
+
+    if (nullptr == params ||
+        1 != EVP_PKEY_fromdata_init(ctx) ||
+        1 != EVP_PKEY_fromdata(ctx, &key, EVP_PKEY_PUBLIC_KEY, params))
+    {
+        HDCP_ASSERTMESSAGE("Failed to build the DSA key");
+        key = nullptr;
+    }
+
+    OSSL_PARAM_free(params);
+    OSSL_PARAM_BLD_free(bld);
+    EVP_PKEY_CTX_free(ctx);
+    BN_free(p);
+    BN_free(q);
+    BN_free(g);
+    BN_free(pub_key);
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return key;
+}
+#else
+EVP_PKEY *SignatureEngine::CreateDsaKey(
+                const uint8_t   *pubKey,
+                const size_t    pubKeySize)
+{
+    HDCP_FUNCTION_ENTER;
+
+    DSA *dsa = DSA_new();
+    if (nullptr == dsa)
+    {
+        return nullptr;
     }
 
     // Do an endian conversion and convert type to BIGNUM for the values
-    BIGNUM *p, *q, *g, *pub_key, *r, *s;
+    BIGNUM *p, *q, *g, *pub_key;
 
     p = BN_bin2bn(g_dsaP, sizeof(g_dsaP), nullptr);
     q = BN_bin2bn(g_dsaQ, sizeof(g_dsaQ), nullptr);
@@ -240,63 +612,167 @@ int32_t SrmTable::VerifySignature(
     if(DSA_SUCCESS != DSA_set0_pqg(dsa, p, q, g)) 
     {
        DSA_free(dsa);
-       DSA_SIG_free(sig);
        BN_free(p);
        BN_free(q);
        BN_free(g);
-       return EINVAL;
+       return nullptr;
     }
 
-#ifdef SRM_ULT_BUILD
-    if (g_UseFacsimileKey)
+    pub_key = BN_bin2bn(pubKey, pubKeySize, nullptr);
+
+    if(DSA_SUCCESS != DSA_set0_key(dsa, pub_key, nullptr)) 
     {
-        pub_key = BN_bin2bn(g_facsimilePublicKey, sizeof(g_publicKey), nullptr);
+        DSA_free(dsa);
+        BN_free(pub_key);
+        return nullptr;
     }
-    else
+
+    // DSA_new sets DSA_FLAG_CACHE_MONT_P, so the Montgomery context of p is
+    // computed by the first verification and kept in the key after that
+    EVP_PKEY *key = EVP_PKEY_new();
+    if (nullptr == key)
     {
-        pub_key = BN_bin2bn(g_publicKey, sizeof(g_publicKey), nullptr);
+        DSA_free(dsa);
+        return nullptr;
     }
-#else
-    pub_key = BN_bin2bn(g_publicKey, sizeof(g_publicKey), nullptr);
-#endif
 
-    if(DSA_SUCCESS != DSA_set0_key(dsa, pub_key, nullptr)) 
+    if (DSA_SUCCESS != EVP_PKEY_assign_DSA(key, dsa))
     {
+        EVP_PKEY_free(key);
         DSA_free(dsa);
-        DSA_SIG_free(sig);
-        BN_free(pub_key);
-        return EINVAL;
+        return nullptr;
     }
 
-    r = BN_bin2bn(pR, DSA_SIG_LENGTH, nullptr);
-    s = BN_bin2bn(pS, DSA_SIG_LENGTH, nullptr);
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return key;
+}
+#endif
+
+EVP_PKEY *SignatureEngine::LoadRsaKey(const char *path)
+{
+    HDCP_FUNCTION_ENTER;
 
-    if(DSA_SUCCESS != DSA_SIG_set0(sig, r, s)) 
+    FILE *file = fopen(path, "r");
+    if (nullptr == file)
     {
-        DSA_free(dsa);
-        DSA_SIG_free(sig);
-        BN_free(r);
-        BN_free(s);
-        return EINVAL;
+        HDCP_WARNMESSAGE(
+                "No HDCP 2.x SRM key at %s. Err: %s",
+                path,
+                strerror(errno));
+        return nullptr;
     }
-    
-    uint8_t md[SHA_DIGEST_LENGTH];
-    uint32_t result = DSA_do_verify(
-                    SHA1(pMsg, msgLen, md),
-                    SHA_DIGEST_LENGTH,
-                    sig,
-                    dsa);
 
-    DSA_free(dsa);
-    DSA_SIG_free(sig);
+    EVP_PKEY *key = PEM_read_PUBKEY(file, nullptr, nullptr, nullptr);
+    fclose(file);
+    if (nullptr == key)
+    {
+        HDCP_ASSERTMESSAGE("Failed to read the HDCP 2.x SRM key");
+        return nullptr;
+    }
 
-    if (DSA_SUCCESS != result)
+    // Anything but the DCP LLC key size would never verify a valid SRM
+    if (EVP_PKEY_RSA != EVP_PKEY_id(key) || RSA_KEY_BITS != EVP_PKEY_bits(key))
     {
-        return EINVAL;
+        HDCP_ASSERTMESSAGE("HDCP 2.x SRM key is not a %d bits RSA key",
+                            RSA_KEY_BITS);
+        EVP_PKEY_free(key);
+        return nullptr;
     }
 
     HDCP_FUNCTION_EXIT(SUCCESS);
-    return SUCCESS;
+    return key;
+}
+
+uint64_t RevocationIndex::PackKsv(const uint8_t ksv[KSV_SIZE])
+{
+    // We've assumed KSV is 5 below
+    // Let the compiler confirm this in case KSV ever gets udpated
+    static_assert(
+            KSV_SIZE == 5,
+            "ERROR: KSV_SIZE doesn't match the explicit expectation"
+            "of 5 in the packing below!");
+
+    return (static_cast<uint64_t>(ksv[0]) << 32) |
+           (static_cast<uint64_t>(ksv[1]) << 24) |
+           (static_cast<uint64_t>(ksv[2]) << 16) |
+           (static_cast<uint64_t>(ksv[3]) << 8)  |
+           (static_cast<uint64_t>(ksv[4]) << 0);
+}
+
+void RevocationIndex::Insert(const uint64_t key)
+{
+    m_Keys.push_back(key);
+}
+
+void RevocationIndex::Finalize(void)
+{
+    std::sort(m_Keys.begin(), m_Keys.end());
+    m_Keys.erase(std::unique(m_Keys.begin(), m_Keys.end()), m_Keys.end());
+    m_Keys.shrink_to_fit();
+}
+
+bool RevocationIndex::Contains(const uint64_t key) const
+{
+    size_t count = m_Keys.size();
+    if (0 == count)
+    {
+        return false;
+    }
+
+    // Branchless lower bound, the select compiles to a conditional move
+    const uint64_t *base = m_Keys.data();
+    while (count > 1)
+    {
+        size_t half = count / 2;
+        base = (base[half] <= key) ? base + half : base;
+        count -= half;
+    }
+
+    return *base == key;
+}
+
+void RevocationIndex::ContainsBatch(
+                        const uint64_t *keys,
+                        const uint32_t count,
+                        std::vector<uint32_t>& revoked) const
+{
+    size_t size = m_Keys.size();
+    if (0 == size || 0 == count)
+    {
+        return;
+    }
+
+    // Every search shrinks the same range the same way, so they only
+    // differ by their position
+    std::vector<size_t> position(count, 0);
+    const uint64_t *base = m_Keys.data();
+    while (size > 1)
+    {
+        size_t half = size / 2;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            position[i] += (base[position[i] + half] <= keys[i]) ? half : 0;
+        }
+        size -= half;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (base[position[i]] == keys[i])
+        {
+            revoked.push_back(i);
+        }
+    }
+}
+
+size_t RevocationIndex::GetCount(void) const
+{
+    return m_Keys.size();
+}
+
+void RevocationIndex::Swap(RevocationIndex& other)
+{
+    m_Keys.swap(other.m_Keys);
 }
 
 VectorRevocationList::VectorRevocationList(
@@ -329,32 +805,7 @@ VectorRevocationList::VectorRevocationList(
     }
 
     m_NumberOfDevices = ksvCount;
-
-    m_KsvArray = new (std::nothrow) uint8_t[ksvArraySize];
-    if (m_KsvArray == nullptr)
-    {
-        HDCP_ASSERTMESSAGE("Failed to allocate an array for KSVs");
-        return;
-    }
-
-    memmove(m_KsvArray, &buf[1], ksvArraySize);
-
-    for (int32_t i = 0; i < m_NumberOfDevices; i++)
-    {
-        HDCP_VERBOSEMESSAGE(
-                    "Number of devices: %d, checking number of device %d",
-                    m_NumberOfDevices,
-                    i);
-
-        HDCP_VERBOSEMESSAGE(
-                    "RevokeList is %x, %x, %x, %x, %x",
-                    m_KsvArray[i * KSV_SIZE + 4],
-                    m_KsvArray[i * KSV_SIZE + 3],
-                    m_KsvArray[i * KSV_SIZE + 2],
-                    m_KsvArray[i * KSV_SIZE + 1],
-                    m_KsvArray[i * KSV_SIZE + 0]);
-    }
-    
+    m_KsvArray = &buf[1];
 
     m_IsValid = true;
 
@@ -362,508 +813,1370 @@ VectorRevocationList::VectorRevocationList(
     return;
 }
 
-VectorRevocationList::~VectorRevocationList(void)
+bool VectorRevocationList::IsValid(void)
 {
-    HDCP_FUNCTION_ENTER;
-
-    delete [] m_KsvArray;
-    m_KsvArray = nullptr;
-
-    HDCP_FUNCTION_EXIT(0);
+    return m_IsValid;
 }
 
-bool VectorRevocationList::IsValid(void)
+void VectorRevocationList::AddToIndex(RevocationIndex& index)
 {
-    return m_IsValid;
+    HDCP_FUNCTION_ENTER;
+
+    for (uint32_t i = 0; i < m_NumberOfDevices; i++)
+    {
+        // The bytes of the KSVs in the VRL are reversed
+        const uint8_t *entry = &m_KsvArray[i * KSV_SIZE];
+        const uint8_t ksv[KSV_SIZE] =
+        {
+            entry[4], entry[3], entry[2], entry[1], entry[0]
+        };
+
+        HDCP_VERBOSEMESSAGE(
+                    "RevokeList is %x, %x, %x, %x, %x",
+                    ksv[0],
+                    ksv[1],
+                    ksv[2],
+                    ksv[3],
+                    ksv[4]);
+
+        index.Insert(RevocationIndex::PackKsv(ksv));
+    }
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
 }
 
-bool VectorRevocationList::ContainsKsv(const uint8_t ksv[KSV_SIZE])
+ReceiverIdList::ReceiverIdList(
+                        const uint8_t *buf,
+                        const uint32_t length,
+                        const bool isFirstGeneration) :
+    m_IsValid(false),
+    m_NumberOfDevices(0),
+    m_ReceiverIds(nullptr)
 {
     HDCP_FUNCTION_ENTER;
 
-    // It is valid for us to have stored an empty list, so check that case first
-    if (0 == m_NumberOfDevices)
+    // The number of devices takes 10 bits, followed by 22 reserved bits in
+    // the first generation and preceded by 6 reserved bits in the next ones
+    uint32_t headerSize = isFirstGeneration ? 4 : 2;
+    if (length < headerSize)
     {
-        return false;
+        HDCP_ASSERTMESSAGE("Receiver ID list is too small to read!");
+        return;
     }
 
-    if (nullptr == m_KsvArray)
+    uint32_t count = 0;
+    if (isFirstGeneration)
     {
-        HDCP_ASSERTMESSAGE("Attempting to check a nullptr ksv array!");
-        // REVIEW: This is very inconsistent state... how should this fail?
-        // (Just let it return true so that the ksv will
-        //  look revoked and not enable HDCP for the device)
-        // This needs testing and code review
-        return true;
+        count = (buf[0] << 2) | (buf[1] >> 6);
+    }
+    else
+    {
+        count = ((buf[0] & 0x03) << 8) | buf[1];
     }
 
-    // We've assumed KSV is 5 in the check within the loop below
-    // Let the compiler confirm this in case KSV ever gets udpated
-    static_assert(
-            KSV_SIZE == 5,
-            "ERROR: KSV_SIZE doesn't match the explicit expectation"
-            "of 5 in the loop below!");
+    if (length != headerSize + count * KSV_SIZE)
+    {
+        HDCP_ASSERTMESSAGE(
+                "Length of receiver ID list does not match stated size");
+        return;
+    }
+
+    m_NumberOfDevices = count;
+    m_ReceiverIds = &buf[headerSize];
+
+    m_IsValid = true;
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return;
+}
+
+bool ReceiverIdList::IsValid(void)
+{
+    return m_IsValid;
+}
 
-    HDCP_VERBOSEMESSAGE("Start to check RevokeList with BKSV");
+void ReceiverIdList::AddToIndex(RevocationIndex& index)
+{
+    HDCP_FUNCTION_ENTER;
 
     for (uint32_t i = 0; i < m_NumberOfDevices; i++)
     {
-        HDCP_VERBOSEMESSAGE(
-                    "Number of devices: %d, checking number of device %d",
-                    m_NumberOfDevices,
-                    i);
+        // Receiver IDs are big-endian, as packed keys are
+        const uint8_t *receiverId = &m_ReceiverIds[i * KSV_SIZE];
 
         HDCP_VERBOSEMESSAGE(
-                    "RevokeList is %x, %x, %x, %x, %x",
-                    m_KsvArray[i * KSV_SIZE + 4],
-                    m_KsvArray[i * KSV_SIZE + 3],
-                    m_KsvArray[i * KSV_SIZE + 2],
-                    m_KsvArray[i * KSV_SIZE + 1],
-                    m_KsvArray[i * KSV_SIZE + 0]);
+                    "Revoked receiver ID is %x, %x, %x, %x, %x",
+                    receiverId[0],
+                    receiverId[1],
+                    receiverId[2],
+                    receiverId[3],
+                    receiverId[4]);
+
+        index.Insert(RevocationIndex::PackKsv(receiverId));
+    }
 
-        HDCP_VERBOSEMESSAGE(
-                    "BKSV to check is %x, %x, %x, %x, %x",
-                    ksv[0],
-                    ksv[1],
-                    ksv[2],
-                    ksv[3],
-                    ksv[4]);
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
+
+SrmSnapshot::SrmSnapshot(
+                const uint16_t version,
+                const uint8_t generation,
+                const uint8_t *digest,
+                RevocationIndex& index) :
+            m_Version(version),
+            m_Generation(generation)
+{
+    if (nullptr != digest)
+    {
+        memcpy(m_Digest, digest, SHA256_DIGEST_LENGTH);
+    }
+    else
+    {
+        memset(m_Digest, 0, SHA256_DIGEST_LENGTH);
+    }
+
+    m_RevocationIndex.Swap(index);
+}
+
+bool SrmSnapshot::IsSameSrm(const uint8_t digest[SHA256_DIGEST_LENGTH]) const
+{
+    return 0 == memcmp(m_Digest, digest, SHA256_DIGEST_LENGTH);
+}
+
+SrmTable::SrmTable(void) :
+            m_IsValid(false),
+            m_IsSrmStorageDisable(false),
+            m_IsPersistPending(),
+            m_IsPersistRunning(false),
+            m_IsPersistExit(false),
+            m_WatchFd(ERROR),
+            m_WatchStopFd(ERROR),
+            m_IsWatchRunning(false),
+            m_VerifyThreadCount(0),
+            m_VerifyJob(nullptr),
+            m_VerifyJobId(0),
+            m_VerifyBusyCount(0),
+            m_IsVerifyExit(false),
+            m_Engine()
+#ifdef SRM_ULT_BUILD
+            , m_FacsimileEngine(nullptr)
+#endif
+{
+    HDCP_FUNCTION_ENTER;
+
+    int32_t sts = pthread_mutex_init(&m_UpdateMutex, nullptr);
+    if (0 != sts)
+    {
+        return;
+    }
+
+    sts = pthread_mutex_init(&m_PersistMutex, nullptr);
+    if (0 != sts)
+    {
+        return;
+    }
+
+    sts = pthread_cond_init(&m_PersistCV, nullptr);
+    if (0 != sts)
+    {
+        return;
+    }
+
+    sts = pthread_mutex_init(&m_VerifyMutex, nullptr);
+    if (0 != sts)
+    {
+        return;
+    }
+
+    sts = pthread_cond_init(&m_VerifyCV, nullptr);
+    if (0 != sts)
+    {
+        return;
+    }
+
+    sts = pthread_cond_init(&m_VerifyDoneCV, nullptr);
+    if (0 != sts)
+    {
+        return;
+    }
+
+    // Start with an empty SRM of each format
+    RevocationIndex emptyIndex;
+    std::shared_ptr<const SrmSnapshot> snapshot(
+                new (std::nothrow) SrmSnapshot(0, 0, nullptr, emptyIndex));
+    if (nullptr == snapshot)
+    {
+        HDCP_ASSERTMESSAGE("Failed to allocate the initial SRM snapshot");
+        return;
+    }
+    for (uint32_t i = 0; i < SRM_FORMAT_COUNT; i++)
+    {
+        std::atomic_store(&m_Snapshot[i], snapshot);
+    }
+
+    m_Engine[SRM_FORMAT_HDCP1] = new (std::nothrow) SignatureEngine(
+                SignatureEngine::CreateDsaKey(g_publicKey, sizeof(g_publicKey)),
+                "SHA1");
+    if (nullptr == m_Engine[SRM_FORMAT_HDCP1] ||
+        !m_Engine[SRM_FORMAT_HDCP1]->IsValid())
+    {
+        HDCP_ASSERTMESSAGE("Failed to create the SRM verification key");
+        return;
+    }
+
+#ifdef SRM_ULT_BUILD
+    m_FacsimileEngine = new (std::nothrow) SignatureEngine(
+                SignatureEngine::CreateDsaKey(
+                                g_facsimilePublicKey,
+                                sizeof(g_facsimilePublicKey)),
+                "SHA1");
+    if (nullptr == m_FacsimileEngine || !m_FacsimileEngine->IsValid())
+    {
+        HDCP_ASSERTMESSAGE("Failed to create the facsimile verification key");
+        return;
+    }
+#endif
+
+    // Not fatal, HDCP 2.x SRMs are rejected until a key is provisioned
+    EVP_PKEY *srm2Key = SignatureEngine::LoadRsaKey(SRM2_PUBLIC_KEY_FILENAME);
+    if (nullptr != srm2Key)
+    {
+        m_Engine[SRM_FORMAT_HDCP2] = new (std::nothrow) SignatureEngine(
+                                                            srm2Key,
+                                                            "SHA256");
+        if (nullptr == m_Engine[SRM_FORMAT_HDCP2])
+        {
+            EVP_PKEY_free(srm2Key);
+        }
+    }
+
+    // Before the stored SRMs are verified, once for the life of the table
+    StartVerifyPool();
+
+    // Failing to find the SRM file is bad and this potentially should fail
+    // conservatively, but apparently it should just continue until an app
+    // actually sends srm data to use.
+    m_IsValid = true;
+
+    for (uint32_t i = 0; i < SRM_FORMAT_COUNT; i++)
+    {
+        LoadStoredSrm(static_cast<SrmFormat>(i));
+    }
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return;
+}
+
+SrmTable::~SrmTable(void)
+{
+    HDCP_FUNCTION_ENTER;
+
+    StopVerifyPool();
+
+    DESTROY_LOCK(&m_UpdateMutex);
+    DESTROY_LOCK(&m_PersistMutex);
+    DESTROY_CV(&m_PersistCV);
+    DESTROY_LOCK(&m_VerifyMutex);
+    DESTROY_CV(&m_VerifyCV);
+    DESTROY_CV(&m_VerifyDoneCV);
+
+    for (uint32_t i = 0; i < SRM_FORMAT_COUNT; i++)
+    {
+        delete m_Engine[i];
+    }
+#ifdef SRM_ULT_BUILD
+    delete m_FacsimileEngine;
+#endif
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return;
+}
+
+bool SrmTable::IsValid(void)
+{
+    return m_IsValid;
+}
+
+void SrmTable::SetSrmStorageDisable(const bool disableSrmStorage)
+{
+    m_IsSrmStorageDisable = disableSrmStorage;
+}
+
+bool SrmTable::IsSrmStorageDisable(void)
+{
+    return m_IsSrmStorageDisable;
+}
+
+int32_t SrmTable::GetSrmFormat(
+                        const uint8_t *buf,
+                        const size_t length,
+                        SrmFormat& format)
+{
+    CHECK_PARAM_NULL(buf, EINVAL);
+
+    if (length < SRM_HEADER_LENGTH)
+    {
+        HDCP_ASSERTMESSAGE("Buffer not large enough to contain a header!");
+        return EINVAL;
+    }
+
+    switch (buf[0] >> 4)
+    {
+        case SRM_HEADER_ID:
+            format = SRM_FORMAT_HDCP1;
+            break;
+        case SRM2_HEADER_ID:
+            format = SRM_FORMAT_HDCP2;
+            break;
+        default:
+            HDCP_ASSERTMESSAGE("Buffer does not have SRM header format!");
+            return EINVAL;
+    }
+
+    return SUCCESS;
+}
+
+int32_t SrmTable::FrameSrm(
+                        const uint8_t *buf,
+                        const size_t length,
+                        std::vector<SrmSignedBlock>& blocks)
+{
+    HDCP_FUNCTION_ENTER;
+
+    uint32_t    vrlLength       = 0;
+    const uint8_t     *vrlList         = nullptr;
+    const uint8_t     *signature       = nullptr;
+    uint32_t    offset          = SRM_HEADER_LENGTH;
+    uint32_t    gen1BufLength   = 0;
+
+    // Make sure the length is at least large enough for us to get header info
+    // and also the 3 bytes of VRL length
+    if (length < (SRM_HEADER_LENGTH + 3))
+    {
+        HDCP_ASSERTMESSAGE("Buffer not large enough to contain a header!");
+        return EINVAL;
+    }
+
+    // The first 3 bytes of the buffer contain length of the gen1 VRL
+    vrlLength = 0;
+    vrlLength |= buf[offset++] << 16;
+    vrlLength |= buf[offset++] << 8;
+    vrlLength |= buf[offset++] << 0;
+
+    gen1BufLength = SRM_HEADER_LENGTH + vrlLength;
+    if (gen1BufLength > length)
+    {
+        HDCP_ASSERTMESSAGE("Buffer is too short to contain SRM information!");
+        return EINVAL;
+    }
+
+    // According to HDCP spec, 5kb limit on 1st generation SRM Message
+    if (gen1BufLength > SRM_FIRST_GEN_MAX_SIZE)
+    {
+        HDCP_ASSERTMESSAGE(
+                    "First generation size %d is too large!",
+                    gen1BufLength);
+        return EINVAL;
+    }
+    // This gets used in VerifySignature for SHA calculation.
+    // It should not contain the S/R signatures
+    gen1BufLength -= (2 * DSA_SIG_LENGTH);
+
+    // vrlLength contains:
+    //      3 bytes required for the length itself
+    //      40 bytes of signature data (2 signatures) at the end of the buffer
+    //      variable number of bytes of actual VRL lists
+    if (vrlLength < (3 + (2 * DSA_SIG_LENGTH)))
+    {
+        HDCP_ASSERTMESSAGE("VRL length could not fit DSA sig and length bits!");
+        return EINVAL;
+    }
+    vrlLength -= 3;
+    vrlLength -= (2 * DSA_SIG_LENGTH);
+
+    // After that comes the variable length VRL lists
+    vrlList = &buf[offset];
+    offset += vrlLength; 
+
+    // And next comes the r & s values of the sigature
+    // (using DSA - Digital Signature Algorithm)
+    signature = &buf[offset];
+    offset += 2 * DSA_SIG_LENGTH;
+
+    // The signature of gen1 covers the header & data, for gen2+ it only
+    // covers the data
+    blocks.push_back(
+        {buf, gen1BufLength, vrlList, vrlLength, signature,
+         2 * DSA_SIG_LENGTH});
+
+    while (offset < length)
+    {
+        // Make sure enough msg left to read the next VRL length (2 bytes)
+        if (offset + 2 > length)
+        {
+            HDCP_ASSERTMESSAGE("VRL header is too small to read!");
+            return EINVAL;
+        }
+
+        // The first 2 bytes of the buffer contain length of the gen2+ VRL
+        vrlLength = 0;
+        vrlLength |= buf[offset++] << 8;
+        vrlLength |= buf[offset++] << 0;
+        if ((offset + vrlLength) > length)
+        {
+            HDCP_ASSERTMESSAGE(
+                "VRL length doesn't match the proclaimed length!");
+            return EINVAL;
+        }
+
+        // vrlLength contains:
+        //      2 bytes required for the length itself
+        //      40 bytes of signature data (2 signatures R/S)
+        //      variable number of bytes of actual VRL lists
+        if (vrlLength < (2 + (2 * DSA_SIG_LENGTH)))
+        {
+            HDCP_ASSERTMESSAGE(
+                "VRL length could not fit DSA sig and length bits!");
+            return EINVAL;
+        }
+        vrlLength -= 2;
+        vrlLength -= (2 * DSA_SIG_LENGTH);
+
+        // After that comes the variable length VRL lists
+        vrlList = &buf[offset];
+        offset += vrlLength;
+
+        // And next comes the r & s values of the sigature
+        // (using DSA - Digital Signature Algorithm)
+        signature = &buf[offset];
+        offset += 2 * DSA_SIG_LENGTH;
+
+        blocks.push_back(
+            {vrlList, vrlLength, vrlList, vrlLength, signature,
+             2 * DSA_SIG_LENGTH});
+    }
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return SUCCESS;
+}
+
+int32_t SrmTable::FrameSrm2(
+                        const uint8_t *buf,
+                        const size_t length,
+                        std::vector<SrmSignedBlock>& blocks)
+{
+    HDCP_FUNCTION_ENTER;
+
+    uint32_t    offset      = SRM_HEADER_LENGTH;
+    uint32_t    genLength   = 0;
+
+    if (length < (SRM_HEADER_LENGTH + 3))
+    {
+        HDCP_ASSERTMESSAGE("Buffer not large enough to contain a header!");
+        return EINVAL;
+    }
+
+    // genLength of the first generation contains:
+    //      3 bytes required for the length itself
+    //      4 bytes for the number of devices
+    //      variable number of bytes of receiver IDs
+    //      384 bytes of DCP LLC signature
+    genLength |= buf[offset] << 16;
+    genLength |= buf[offset + 1] << 8;
+    genLength |= buf[offset + 2] << 0;
+    if (genLength < (3 + 4 + RSA_SIG_LENGTH) ||
+        (SRM_HEADER_LENGTH + genLength) > length)
+    {
+        HDCP_ASSERTMESSAGE("Buffer is too short to contain SRM information!");
+        return EINVAL;
+    }
+
+    if ((SRM_HEADER_LENGTH + genLength) > SRM2_FIRST_GEN_MAX_SIZE)
+    {
+        HDCP_ASSERTMESSAGE(
+                    "First generation size %d is too large!",
+                    SRM_HEADER_LENGTH + genLength);
+        return EINVAL;
+    }
+
+    // The signature of the first generation covers the header & data
+    blocks.push_back(
+        {buf,
+         SRM_HEADER_LENGTH + genLength - RSA_SIG_LENGTH,
+         &buf[offset + 3],
+         genLength - 3 - RSA_SIG_LENGTH,
+         &buf[SRM_HEADER_LENGTH + genLength - RSA_SIG_LENGTH],
+         RSA_SIG_LENGTH});
+    offset += genLength;
+
+    while (offset < length)
+    {
+        // Make sure enough msg left to read the next length (2 bytes)
+        if (offset + 2 > length)
+        {
+            HDCP_ASSERTMESSAGE("Next generation header is too small to read!");
+            return EINVAL;
+        }
+
+        // genLength of the next generations contains:
+        //      2 bytes required for the length itself
+        //      2 bytes for the number of devices
+        //      variable number of bytes of receiver IDs
+        //      384 bytes of DCP LLC signature
+        genLength = (buf[offset] << 8) | buf[offset + 1];
+        if (genLength < (2 + 2 + RSA_SIG_LENGTH) ||
+            (offset + genLength) > length)
+        {
+            HDCP_ASSERTMESSAGE(
+                "Next generation length doesn't match the SRM length!");
+            return EINVAL;
+        }
+
+        // The signature covers every field of the generation before it
+        blocks.push_back(
+            {&buf[offset],
+             genLength - RSA_SIG_LENGTH,
+             &buf[offset + 2],
+             genLength - 2 - RSA_SIG_LENGTH,
+             &buf[offset + genLength - RSA_SIG_LENGTH],
+             RSA_SIG_LENGTH});
+        offset += genLength;
+    }
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return SUCCESS;
+}
+
+int32_t SrmTable::RetrieveSrmFromBuffer(const uint8_t *buf, const size_t length)
+{
+    HDCP_FUNCTION_ENTER;
+
+    SrmFormat   format          = SRM_FORMAT_HDCP1;
+    SrmHeader   srmHeader       = {};
+
+    // KSVs or receiver IDs of all generations get collected here before
+    // being committed
+    RevocationIndex             revocationIndex;
+
+    int32_t ret = GetSrmFormat(buf, length, format);
+    if (SUCCESS != ret)
+    {
+        return ret;
+    }
+
+    // Apps commonly push the same SRM on every session, which then costs
+    // a single hash
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+    Sha256(buf, length, digest);
+    if (GetSnapshot(format)->IsSameSrm(digest))
+    {
+        HDCP_NORMALMESSAGE("The SRM is already in use");
+        return EALREADY;
+    }
+
+    // Both formats start with the same header
+    srmHeader.srm_id        =  buf[0] >> 4;
+    srmHeader.version       =  buf[3];
+    srmHeader.version       |= buf[2] << 8;
+    srmHeader.generation    =  buf[4];
+
+    if (srmHeader.version < GetSnapshot(format)->GetVersion())
+    {
+        // Our SRM info is more up-to-date than the sender's
+        HDCP_ASSERTMESSAGE("The SRM version isn't newer than current!");
+        return EAGAIN;
+    }
+
+    std::vector<SrmSignedBlock> blocks;
+    if (SRM_FORMAT_HDCP2 == format)
+    {
+        ret = FrameSrm2(buf, length, blocks);
+    }
+    else
+    {
+        ret = FrameSrm(buf, length, blocks);
+    }
+    if (SUCCESS != ret)
+    {
+        return ret;
+    }
+
+    if (blocks.size() != srmHeader.generation)
+    {
+        HDCP_ASSERTMESSAGE(
+                "SRM holds %d generations, its header says %d!",
+                static_cast<uint32_t>(blocks.size()),
+                srmHeader.generation);
+        return EINVAL;
+    }
+
+    // Reject malformed lists before paying for any signature
+    for (auto it = blocks.begin(); it != blocks.end(); ++it)
+    {
+        bool isValid = false;
+        if (SRM_FORMAT_HDCP2 == format)
+        {
+            ReceiverIdList list(it->vrl, it->vrlLength, it == blocks.begin());
+            isValid = list.IsValid();
+        }
+        else
+        {
+            VectorRevocationList vrl(it->vrl, it->vrlLength);
+            isValid = vrl.IsValid();
+        }
+
+        if (!isValid)
+        {
+            HDCP_ASSERTMESSAGE("Creation of new revocation list failed!");
+            return EINVAL;
+        }
+    }
+
+    ret = VerifySignatures(format, blocks);
+    if (SUCCESS != ret)
+    {
+        HDCP_ASSERTMESSAGE("Could not verify the signatures of the SRM!");
+        return ret;
+    }
+
+    // At this point we need to start building the new revocation index
+    for (auto it = blocks.begin(); it != blocks.end(); ++it)
+    {
+        if (SRM_FORMAT_HDCP2 == format)
+        {
+            ReceiverIdList list(it->vrl, it->vrlLength, it == blocks.begin());
+            list.AddToIndex(revocationIndex);
+        }
+        else
+        {
+            VectorRevocationList vrl(it->vrl, it->vrlLength);
+            vrl.AddToIndex(revocationIndex);
+        }
+    }
+
+    // If we hit this, the new Srm Table was built successfully
+    // Sort it for lookups and replace the old one
+    revocationIndex.Finalize();
+
+    HDCP_NORMALMESSAGE(
+                "SRM (id %x) version %d revokes %d devices",
+                srmHeader.srm_id,
+                srmHeader.version,
+                static_cast<uint32_t>(revocationIndex.GetCount()));
+
+    std::shared_ptr<const SrmSnapshot> snapshot(
+                new (std::nothrow) SrmSnapshot(
+                                    srmHeader.version,
+                                    srmHeader.generation,
+                                    digest,
+                                    revocationIndex));
+    if (nullptr == snapshot)
+    {
+        HDCP_ASSERTMESSAGE("Failed to allocate a new SRM snapshot!");
+        return ENOMEM;
+    }
+
+    // Another SRM may have been committed while this one was verified
+    ACQUIRE_LOCK(&m_UpdateMutex);
+    if (srmHeader.version < GetSnapshot(format)->GetVersion())
+    {
+        RELEASE_LOCK(&m_UpdateMutex);
+        HDCP_ASSERTMESSAGE("The SRM version isn't newer than current!");
+        return EAGAIN;
+    }
+    std::atomic_store(&m_Snapshot[format], snapshot);
+    RELEASE_LOCK(&m_UpdateMutex);
+
+    // Readers still holding the previous snapshot release it when done
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return SUCCESS;
+}
+
+void SrmTable::VerifyBlocks(SrmVerifyJob *job, EVP_MD_CTX *ctx)
+{
+    HDCP_FUNCTION_ENTER;
+
+    while (true)
+    {
+        ACQUIRE_LOCK(&job->mutex);
+        uint32_t i = job->next++;
+        bool isDone = (SUCCESS != job->result) || (i >= job->blocks->size());
+        RELEASE_LOCK(&job->mutex);
+
+        if (isDone)
+        {
+            break;
+        }
+
+        const SrmSignedBlock& block = (*job->blocks)[i];
+        int32_t ret = job->engine->Verify(
+                                ctx,
+                                block.msg,
+                                block.msgLen,
+                                block.signature,
+                                block.signatureLength);
+        if (SUCCESS != ret)
+        {
+            HDCP_ASSERTMESSAGE("Failed to verify the signature of gen%d!",
+                                i + 1);
+
+            ACQUIRE_LOCK(&job->mutex);
+            if (SUCCESS == job->result)
+            {
+                job->result = ret;
+            }
+            RELEASE_LOCK(&job->mutex);
+            break;
+        }
+    }
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
+
+void *SrmTable::VerifyWorker(void *arg)
+{
+    HDCP_FUNCTION_ENTER;
+
+    SrmTable *table = static_cast<SrmTable *>(arg);
+
+    // One digest context per helper, reused for every block it takes
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    if (nullptr == ctx)
+    {
+        HDCP_ASSERTMESSAGE("Failed to allocate a digest context");
+        return nullptr;
+    }
+
+    uint32_t jobId = 0;
+
+    ACQUIRE_LOCK(&table->m_VerifyMutex);
+    while (true)
+    {
+        while (!table->m_IsVerifyExit &&
+            ((nullptr == table->m_VerifyJob) ||
+            (jobId == table->m_VerifyJobId)))
+        {
+            WAIT_CV(&table->m_VerifyCV, &table->m_VerifyMutex);
+        }
+
+        if (table->m_IsVerifyExit)
+        {
+            break;
+        }
+
+        SrmVerifyJob *job = table->m_VerifyJob;
+        jobId = table->m_VerifyJobId;
+        ++table->m_VerifyBusyCount;
+        RELEASE_LOCK(&table->m_VerifyMutex);
+
+        VerifyBlocks(job, ctx);
+
+        ACQUIRE_LOCK(&table->m_VerifyMutex);
+        --table->m_VerifyBusyCount;
+        pthread_cond_broadcast(&table->m_VerifyDoneCV);
+    }
+    RELEASE_LOCK(&table->m_VerifyMutex);
+
+    EVP_MD_CTX_free(ctx);
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return nullptr;
+}
+
+void SrmTable::StartVerifyPool(void)
+{
+    HDCP_FUNCTION_ENTER;
+
+    for (uint32_t i = 0; i < SRM_VERIFY_HELPERS_MAX; i++)
+    {
+        int32_t ret = pthread_create(
+                            &m_VerifyThreads[m_VerifyThreadCount],
+                            nullptr,
+                            VerifyWorker,
+                            this);
+        if (0 != ret)
+        {
+            HDCP_WARNMESSAGE(
+                    "Failed to create SRM verification thread. Err: %s",
+                    strerror(ret));
+            break;
+        }
+        m_VerifyThreadCount++;
+    }
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
+
+void SrmTable::StopVerifyPool(void)
+{
+    HDCP_FUNCTION_ENTER;
+
+    if (0 == m_VerifyThreadCount)
+    {
+        return;
+    }
+
+    ACQUIRE_LOCK(&m_VerifyMutex);
+    m_IsVerifyExit = true;
+    pthread_cond_broadcast(&m_VerifyCV);
+    RELEASE_LOCK(&m_VerifyMutex);
+
+    for (uint32_t i = 0; i < m_VerifyThreadCount; i++)
+    {
+        pthread_join(m_VerifyThreads[i], nullptr);
+    }
+    m_VerifyThreadCount = 0;
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
+
+SignatureEngine *SrmTable::GetEngine(const SrmFormat format)
+{
+#ifdef SRM_ULT_BUILD
+    if (SRM_FORMAT_HDCP1 == format && g_UseFacsimileKey)
+    {
+        return m_FacsimileEngine;
+    }
+#endif
+    return m_Engine[format];
+}
+
+int32_t SrmTable::VerifySignatures(
+                        const SrmFormat format,
+                        const std::vector<SrmSignedBlock>& blocks)
+{
+    HDCP_FUNCTION_ENTER;
+
+    SrmVerifyJob job;
+    job.engine  = GetEngine(format);
+    job.blocks  = &blocks;
+    job.next    = 0;
+    job.result  = SUCCESS;
+
+    // Without the key no SRM of that format is accepted
+    CHECK_PARAM_NULL(job.engine, ENODEV);
+
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    if (nullptr == ctx)
+    {
+        HDCP_ASSERTMESSAGE("Failed to allocate a digest context");
+        return ENOMEM;
+    }
+
+    int32_t ret = pthread_mutex_init(&job.mutex, nullptr);
+    if (0 != ret)
+    {
+        EVP_MD_CTX_free(ctx);
+        return ret;
+    }
+
+    // Nothing to share out of a single generation
+    bool isShared = (blocks.size() > 1) && (m_VerifyThreadCount > 0);
+    if (isShared)
+    {
+        ACQUIRE_LOCK(&m_VerifyMutex);
+        while (nullptr != m_VerifyJob)
+        {
+            WAIT_CV(&m_VerifyDoneCV, &m_VerifyMutex);
+        }
+        m_VerifyJob = &job;
+        m_VerifyJobId++;
+        pthread_cond_broadcast(&m_VerifyCV);
+        RELEASE_LOCK(&m_VerifyMutex);
+    }
+
+    VerifyBlocks(&job, ctx);
+
+    if (isShared)
+    {
+        // Helpers still joining find no block left, so this doesn't wait
+        // long. The job stays posted until the last one left it.
+        ACQUIRE_LOCK(&m_VerifyMutex);
+        while (m_VerifyBusyCount > 0)
+        {
+            WAIT_CV(&m_VerifyDoneCV, &m_VerifyMutex);
+        }
+        m_VerifyJob = nullptr;
+        pthread_cond_broadcast(&m_VerifyDoneCV);
+        RELEASE_LOCK(&m_VerifyMutex);
+    }
+
+    EVP_MD_CTX_free(ctx);
+
+    ret = job.result;
+    DESTROY_LOCK(&job.mutex);
+
+    HDCP_FUNCTION_EXIT(ret);
+    return ret;
+}
+
+int32_t SrmTable::CheckSrmRevoke(
+                        const SrmFormat format,
+                        const uint8_t ksv[KSV_SIZE])
+{
+    HDCP_FUNCTION_ENTER;
+
+    CHECK_PARAM_NULL(ksv, EINVAL);
+
+    uint64_t key = RevocationIndex::PackKsv(ksv);
+
+    if (GetSnapshot(format)->GetIndex().Contains(key))
+    {
+        // Our KSV is on the revocation list!
+        return EACCES;
+    }
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return SUCCESS;
+}
+
+int32_t SrmTable::CheckSrmRevokeList(
+                        const SrmFormat format,
+                        const uint8_t *ksvList,
+                        const uint32_t ksvCount,
+                        std::vector<uint32_t>& revoked)
+{
+    HDCP_FUNCTION_ENTER;
+
+    CHECK_PARAM_NULL(ksvList, EINVAL);
+
+    revoked.clear();
+
+    std::vector<uint64_t> keys(ksvCount);
+    for (uint32_t i = 0; i < ksvCount; i++)
+    {
+        keys[i] = RevocationIndex::PackKsv(&ksvList[i * KSV_SIZE]);
+    }
+
+    GetSnapshot(format)->GetIndex().ContainsBatch(
+                                        keys.data(),
+                                        ksvCount,
+                                        revoked);
+
+    if (!revoked.empty())
+    {
+        // Part of the topology is on the revocation list!
+        return EACCES;
+    }
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return SUCCESS;
+}
+
+int32_t SrmTable::LoadStoredSrm(const SrmFormat format)
+{
+    HDCP_FUNCTION_ENTER;
+
+    std::vector<uint8_t> srm;
+    int32_t ret = ReadFile(g_SrmFiles[format].storage, srm);
+    if (SUCCESS != ret)
+    {
+        HDCP_ASSERTMESSAGE(
+                    "Could not read the SRM file %s. Err: %s",
+                    g_SrmFiles[format].storage,
+                    strerror(ret));
+        return ret;
+    }
+
+    if (srm.empty())
+    {
+        // There is nothing in the file.
+        // Our work here is done!
+        return SUCCESS;
+    }
+
+    SrmFormat storedFormat = SRM_FORMAT_HDCP1;
+    ret = GetSrmFormat(srm.data(), srm.size(), storedFormat);
+    if (SUCCESS != ret || format != storedFormat)
+    {
+        HDCP_ASSERTMESSAGE(
+                    "SRM file %s holds another format",
+                    g_SrmFiles[format].storage);
+        return EINVAL;
+    }
+
+    ret = RetrieveSrmFromBuffer(srm.data(), srm.size());
+    if (SUCCESS != ret)
+    {
+        HDCP_ASSERTMESSAGE(
+                "Failed to retrieve SRM list from non-volatile storage!");
+        return ret;
+    }
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return SUCCESS;
+}
+
+int32_t SrmTable::StartPersistence(void)
+{
+    HDCP_FUNCTION_ENTER;
+
+    int32_t ret = pthread_create(
+                        &m_PersistThread,
+                        nullptr,
+                        PersistWorker,
+                        this);
+    if (0 != ret)
+    {
+        HDCP_ASSERTMESSAGE(
+                "Failed to create SRM storage thread. Err: %s",
+                strerror(ret));
+        return ret;
+    }
+
+    m_IsPersistRunning = true;
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return SUCCESS;
+}
+
+void SrmTable::StopPersistence(void)
+{
+    HDCP_FUNCTION_ENTER;
+
+    if (!m_IsPersistRunning)
+    {
+        return;
+    }
+
+    ACQUIRE_LOCK(&m_PersistMutex);
+    m_IsPersistExit = true;
+    pthread_cond_signal(&m_PersistCV);
+    RELEASE_LOCK(&m_PersistMutex);
+
+    pthread_join(m_PersistThread, nullptr);
+    m_IsPersistRunning = false;
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
+
+int32_t SrmTable::QueuePersist(
+                        const SrmFormat format,
+                        const uint8_t *data,
+                        const uint32_t size)
+{
+    HDCP_FUNCTION_ENTER;
+
+    CHECK_PARAM_NULL(data, EINVAL);
+
+    if (!m_IsPersistRunning)
+    {
+        return ENODEV;
+    }
+
+    ACQUIRE_LOCK(&m_PersistMutex);
+    m_PendingSrm[format].assign(data, data + size);
+    m_IsPersistPending[format] = true;
+    pthread_cond_signal(&m_PersistCV);
+    RELEASE_LOCK(&m_PersistMutex);
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return SUCCESS;
+}
+
+void *SrmTable::PersistWorker(void *arg)
+{
+    HDCP_FUNCTION_ENTER;
+
+    SrmTable *table = static_cast<SrmTable *>(arg);
+    std::vector<uint8_t> srm;
+
+    while (true)
+    {
+        uint32_t format = SRM_FORMAT_COUNT;
+
+        ACQUIRE_LOCK(&table->m_PersistMutex);
+        while (true)
+        {
+            for (format = 0; format < SRM_FORMAT_COUNT; format++)
+            {
+                if (table->m_IsPersistPending[format])
+                {
+                    break;
+                }
+            }
+
+            if (SRM_FORMAT_COUNT != format || table->m_IsPersistExit)
+            {
+                break;
+            }
+            pthread_cond_wait(&table->m_PersistCV, &table->m_PersistMutex);
+        }
 
-        // Check against all 5 bytes of the input KSV (bytewise)
-        // (The bits are reversed)
-        if ((m_KsvArray[i * KSV_SIZE + 4] == ksv[0]) &&
-            (m_KsvArray[i * KSV_SIZE + 3] == ksv[1]) &&
-            (m_KsvArray[i * KSV_SIZE + 2] == ksv[2]) &&
-            (m_KsvArray[i * KSV_SIZE + 1] == ksv[3]) &&
-            (m_KsvArray[i * KSV_SIZE + 0] == ksv[4]))
+        if (SRM_FORMAT_COUNT == format)
         {
+            // Exit requested and nothing left to store
+            RELEASE_LOCK(&table->m_PersistMutex);
             break;
         }
+
+        srm.swap(table->m_PendingSrm[format]);
+        table->m_IsPersistPending[format] = false;
+        RELEASE_LOCK(&table->m_PersistMutex);
+
+        table->Persist(static_cast<SrmFormat>(format), srm);
     }
 
     HDCP_FUNCTION_EXIT(SUCCESS);
-    return SUCCESS;
+    return nullptr;
 }
 
-SrmTable::SrmTable(void) :
-            m_IsValid(false),
-            m_Version(0),
-            m_Generation(0),
-            m_IsSrmStorageDisable(false),
-            m_RevocationListsByGeneration(nullptr)
+void SrmTable::Persist(
+                    const SrmFormat format,
+                    const std::vector<uint8_t>& srm)
 {
     HDCP_FUNCTION_ENTER;
 
-    int32_t sts = pthread_mutex_init(&m_RevocationListMutex, nullptr);
-    if (0 != sts)
+    // Nothing goes to non-volatile storage, the firmware file included
+    if (IsSrmStorageDisable())
     {
+        HDCP_NORMALMESSAGE("SRM storage is disabled");
         return;
     }
 
-    m_RevocationListsByGeneration =
-                    new (std::nothrow) std::list<VectorRevocationList*>;
-    if (nullptr == m_RevocationListsByGeneration)
+    if (IsFileContent(g_SrmFiles[format].storage, srm.data(), srm.size()))
     {
-        HDCP_ASSERTMESSAGE("Failed to allocate a new list of VRLs");
-        return;
+        HDCP_NORMALMESSAGE("SRM storage file is up to date");
     }
-
-    // Failing to find the SRM file is bad and this potentially should fail
-    // conservatively, but apparently it should just continue until an app
-    // actually sends srm data to use.
-    m_IsValid = true;
-
-    int32_t fd = open(SRM_STORAGE_FILENAME, O_RDONLY);
-    if (ERROR == fd)
+    else if (SUCCESS != WriteFileAtomic(
+                                g_SrmFiles[format].storage,
+                                srm.data(),
+                                srm.size()))
     {
+        // Store our copy of the SRM to non-volatile storage
         HDCP_ASSERTMESSAGE(
-                    "Could not open the SRM file. Err: %s",
-                    strerror(errno));
-        return;
+                "Could not save SRM to non-volatile storage %s!",
+                g_SrmFiles[format].storage);
     }
 
-    struct stat sb  = {};
-    if (ERROR == fstat(fd, &sb))
+    // KMD reads the SRM from the firmware file for its own revocation check,
+    // it gets the SRM stored last whatever its format
+    if (IsFileContent(DISPLAY_SRM_STORAGE_FILE, srm.data(), srm.size()))
     {
-        HDCP_ASSERTMESSAGE(
-                    "Could not get stats for the SRM file. Err: %s",
-                    strerror(errno));
-        close(fd);
-        return;
+        HDCP_NORMALMESSAGE("Firmware SRM file is up to date");
     }
-
-    if (!S_ISREG(sb.st_mode))
+    else if (SUCCESS != WriteFileAtomic(
+                                DISPLAY_SRM_STORAGE_FILE,
+                                srm.data(),
+                                srm.size()))
     {
-        HDCP_ASSERTMESSAGE("SRM file is not a regular file");
-        close(fd);
-        return;
+        HDCP_ASSERTMESSAGE("Failed to write SRM to the firmware file!");
     }
 
-    if (0 == sb.st_size)
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
+
+int32_t SrmTable::StartWatch(void)
+{
+    HDCP_FUNCTION_ENTER;
+
+    m_WatchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (ERROR == m_WatchFd)
     {
-        // There is nothing in the file.
-        // Our work here is done!
-        close(fd);
-        return;
+        HDCP_ASSERTMESSAGE("inotify_init1 failed. Err: %s", strerror(errno));
+        return errno;
     }
 
-    void *buf = mmap(0, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
-    if (MAP_FAILED == buf)
+    // Watch the directory rather than the file, writers replace the file by
+    // renaming a new one over it
+    if (ERROR == inotify_add_watch(
+                            m_WatchFd,
+                            SRM_STORAGE_DIR,
+                            IN_CLOSE_WRITE | IN_MOVED_TO))
     {
+        int32_t ret = errno;
         HDCP_ASSERTMESSAGE(
-                "Failed to map a buffer for the SRM file. Err: %s",
-                strerror(errno));
-        close(fd);
-        return;
+                "Failed to watch %s. Err: %s",
+                SRM_STORAGE_DIR,
+                strerror(ret));
+        close(m_WatchFd);
+        m_WatchFd = ERROR;
+        return ret;
+    }
+
+    m_WatchStopFd = eventfd(0, EFD_CLOEXEC);
+    if (ERROR == m_WatchStopFd)
+    {
+        int32_t ret = errno;
+        close(m_WatchFd);
+        m_WatchFd = ERROR;
+        return ret;
     }
 
-    sts = RetrieveSrmFromBuffer(static_cast<uint8_t*>(buf), sb.st_size);
-    munmap(buf, sb.st_size);
-    if (SUCCESS != sts)
+    int32_t ret = pthread_create(&m_WatchThread, nullptr, WatchWorker, this);
+    if (0 != ret)
     {
         HDCP_ASSERTMESSAGE(
-                "Failed to retrieve SRM list from non-volatile storage!");
-        close(fd);
-        return;
+                "Failed to create SRM watch thread. Err: %s",
+                strerror(ret));
+        close(m_WatchStopFd);
+        close(m_WatchFd);
+        m_WatchStopFd = ERROR;
+        m_WatchFd = ERROR;
+        return ret;
     }
 
-    close(fd);
+    m_IsWatchRunning = true;
 
     HDCP_FUNCTION_EXIT(SUCCESS);
-    return;
+    return SUCCESS;
 }
 
-SrmTable::~SrmTable(void)
+void SrmTable::StopWatch(void)
 {
     HDCP_FUNCTION_ENTER;
 
-    VectorRevocationList *vrl = nullptr;
-
-    if (nullptr == m_RevocationListsByGeneration)
+    if (!m_IsWatchRunning)
     {
-        // Doesn't exist... this would be weird... but harmless
         return;
     }
 
-    ACQUIRE_LOCK(&m_RevocationListMutex);
-    while (!m_RevocationListsByGeneration->empty())
+    uint64_t value = 1;
+    if (sizeof(value) != write(m_WatchStopFd, &value, sizeof(value)))
     {
-        vrl = m_RevocationListsByGeneration->back();
-        delete vrl;
-        m_RevocationListsByGeneration->pop_back();
+        HDCP_WARNMESSAGE("Failed to signal the SRM watch thread");
     }
 
-    delete m_RevocationListsByGeneration;
-    RELEASE_LOCK(&m_RevocationListMutex);
+    pthread_join(m_WatchThread, nullptr);
+    m_IsWatchRunning = false;
 
-    DESTROY_LOCK(&m_RevocationListMutex);
+    close(m_WatchStopFd);
+    close(m_WatchFd);
+    m_WatchStopFd = ERROR;
+    m_WatchFd = ERROR;
 
     HDCP_FUNCTION_EXIT(SUCCESS);
-    return;
-}
-
-bool SrmTable::IsValid(void)
-{
-    return m_IsValid;
-}
-
-void SrmTable::SetSrmStorageDisable(const bool disableSrmStorage)
-{
-    m_IsSrmStorageDisable = disableSrmStorage;
-}
-
-bool SrmTable::IsSrmStorageDisable(void)
-{
-    return m_IsSrmStorageDisable;
 }
 
-int32_t SrmTable::RetrieveSrmFromBuffer(const uint8_t *buf, const size_t length)
+void *SrmTable::WatchWorker(void *arg)
 {
     HDCP_FUNCTION_ENTER;
 
-    int32_t     ret             = EINVAL;
-
-    SrmHeader   srmHeader       = {};
-    uint32_t    vrlLength       = 0;
-    const uint8_t     *vrlList         = nullptr;
-    const uint8_t     *signatureR      = nullptr;
-    const uint8_t     *signatureS      = nullptr;
-
-    uint32_t    offset          = 0;
-    uint32_t    gen1BufLength   = 0;
+    SrmTable *table = static_cast<SrmTable *>(arg);
 
-    VectorRevocationList                *vrl                = nullptr;
-    std::list<VectorRevocationList*>    *revocationLists    = nullptr;
+    struct pollfd fds[2] = {};
+    fds[0].fd       = table->m_WatchFd;
+    fds[0].events   = POLLIN;
+    fds[1].fd       = table->m_WatchStopFd;
+    fds[1].events   = POLLIN;
 
-    CHECK_PARAM_NULL(buf, EINVAL);
+    // Room for at least one event with the longest name
+    alignas(struct inotify_event)
+    char buf[sizeof(struct inotify_event) + NAME_MAX + 1];
 
-    // Make sure the length is at least large enough for us to get header info
-    // and also the 3 bytes of VRL length
-    if (length < (SRM_HEADER_LENGTH + 3))
+    while (true)
     {
-        HDCP_ASSERTMESSAGE("Buffer not large enough to contain a header!");
-        ret = EINVAL;
-    }
-
-    // Grab the header from the new message
-    srmHeader.srm_id        =  buf[offset + 0] >> 4;
-    srmHeader.version       =  buf[offset + 3];
-    srmHeader.version       |= buf[offset + 2] << 8;
-    srmHeader.generation    =  buf[offset + 4];
-    offset += SRM_HEADER_LENGTH;
+        if (ERROR == poll(fds, 2, -1))
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            HDCP_ASSERTMESSAGE("poll failed. Err: %s", strerror(errno));
+            break;
+        }
 
-    if (srmHeader.srm_id != SRM_HEADER_ID)
-    {
-        HDCP_ASSERTMESSAGE("Buffer does not have SRM header format!");
-        return EINVAL;
-    }
-    if (srmHeader.version < m_Version)
-    {
-        // Our SRM info is more up-to-date than the sender's
-        HDCP_ASSERTMESSAGE("The SRM version isn't newer than current!");
-        return EAGAIN;
-    }
+        if (fds[1].revents & POLLIN)
+        {
+            break;
+        }
 
-    // The first 3 bytes of the buffer contain length of the gen1 VRL
-    vrlLength = 0;
-    vrlLength |= buf[offset++] << 16;
-    vrlLength |= buf[offset++] << 8;
-    vrlLength |= buf[offset++] << 0;
+        // Several events may refer to a file, reload it once
+        bool isChanged[SRM_FORMAT_COUNT] = {};
+        ssize_t length = 0;
+        while ((length = read(table->m_WatchFd, buf, sizeof(buf))) > 0)
+        {
+            for (char *p = buf; p < buf + length; )
+            {
+                struct inotify_event *event =
+                                reinterpret_cast<struct inotify_event *>(p);
+                for (uint32_t i = 0; i < SRM_FORMAT_COUNT; i++)
+                {
+                    if (event->len > 0 &&
+                        0 == strcmp(
+                                event->name,
+                                g_SrmFiles[i].storageBasename))
+                    {
+                        isChanged[i] = true;
+                    }
+                }
+                p += sizeof(struct inotify_event) + event->len;
+            }
+        }
 
-    gen1BufLength = SRM_HEADER_LENGTH + vrlLength;
-    if (gen1BufLength > length)
-    {
-        HDCP_ASSERTMESSAGE("Buffer is too short to contain SRM information!");
-        return EINVAL;
+        for (uint32_t i = 0; i < SRM_FORMAT_COUNT; i++)
+        {
+            if (isChanged[i])
+            {
+                table->ReloadStoredSrm(static_cast<SrmFormat>(i));
+            }
+        }
     }
-    // This gets used in VerifySignature for SHA calculation.
-    // It should not contain the S/R signatures
-    gen1BufLength -= (2 * DSA_SIG_LENGTH);
 
-    // vrlLength contains:
-    //      3 bytes required for the length itself
-    //      40 bytes of signature data (2 signatures) at the end of the buffer
-    //      variable number of bytes of actual VRL lists
-    if (vrlLength < (3 + (2 * DSA_SIG_LENGTH)))
-    {
-        HDCP_ASSERTMESSAGE("VRL length could not fit DSA sig and length bits!");
-        return EINVAL;
-    }
-    vrlLength -= 3;
-    vrlLength -= (2 * DSA_SIG_LENGTH);
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return nullptr;
+}
 
-    // After that comes the variable length VRL lists
-    vrlList = &buf[offset];
-    offset += vrlLength; 
+int32_t SrmTable::ReloadStoredSrm(const SrmFormat format)
+{
+    HDCP_FUNCTION_ENTER;
 
-    // And next comes the r & s values of the sigature
-    // (using DSA - Digital Signature Algorithm)
-    signatureR = &buf[offset];
-    offset += DSA_SIG_LENGTH;
-    signatureS = &buf[offset];
-    offset += DSA_SIG_LENGTH;
-
-    // Now validate the signature of the header & data
-    // (only for gen1 vrl, for gen2+ only validate the data)
-    ret = VerifySignature(buf, gen1BufLength, signatureR, signatureS); 
+    std::vector<uint8_t> srm;
+    int32_t ret = ReadFile(g_SrmFiles[format].storage, srm);
     if (SUCCESS != ret)
     {
-        HDCP_ASSERTMESSAGE("Could not verify DSA signature of buffer!");
         return ret;
     }
 
-    // At this point we need to start building the new list of VRLs
-    revocationLists = new (std::nothrow) std::list<VectorRevocationList*>;
-    if (revocationLists == nullptr)
+    SrmFormat storedFormat = SRM_FORMAT_HDCP1;
+    if (srm.empty() ||
+        SUCCESS != GetSrmFormat(srm.data(), srm.size(), storedFormat) ||
+        format != storedFormat)
     {
-        HDCP_ASSERTMESSAGE("Failed to allocate a new list of VRLs!");
-        return ENOMEM;
+        HDCP_WARNMESSAGE(
+                "Ignoring the new SRM file %s",
+                g_SrmFiles[format].storage);
+        return EINVAL;
     }
 
-    vrl = new (std::nothrow) VectorRevocationList(vrlList, vrlLength);
-    if (vrl == nullptr)
-    {
-        HDCP_ASSERTMESSAGE("Allocation of new VectorRevocationList failed!");
-        ret = ENOMEM;
-        goto out_kill_list;
-    }
-    if (!vrl->IsValid())
+    // Same path as an SRM sent by an app, our own writes end here too and
+    // stop at the digest check
+    ret = RetrieveSrmFromBuffer(srm.data(), srm.size());
+    if (EALREADY == ret)
     {
-        HDCP_ASSERTMESSAGE("Creation of new VectorRevocationList failed!");
-        ret = EINVAL;
-        delete vrl;
-        goto out_kill_list;
+        return ret;
     }
-
-    revocationLists->push_back(vrl);
-
-    while (offset < length)
+    if (SUCCESS != ret)
     {
-        // Make sure enough msg left to read the next VRL length (2 bytes)
-        if (offset + 2 > length)
-        {
-            HDCP_ASSERTMESSAGE("VRL header is too small to read!");
-            ret = EINVAL;
-            goto out_kill_list;
-        }
-        else
-        {
-            // The first 2 bytes of the buffer contain length of the gen2+ VRL
-            vrlLength = 0;
-            vrlLength |= buf[offset++] << 8;
-            vrlLength |= buf[offset++] << 0;
-            if ((offset + vrlLength) > length)
-            {
-                HDCP_ASSERTMESSAGE(
-                    "VRL length doesn't match the proclaimed length!");
-                ret = EINVAL;
-                goto out_kill_list;
-            }
-            
-            // vrlLength contains:
-            //      2 bytes required for the length itself
-            //      40 bytes of signature data (2 signatures R/S)
-            //      variable number of bytes of actual VRL lists
-            if (vrlLength < (2 + (2 * DSA_SIG_LENGTH)))
-            {
-                HDCP_ASSERTMESSAGE(
-                    "VRL length could not fit DSA sig and length bits!");
-                ret = EINVAL;
-                goto out_kill_list;
-            }
-            else
-            {
-                vrlLength -= 2;
-                vrlLength -= (2 * DSA_SIG_LENGTH);
-            
-                // After that comes the variable length VRL lists
-                vrlList = &buf[offset];
-                offset += vrlLength; 
-            
-                // And next comes the r & s values of the sigature
-                // (using DSA - Digital Signature Algorithm)
-                signatureR = &buf[offset];
-                offset += DSA_SIG_LENGTH;
-                signatureS = &buf[offset];
-                offset += DSA_SIG_LENGTH;
-            
-                HDCP_ASSERTMESSAGE("vrlLength %d", vrlLength);
-                // Now validate the signature of the data
-                ret = VerifySignature(
-                                vrlList,
-                                vrlLength,
-                                signatureR,
-                                signatureS); 
-                if (SUCCESS != ret)
-                {
-                    HDCP_ASSERTMESSAGE(
-                            "Failed to verify the DSA signature of the VRL!");
-                    goto out_kill_list;
-                }
-            
-                vrl = new (std::nothrow) VectorRevocationList(
-                                                    vrlList,
-                                                    vrlLength);
-                if (nullptr == vrl)
-                {
-                    HDCP_ASSERTMESSAGE(
-                            "Allocation of new VectorRevocationList failed!");
-                    ret = ENOMEM;
-                    goto out_kill_list;
-                }
-                if (!vrl->IsValid())
-                {
-                    HDCP_ASSERTMESSAGE(
-                            "Creation of new VectorRevocationList failed!");
-                    ret = EINVAL;
-                    delete vrl;
-                    goto out_kill_list;
-                }
-            
-                revocationLists->push_back(vrl);
-            }
-        }   
+        HDCP_WARNMESSAGE("Ignoring the new SRM file. Err: %s", strerror(ret));
+        return ret;
     }
 
-    // If we hit this, the new Srm Table was built successfully
-    // We can destroy the old list
-    ACQUIRE_LOCK(&m_RevocationListMutex);
-    while (!m_RevocationListsByGeneration->empty())
-    {
-        vrl = m_RevocationListsByGeneration->back();
-        delete vrl;
-        m_RevocationListsByGeneration->pop_back();
-    }
-    delete m_RevocationListsByGeneration;
-    m_RevocationListsByGeneration = revocationLists;
-    m_Version = srmHeader.version;
-    m_Generation = srmHeader.generation;
-    RELEASE_LOCK(&m_RevocationListMutex);
+    HDCP_NORMALMESSAGE("Reloaded SRM file after it changed");
 
-    ret = SUCCESS;
-    goto out;
+    // Refresh the firmware file
+    ret = QueuePersist(format, srm.data(), srm.size());
 
-out_kill_list:
-    while (!revocationLists->empty())
-    {
-        vrl = revocationLists->back();
-        delete vrl;
-        revocationLists->pop_back();
-    }
-    delete revocationLists;
-out:
     HDCP_FUNCTION_EXIT(ret);
     return ret;
 }
 
-int32_t SrmTable::CheckSrmRevoke(const uint8_t ksv[KSV_SIZE])
+int32_t SrmTable::GetSrmVersion(const SrmFormat format, uint16_t *version)
 {
     HDCP_FUNCTION_ENTER;
 
-    CHECK_PARAM_NULL(ksv, EINVAL);
-    
-    ACQUIRE_LOCK(&m_RevocationListMutex);
-
-    if (nullptr == m_RevocationListsByGeneration)
-    {
-        // This is extremely rare state that is never expected to be hit
-        // An srm call was made while the SrmTable is being torn down
-        RELEASE_LOCK(&m_RevocationListMutex);
-        return ENODEV;
-    }
-
-    for (auto vrl = m_RevocationListsByGeneration->begin();
-            vrl != m_RevocationListsByGeneration->end();
-            ++vrl)
-    {
-        if (nullptr == (*vrl))
-        {
-            // This is impossibly inconsistent state.
-            continue;
-        }
-
-        if ((*vrl)->ContainsKsv(ksv))
-        {
-            // Our KSV is on the revocation list!
-            RELEASE_LOCK(&m_RevocationListMutex);
-            return EACCES;
-        }
-    }
-    RELEASE_LOCK(&m_RevocationListMutex);
+    CHECK_PARAM_NULL(version, EINVAL);
+    *version = GetSnapshot(format)->GetVersion();
 
     HDCP_FUNCTION_EXIT(SUCCESS);
     return SUCCESS;
 }
 
-int32_t SrmTable::GetSrmVersion(uint16_t *version)
+std::shared_ptr<const SrmSnapshot> SrmTable::GetSnapshot(
+                                            const SrmFormat format)
 {
-    HDCP_FUNCTION_ENTER;
-
-    CHECK_PARAM_NULL(version, EINVAL);
-    *version = m_Version;
-
-    HDCP_FUNCTION_EXIT(SUCCESS);
-    return SUCCESS;
+    return std::atomic_load(&m_Snapshot[format]);
 }
 
 int32_t GetSrmVersion(uint16_t *version)
@@ -878,7 +2191,8 @@ int32_t GetSrmVersion(uint16_t *version)
         return ENODEV;
     }
 
-    uint32_t ret = g_pSrmTable->GetSrmVersion(version);
+    // The SDK only reports the HDCP 1.x SRM version
+    uint32_t ret = g_pSrmTable->GetSrmVersion(SRM_FORMAT_HDCP1, version);
 
     HDCP_FUNCTION_EXIT(ret);
     return ret;
@@ -894,56 +2208,82 @@ int32_t StoreSrm(const uint8_t *data, const uint32_t size)
         return ENODEV;
     }
 
+    SrmFormat format = SRM_FORMAT_HDCP1;
+    int32_t ret = SrmTable::GetSrmFormat(data, size, format);
+    if (SUCCESS != ret)
+    {
+        return ret;
+    }
+
     // Update our current copy of the SRM
-    int32_t ret = g_pSrmTable->RetrieveSrmFromBuffer(data, size);
+    ret = g_pSrmTable->RetrieveSrmFromBuffer(data, size);
+    if (EALREADY == ret)
+    {
+        // Same content as what is already stored
+        return ret;
+    }
     if (SUCCESS != ret)
     {
         HDCP_ASSERTMESSAGE("Failed to update local copy of SRM!");
         return ret;
     }
 
-    if (!g_pSrmTable->IsSrmStorageDisable())
+    // The new SRM is already in use, storing it can happen in background
+    ret = g_pSrmTable->QueuePersist(format, data, size);
+    if (SUCCESS != ret)
     {
-        // Store our copy of the SRM to non-volatile storage
-        int32_t fd = open(
-                    SRM_STORAGE_FILENAME,
-                    O_WRONLY|O_CREAT,
-                    S_IRUSR|S_IWUSR);
-        if (ERROR == fd)
-        {
-            HDCP_ASSERTMESSAGE(
-                    "Could not open non-volatile storage to save SRM file %s!",
-                    SRM_STORAGE_FILENAME);
-            return EIO;
-        }
+        HDCP_ASSERTMESSAGE("Failed to queue the SRM for storage!");
+        return ret;
+    }
 
-        size_t bytesWritten = write(fd, data, size);
-        if (bytesWritten != static_cast<size_t>(size))
-        {
-            HDCP_ASSERTMESSAGE(
-            "Wrote a different number of bytes to"
-            "storage than srm message length!");
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return SUCCESS;
+}
 
-            close(fd);
-            return EIO;
-        }
+int32_t CheckSrmRevoke(const SrmFormat format, const uint8_t ksv[KSV_SIZE])
+{
+    HDCP_FUNCTION_ENTER;
 
-        close(fd);
+    int32_t ret = ENODEV;
+
+    if (format >= SRM_FORMAT_COUNT)
+    {
+        ret = EINVAL;
+    }
+    else if (g_pSrmTable != nullptr)
+    {
+        ret = g_pSrmTable->CheckSrmRevoke(format, ksv);
+    }
+    else
+    {
+        HDCP_ASSERTMESSAGE("SrmTable is nullptr!");
     }
 
-    HDCP_FUNCTION_EXIT(SUCCESS);
-    return SUCCESS;
+    HDCP_FUNCTION_EXIT(ret);
+    return ret;
 }
 
-int32_t CheckSrmRevoke(const uint8_t ksv[KSV_SIZE])
+int32_t CheckSrmRevokeList(
+            const SrmFormat format,
+            const uint8_t *ksvList,
+            const uint32_t ksvCount,
+            std::vector<uint32_t>& revoked)
 {
     HDCP_FUNCTION_ENTER;
 
     int32_t ret = ENODEV;
 
-    if (g_pSrmTable != nullptr)
+    if (format >= SRM_FORMAT_COUNT)
+    {
+        ret = EINVAL;
+    }
+    else if (g_pSrmTable != nullptr)
     {
-        ret = g_pSrmTable->CheckSrmRevoke(ksv);
+        ret = g_pSrmTable->CheckSrmRevokeList(
+                                    format,
+                                    ksvList,
+                                    ksvCount,
+                                    revoked);
     }
     else
     {
@@ -979,6 +2319,22 @@ int32_t SrmInit(void)
         return EINVAL;
     }
 
+    int32_t ret = g_pSrmTable->StartPersistence();
+    if (SUCCESS != ret)
+    {
+        HDCP_ASSERTMESSAGE("Failed to start the SRM storage thread!");
+        delete g_pSrmTable;
+        g_pSrmTable = nullptr;
+        return ret;
+    }
+
+    // Not fatal, new SRMs can still be sent through the SDK
+    ret = g_pSrmTable->StartWatch();
+    if (SUCCESS != ret)
+    {
+        HDCP_WARNMESSAGE("SRM file changes won't be picked up");
+    }
+
     HDCP_FUNCTION_EXIT(SUCCESS);
     return SUCCESS;
 }
@@ -987,6 +2343,13 @@ void SrmRelease(void)
 {
     HDCP_FUNCTION_ENTER;
 
+    if (nullptr != g_pSrmTable)
+    {
+        // Don't lose an SRM that was accepted but not stored yet
+        g_pSrmTable->StopWatch();
+        g_pSrmTable->StopPersistence();
+    }
+
     delete g_pSrmTable;
     g_pSrmTable = nullptr;
 
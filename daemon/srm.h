@@ -28,27 +28,66 @@
 #define __HDCP_SRM_H__
 
 #include <list>
+#include <vector>
+#include <memory>
 #include <pthread.h>
+#include <openssl/evp.h>
+#include <openssl/sha.h>
 
 #include "hdcpdef.h"
 #include "hdcpapi.h"
 #include "port.h"
 
-#define SRM_STORAGE_FILENAME    "/var/run/hdcp/.hdcpsrmlist.bin"
+#define SRM_STORAGE_DIR         "/var/run/hdcp"
+#define SRM_STORAGE_BASENAME    ".hdcpsrmlist.bin"
+#define SRM_STORAGE_FILENAME    SRM_STORAGE_DIR "/" SRM_STORAGE_BASENAME
+
+// HDCP 2.x SRMs are kept apart, both formats are in use at the same time
+#define SRM2_STORAGE_BASENAME   ".hdcp2srmlist.bin"
+#define SRM2_STORAGE_FILENAME   SRM_STORAGE_DIR "/" SRM2_STORAGE_BASENAME
 
 #define DSA_SIG_LENGTH          20
 #define SRM_HEADER_LENGTH       5
 
 #define SRM_HEADER_ID           0x8
+#define SRM2_HEADER_ID          0x9
+
+// DCP LLC signature of HDCP 2.x SRMs, RSASSA-PKCS1-v1_5 with SHA-256
+#define RSA_SIG_LENGTH          384
+#define RSA_KEY_BITS            (RSA_SIG_LENGTH * 8)
+
+// The DCP LLC public key is provisioned in PEM format, HDCP 2.x SRMs are
+// rejected when it is missing
+#ifndef SRM2_PUBLIC_KEY_FILENAME
+#define SRM2_PUBLIC_KEY_FILENAME "/etc/hdcp/hdcp2_srm_pubkey.pem"
+#endif
 
 #define DSA_SUCCESS      1
 #define DSA_FAIL         0
 
 #define SRM_FIRST_GEN_MAX_SIZE  5116    // From HDCP HDMI spec
 
+// Header, generation length, device count, up to 1023 receiver IDs and the
+// DCP LLC signature
+#define SRM2_FIRST_GEN_MAX_SIZE \
+    (SRM_HEADER_LENGTH + 3 + 4 + 1023 * KSV_SIZE + RSA_SIG_LENGTH)
+
+// Upper bound of threads verifying the generations of one SRM, the caller
+// and the helpers started once with the SrmTable
+#define SRM_VERIFY_THREADS_MAX  4
+#define SRM_VERIFY_HELPERS_MAX  (SRM_VERIFY_THREADS_MAX - 1)
+
 //KMD reads SRM from this FW file then do HDCP revocation check
 #define DISPLAY_SRM_STORAGE_FILE "/lib/firmware/display_hdcp_srm.bin"
 
+typedef enum _SrmFormat
+{
+    SRM_FORMAT_HDCP1    = 0,    // KSVs, DSA signatures
+    SRM_FORMAT_HDCP2    = 1,    // receiver IDs, RSA signatures
+    SRM_FORMAT_COUNT
+} SrmFormat;
+
+// Common to both formats
 typedef struct _SrmHeader
 {
     union
@@ -64,6 +103,90 @@ typedef struct _SrmHeader
     };
 } SrmHeader;
 
+// One signed part of an SRM: the first generation covers the header and its
+// VRL, the next generations only cover their VRL. The DSA signature is R
+// followed by S.
+typedef struct _SrmSignedBlock
+{
+    const uint8_t   *msg;
+    uint32_t        msgLen;
+    const uint8_t   *vrl;
+    uint32_t        vrlLength;
+    const uint8_t   *signature;
+    uint32_t        signatureLength;
+} SrmSignedBlock;
+
+class RevocationIndex
+{
+    // Declare member variables
+private:
+    // Revoked KSVs packed into the low 40 bits, sorted and deduplicated
+    std::vector<uint64_t> m_Keys;
+
+    // Declare member functions
+public:
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Pack a KSV into a 40-bit key, ksv[0] being the most
+    ///         significant byte
+    ///
+    /// \param[in]  ksv     KSV to pack
+    /// \return     packed key
+    ///////////////////////////////////////////////////////////////////////////
+    static uint64_t PackKsv(const uint8_t ksv[KSV_SIZE]);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Add a packed KSV to the index, Finalize must be called before
+    ///         the index is used for lookups
+    ///
+    /// \param[in]  key     packed KSV
+    ///////////////////////////////////////////////////////////////////////////
+    void Insert(const uint64_t key);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Sort and deduplicate the keys inserted so far
+    ///////////////////////////////////////////////////////////////////////////
+    void Finalize(void);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Check if a packed KSV is in the index
+    ///
+    /// \param[in]  key     packed KSV
+    /// \return     true if the KSV is revoked, false otherwise
+    ///////////////////////////////////////////////////////////////////////////
+    bool Contains(const uint64_t key) const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Check several packed KSVs against the index at once
+    ///
+    /// \param[in]  keys        packed KSVs
+    /// \param[in]  count       number of packed KSVs
+    /// \param[out] revoked     receives the positions in keys of the KSVs
+    ///                         found in the index
+    ///
+    /// All the searches advance in lockstep, so the loads of one step are
+    /// independent and the inner loop is a candidate for vectorization.
+    ///////////////////////////////////////////////////////////////////////////
+    void ContainsBatch(
+            const uint64_t *keys,
+            const uint32_t count,
+            std::vector<uint32_t>& revoked) const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Get number of distinct KSVs in the index
+    ///
+    /// \return     number of KSVs
+    ///////////////////////////////////////////////////////////////////////////
+    size_t GetCount(void) const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Exchange the content of two indexes
+    ///
+    /// \param[in/out]  other   index to swap with
+    ///////////////////////////////////////////////////////////////////////////
+    void Swap(RevocationIndex& other);
+};
+
 class VectorRevocationList
 {
     // Declare member variables
@@ -71,7 +194,9 @@ private:
     bool    m_IsValid;
 
     uint8_t m_NumberOfDevices;
-    uint8_t *m_KsvArray;
+
+    // Points into the SRM buffer the VRL was parsed from
+    const uint8_t *m_KsvArray;
 
     // Declare member functions
 public:
@@ -82,9 +207,9 @@ public:
     /// \param[in]  buf     VRL containing number of KSVs and array of KSVs
     /// \param[in]  length  Total size of the buffer in bytes
     ///
-    /// This will parse the buffer and build the data structure holding KSVs.
-    /// If the buffer contains inconsistent data then this instance of VRL will
-    /// have the m_IsValid value set to FALSE.
+    /// This will parse the buffer without copying it, so the buffer must
+    /// outlive the VRL. If the buffer contains inconsistent data then this
+    /// instance of VRL will have the m_IsValid value set to FALSE.
     ///
     /// It is important for calling functions to call IsValid on the VRL after
     /// creation.
@@ -92,19 +217,11 @@ public:
     VectorRevocationList(const uint8_t *buf, const uint16_t length);
 
     ///////////////////////////////////////////////////////////////////////////
-    /// \brief Destructor for the VectorRevocationList class
-    ///
-    /// This will clean up the memory allocated by the VRL to hold the KSVs
-    ///////////////////////////////////////////////////////////////////////////
-    ~VectorRevocationList(void);
-
-    ///////////////////////////////////////////////////////////////////////////
-    /// \brief Check the KSV array within the VRL for a specific KSV
+    /// \brief  Add the KSVs of the VRL to a revocation index
     ///
-    /// \param[in]  ksv     KSV we are trying to match
-    /// \return     true if a match is found, false if no match
+    /// \param[in/out]  index   index receiving the KSVs
     ///////////////////////////////////////////////////////////////////////////
-    bool ContainsKsv(const uint8_t ksv[KSV_SIZE]);
+    void AddToIndex(RevocationIndex& index);
 
     ///////////////////////////////////////////////////////////////////////////
     /// \brief  Test if the VRL was created successfully
@@ -123,17 +240,260 @@ private:
     VectorRevocationList & operator=(const VectorRevocationList&) = delete;
 };
 
+class ReceiverIdList
+{
+    // Declare member variables
+private:
+    bool    m_IsValid;
+
+    uint32_t m_NumberOfDevices;
+
+    // Points into the SRM buffer the list was parsed from
+    const uint8_t *m_ReceiverIds;
+
+    // Declare member functions
+public:
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Constructor for the ReceiverIdList class
+    ///
+    /// \param[in]  buf                 number of devices field followed by
+    ///                                 the receiver IDs of one generation
+    /// \param[in]  length              Total size of the buffer in bytes
+    /// \param[in]  isFirstGeneration   the first generation has a 4 bytes
+    ///                                 number of devices field, the next
+    ///                                 ones a 2 bytes one
+    ///
+    /// Like VectorRevocationList, the buffer must outlive the list and
+    /// IsValid must be called after creation.
+    ///////////////////////////////////////////////////////////////////////////
+    ReceiverIdList(
+            const uint8_t *buf,
+            const uint32_t length,
+            const bool isFirstGeneration);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Add the receiver IDs of the list to a revocation index
+    ///
+    /// \param[in/out]  index   index receiving the receiver IDs
+    ///////////////////////////////////////////////////////////////////////////
+    void AddToIndex(RevocationIndex& index);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Test if the list was created successfully
+    ///
+    /// \return true if successfully created, false otherwise
+    ///////////////////////////////////////////////////////////////////////////
+    bool IsValid(void);
+
+private:
+    // Remove copy/assignment operations
+    ReceiverIdList(const ReceiverIdList&) = delete;
+    ReceiverIdList & operator=(const ReceiverIdList&) = delete;
+};
+
+class SrmSnapshot
+{
+    // Declare member variables
+private:
+    const uint16_t  m_Version;   // higher number means more recent
+    const uint8_t   m_Generation;
+
+    // SHA-256 of the SRM message, all zero for the initial empty SRM
+    uint8_t         m_Digest[SHA256_DIGEST_LENGTH];
+
+    // Revoked KSVs or receiver IDs of all generations
+    RevocationIndex m_RevocationIndex;
+
+    // Declare member functions
+public:
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Constructor for the SrmSnapshot class
+    ///
+    /// \param[in]      version     version of the SRM
+    /// \param[in]      generation  number of generations of the SRM
+    /// \param[in]      digest      SHA-256 of the SRM message, or nullptr
+    /// \param[in/out]  index       finalized index, its keys are moved into
+    ///                             the snapshot
+    ///
+    /// A snapshot never changes once published, a new SRM gets a new one.
+    ///////////////////////////////////////////////////////////////////////////
+    SrmSnapshot(
+            const uint16_t version,
+            const uint8_t generation,
+            const uint8_t *digest,
+            RevocationIndex& index);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Check if an SRM message is the one of this snapshot
+    ///
+    /// \param[in]  digest  SHA-256 of the SRM message
+    /// \return     true if the digests match
+    ///////////////////////////////////////////////////////////////////////////
+    bool IsSameSrm(const uint8_t digest[SHA256_DIGEST_LENGTH]) const;
+
+    uint16_t GetVersion(void) const {return m_Version;}
+
+    uint8_t GetGeneration(void) const {return m_Generation;}
+
+    const uint8_t *GetDigest(void) const {return m_Digest;}
+
+    const RevocationIndex& GetIndex(void) const {return m_RevocationIndex;}
+
+private:
+    // Remove copy/assignment operations
+    SrmSnapshot(const SrmSnapshot&) = delete;
+    SrmSnapshot & operator=(const SrmSnapshot&) = delete;
+};
+
+// Signature verification of one SRM format through EVP, so hashing runs on
+// the implementation OpenSSL picks for the CPU
+class SignatureEngine
+{
+    // Declare member variables
+private:
+    EVP_PKEY        *m_Key;
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_MD          *m_Md;      // fetched once, not on every verification
+#else
+    const EVP_MD    *m_Md;
+#endif
+
+    // DSA signatures come as raw R and S, RSA ones are used as they are
+    bool            m_IsDsa;
+
+    // Declare member functions
+public:
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Constructor for the SignatureEngine class
+    ///
+    /// \param[in]  key     DSA or RSA public key, owned by the engine after
+    ///                     that
+    /// \param[in]  mdName  name of the digest of the signatures
+    ///
+    /// The engine is only read after construction, so concurrent
+    /// verifications can share it. Call IsValid after creation.
+    ///////////////////////////////////////////////////////////////////////////
+    SignatureEngine(EVP_PKEY *key, const char *mdName);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Destructor for the SignatureEngine class
+    ///////////////////////////////////////////////////////////////////////////
+    ~SignatureEngine(void);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Test if the engine was created successfully
+    ///
+    /// \return true if successfully created, false otherwise
+    ///////////////////////////////////////////////////////////////////////////
+    bool IsValid(void) const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Verify the signature of a message
+    ///
+    /// \param[in]  ctx     digest context of the calling thread, reset and
+    ///                     reused by every call
+    /// \param[in]  msg     data to validate
+    /// \param[in]  msgLen  length of the message
+    /// \param[in]  sig     R followed by S for DSA, PKCS #1 v1.5 for RSA
+    /// \param[in]  sigLen  length of the signature
+    /// \return     SUCCESS or errno otherwise
+    ///////////////////////////////////////////////////////////////////////////
+    int32_t Verify(
+            EVP_MD_CTX      *ctx,
+            const uint8_t   *msg,
+            const uint32_t  msgLen,
+            const uint8_t   *sig,
+            const uint32_t  sigLen) const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Build a DSA public key from the SRM domain parameters
+    ///
+    /// \param[in]  pubKey      big-endian public key
+    /// \param[in]  pubKeySize  size in bytes of the public key
+    /// \return     new key, or nullptr on failure
+    ///////////////////////////////////////////////////////////////////////////
+    static EVP_PKEY *CreateDsaKey(
+            const uint8_t   *pubKey,
+            const size_t    pubKeySize);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Load the RSA key of the HDCP 2.x SRM signatures
+    ///
+    /// \param[in]  path    PEM file holding the public key
+    /// \return     new key, or nullptr if missing or not a 3072 bits RSA key
+    ///////////////////////////////////////////////////////////////////////////
+    static EVP_PKEY *LoadRsaKey(const char *path);
+
+private:
+    // Remove copy/assignment operations
+    SignatureEngine(const SignatureEngine&) = delete;
+    SignatureEngine & operator=(const SignatureEngine&) = delete;
+};
+
+// State shared by the threads verifying one SRM
+typedef struct _SrmVerifyJob
+{
+    const SignatureEngine               *engine;
+    const std::vector<SrmSignedBlock>   *blocks;
+    pthread_mutex_t                     mutex;
+    uint32_t                            next;   // next block to verify
+    int32_t                             result;
+} SrmVerifyJob;
+
 class SrmTable
 {
     // Declare member variables
 private:
     bool        m_IsValid;
-    uint16_t    m_Version;   // higher number means more recent
-    uint8_t     m_Generation;
     bool        m_IsSrmStorageDisable;
 
-    std::list<VectorRevocationList*>    *m_RevocationListsByGeneration;
-    pthread_mutex_t                     m_RevocationListMutex;
+    // Current SRM of each format, only accessed with
+    // std::atomic_load/atomic_store so readers never wait on a new SRM being
+    // parsed
+    std::shared_ptr<const SrmSnapshot>  m_Snapshot[SRM_FORMAT_COUNT];
+
+    // Serializes the writers of m_Snapshot
+    pthread_mutex_t                     m_UpdateMutex;
+
+    // Storage of new SRMs runs on its own thread so the dispatch thread
+    // never waits on fsync. Only the latest pending SRM of each format is
+    // kept.
+    pthread_t                           m_PersistThread;
+    pthread_mutex_t                     m_PersistMutex;
+    pthread_cond_t                      m_PersistCV;
+    std::vector<uint8_t>                m_PendingSrm[SRM_FORMAT_COUNT];
+    bool                                m_IsPersistPending[SRM_FORMAT_COUNT];
+    bool                                m_IsPersistRunning;
+    bool                                m_IsPersistExit;
+
+    // The stored SRMs get reloaded when another process replaces them
+    pthread_t                           m_WatchThread;
+    int32_t                             m_WatchFd;      // inotify
+    int32_t                             m_WatchStopFd;  // eventfd
+    bool                                m_IsWatchRunning;
+
+    // Helpers verifying the generations of an SRM along with the caller.
+    // They take m_VerifyJob each time m_VerifyJobId changes, one job at a
+    // time.
+    pthread_t                           m_VerifyThreads[SRM_VERIFY_HELPERS_MAX];
+    uint32_t                            m_VerifyThreadCount;
+    pthread_mutex_t                     m_VerifyMutex;
+    pthread_cond_t                      m_VerifyCV;     // job posted or exit
+    pthread_cond_t                      m_VerifyDoneCV; // helper left a job
+    SrmVerifyJob                        *m_VerifyJob;
+    uint32_t                            m_VerifyJobId;
+    uint32_t                            m_VerifyBusyCount;
+    bool                                m_IsVerifyExit;
+
+    // Signature verification of each format, nullptr for HDCP 2.x if no key
+    // is provisioned
+    SignatureEngine                     *m_Engine[SRM_FORMAT_COUNT];
+#ifdef SRM_ULT_BUILD
+    SignatureEngine                     *m_FacsimileEngine;
+#endif
 
     // Declare member functions
 public:
@@ -181,44 +541,231 @@ public:
     ///////////////////////////////////////////////////////////////////////////
     /// \brief  Check if the provided KSV has been revoked
     ///
+    /// \param[in]  format  SRM to check against, a HDCP 2.x receiver ID is
+    ///                     checked against SRM_FORMAT_HDCP2
     /// \param[in]  ksv     The ksv we want to check revocation status for
     /// \return     SUCCESS or errno otherwise
     ///////////////////////////////////////////////////////////////////////////
-    int32_t CheckSrmRevoke(const uint8_t ksv[KSV_SIZE]);
+    int32_t CheckSrmRevoke(
+            const SrmFormat format,
+            const uint8_t ksv[KSV_SIZE]);
 
     ///////////////////////////////////////////////////////////////////////////
-    /// \brief  Parse a new set of VRLs from a SRM buffer
+    /// \brief  Check a list of KSVs against the revocation index
+    ///
+    /// \param[in]  format      SRM to check against
+    /// \param[in]  ksvList     KSVs to check, KSV_SIZE bytes each
+    /// \param[in]  ksvCount    number of KSVs in ksvList
+    /// \param[out] revoked     receives the indices in ksvList of the
+    ///                         revoked KSVs
+    /// \return     SUCCESS if none is revoked, EACCES if any is revoked or
+    ///             errno otherwise
+    ///////////////////////////////////////////////////////////////////////////
+    int32_t CheckSrmRevokeList(
+            const SrmFormat format,
+            const uint8_t *ksvList,
+            const uint32_t ksvCount,
+            std::vector<uint32_t>& revoked);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Get the format of an SRM message from its header
     ///
     /// \param[in]  buf     The SRM message
     /// \param[in]  length  Raw size in bytes of the SRM message
-    /// \return     SUCCESS or errno otherwise
+    /// \param[out] format  format of the message
+    /// \return     SUCCESS or EINVAL if this is not an SRM header
+    ///////////////////////////////////////////////////////////////////////////
+    static int32_t GetSrmFormat(
+            const uint8_t *buf,
+            const size_t length,
+            SrmFormat& format);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Parse a new set of VRLs from a SRM buffer
+    ///
+    /// \param[in]  buf     The SRM message, of either format
+    /// \param[in]  length  Raw size in bytes of the SRM message
+    /// \return     SUCCESS, EALREADY if the message is the SRM in use or
+    ///             errno otherwise
     ///////////////////////////////////////////////////////////////////////////
     int32_t RetrieveSrmFromBuffer(const uint8_t *buf, const size_t length);
 
     ///////////////////////////////////////////////////////////////////////////
-    /// \brief Verify the signature of a message using DSA
+    /// \brief  Get the SRM currently in use
     ///
-    /// \param[in]  pMsg    data to validate
-    /// \param[in]  msgLen  length of the message
-    /// \param[in]  pR      The R signature value used in validation
-    /// \param[in]  pS      The S signature value used in validation
+    /// \param[in]  format  format of the SRM
+    /// \return     snapshot of the SRM, kept alive as long as it is referenced
+    ///////////////////////////////////////////////////////////////////////////
+    std::shared_ptr<const SrmSnapshot> GetSnapshot(const SrmFormat format);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Load the stored SRM of a format at startup
+    ///
+    /// \param[in]  format  format of the SRM
     /// \return     SUCCESS or errno otherwise
     ///////////////////////////////////////////////////////////////////////////
-    int32_t VerifySignature(
-            const uint8_t   *pMsg,
-            const uint32_t  msgLen,
-            const uint8_t   pR[DSA_SIG_LENGTH],
-            const uint8_t   pS[DSA_SIG_LENGTH]);
+    int32_t LoadStoredSrm(const SrmFormat format);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Start the thread storing new SRMs
+    ///
+    /// \return     SUCCESS or errno otherwise
+    ///////////////////////////////////////////////////////////////////////////
+    int32_t StartPersistence(void);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Store the pending SRM, if any, and stop the storing thread
+    ///////////////////////////////////////////////////////////////////////////
+    void StopPersistence(void);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Queue an SRM message for storage, replacing any SRM of the
+    ///         same format still waiting to be stored
+    ///
+    /// \param[in]  format  format of the message
+    /// \param[in]  data    SRM message
+    /// \param[in]  size    size in bytes of the message
+    /// \return     SUCCESS or errno otherwise
+    ///////////////////////////////////////////////////////////////////////////
+    int32_t QueuePersist(
+            const SrmFormat format,
+            const uint8_t *data,
+            const uint32_t size);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Start watching SRM_STORAGE_DIR for new SRM files
+    ///
+    /// \return     SUCCESS or errno otherwise
+    ///////////////////////////////////////////////////////////////////////////
+    int32_t StartWatch(void);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Stop watching SRM_STORAGE_DIR
+    ///////////////////////////////////////////////////////////////////////////
+    void StopWatch(void);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Load a stored SRM again after it changed on disk
+    ///
+    /// \param[in]  format  format of the SRM
+    /// \return     SUCCESS, EALREADY if it holds the SRM in use or errno
+    ///             otherwise
+    ///////////////////////////////////////////////////////////////////////////
+    int32_t ReloadStoredSrm(const SrmFormat format);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Verify the signatures of several SRM generations concurrently
+    ///
+    /// \param[in]  format  format of the SRM
+    /// \param[in]  blocks  signed parts of the SRM, framing already checked
+    /// \return     SUCCESS if every signature is valid, errno otherwise
+    ///
+    /// The caller and the verification helpers take the blocks one after
+    /// another until all are verified or one fails. A single block is
+    /// verified by the caller alone.
+    ///////////////////////////////////////////////////////////////////////////
+    int32_t VerifySignatures(
+            const SrmFormat format,
+            const std::vector<SrmSignedBlock>& blocks);
 
     ///////////////////////////////////////////////////////////////////////////
     /// \brief  GetSrmVersion
     ///
+    /// \param[in]     format  format of the SRM
     /// \param[out]    Srm current version
     /// \return     SUCCESS or errno otherwise
     ///////////////////////////////////////////////////////////////////////////
-    int32_t GetSrmVersion(uint16_t *version);
+    int32_t GetSrmVersion(const SrmFormat format, uint16_t *version);
 
 private:
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Verify blocks of a job until none is left or one fails
+    ///
+    /// \param[in]  job     shared verification job
+    /// \param[in]  ctx     digest context of the calling thread
+    ///////////////////////////////////////////////////////////////////////////
+    static void VerifyBlocks(SrmVerifyJob *job, EVP_MD_CTX *ctx);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Main function of the verification helpers
+    ///
+    /// \param[in]  arg     SrmTable
+    /// \return     nullptr
+    ///////////////////////////////////////////////////////////////////////////
+    static void *VerifyWorker(void *arg);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Start the verification helpers
+    ///
+    /// Not fatal if they can't all be started, the callers of
+    /// VerifySignatures do the work left.
+    ///////////////////////////////////////////////////////////////////////////
+    void StartVerifyPool(void);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Stop the verification helpers
+    ///////////////////////////////////////////////////////////////////////////
+    void StopVerifyPool(void);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Get the signature engine of a format
+    ///
+    /// \param[in]  format  format of the SRM
+    /// \return     engine, or nullptr if that format can't be verified
+    ///////////////////////////////////////////////////////////////////////////
+    SignatureEngine *GetEngine(const SrmFormat format);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Main function of the thread storing new SRMs
+    ///
+    /// \param[in]  arg     SrmTable
+    /// \return     nullptr
+    ///////////////////////////////////////////////////////////////////////////
+    static void *PersistWorker(void *arg);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Main function of the thread watching SRM_STORAGE_DIR
+    ///
+    /// \param[in]  arg     SrmTable
+    /// \return     nullptr
+    ///////////////////////////////////////////////////////////////////////////
+    static void *WatchWorker(void *arg);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Split an HDCP 1.x SRM into its signed generations
+    ///
+    /// \param[in]  buf     The SRM message
+    /// \param[in]  length  Raw size in bytes of the SRM message
+    /// \param[out] blocks  signed generations
+    /// \return     SUCCESS or EINVAL if the framing is inconsistent
+    ///////////////////////////////////////////////////////////////////////////
+    static int32_t FrameSrm(
+            const uint8_t *buf,
+            const size_t length,
+            std::vector<SrmSignedBlock>& blocks);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Split an HDCP 2.x SRM into its signed generations
+    ///
+    /// \param[in]  buf     The SRM message
+    /// \param[in]  length  Raw size in bytes of the SRM message
+    /// \param[out] blocks  signed generations
+    /// \return     SUCCESS or EINVAL if the framing is inconsistent
+    ///////////////////////////////////////////////////////////////////////////
+    static int32_t FrameSrm2(
+            const uint8_t *buf,
+            const size_t length,
+            std::vector<SrmSignedBlock>& blocks);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Write an SRM message to its storage file and
+    ///         DISPLAY_SRM_STORAGE_FILE, unless SRM storage is disabled
+    ///
+    /// \param[in]  format  format of the message
+    /// \param[in]  srm     SRM message
+    ///////////////////////////////////////////////////////////////////////////
+    void Persist(const SrmFormat format, const std::vector<uint8_t>& srm);
+
     // Remove copy/assignment operations
     SrmTable(const SrmTable&) = delete;
     SrmTable & operator=(const SrmTable&) = delete;
@@ -234,7 +781,7 @@ int32_t SrmInit(void);
 ///////////////////////////////////////////////////////////////////////////////
 /// \brief  wrapper for SrmTable GetSrmVersion
 ///
-/// \param[out]    Srm current version
+/// \param[out]    Srm current version, of the HDCP 1.x SRM
 /// \return     SUCCESS or errno otherwise
 ///////////////////////////////////////////////////////////////////////////////
 int32_t GetSrmVersion(uint16_t *version);
@@ -251,17 +798,40 @@ void SrmRelease(void);
 ///
 /// \param[in]  data    The new message to store
 /// \param[in]  size    Size in bytes of the new message
-/// \return     SUCCESS or errno otherwise
+/// \return     SUCCESS, EALREADY if the message is the SRM in use, in which
+///             case nothing was stored, or errno otherwise
+///
+/// The SRM is in use when this returns, it reaches the SRM file and the
+/// firmware file asynchronously.
 ///////////////////////////////////////////////////////////////////////////////
 int32_t StoreSrm(const uint8_t *data, const uint32_t size);
 
 ///////////////////////////////////////////////////////////////////////////////
 /// \brief  Interface to the SRM module for checking the validity of a KSV
 ///
+/// \param[in]  format  SRM_FORMAT_HDCP2 for a receiver ID
 /// \param[in]  ksv     KSV we wish to check the revocation status of
 /// \return     SUCCESS or errno otherwise
 ///////////////////////////////////////////////////////////////////////////////
-int32_t CheckSrmRevoke(const uint8_t ksv[KSV_SIZE]);
+int32_t CheckSrmRevoke(const SrmFormat format, const uint8_t ksv[KSV_SIZE]);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Interface to the SRM module for checking a whole topology, the
+///         BKSV followed by the KSVs of the repeater list
+///
+/// \param[in]  format      SRM_FORMAT_HDCP2 for receiver IDs
+/// \param[in]  ksvList     KSVs to check, KSV_SIZE bytes each
+/// \param[in]  ksvCount    number of KSVs in ksvList
+/// \param[out] revoked     receives the indices in ksvList of the revoked
+///                         KSVs
+/// \return     SUCCESS if none is revoked, EACCES if any is revoked or
+///             errno otherwise
+///////////////////////////////////////////////////////////////////////////////
+int32_t CheckSrmRevokeList(
+            const SrmFormat format,
+            const uint8_t *ksvList,
+            const uint32_t ksvCount,
+            std::vector<uint32_t>& revoked);
 
 ///////////////////////////////////////////////////////////////////////////////
 /// \brief  Interface to configure whether SRM will be stored to device or not
@@ -159,6 +159,43 @@ HDCP_STATUS HDCPSetProtectionLevel(
     return ret;
 }
 
+HDCP_STATUS HDCPSetProtectionLevelBatch(
+                    const uint32_t hdcpHandle,
+                    const uint32_t portCount,
+                    const uint32_t *portIds,
+                    const HDCP_LEVEL *levels,
+                    HDCP_STATUS *portResults)
+{
+    HDCP_FUNCTION_ENTER;
+
+    CHECK_PARAM_NULL(portIds, HDCP_STATUS_ERROR_INVALID_PARAMETER);
+    CHECK_PARAM_NULL(levels, HDCP_STATUS_ERROR_INVALID_PARAMETER);
+    CHECK_PARAM_NULL(portResults, HDCP_STATUS_ERROR_INVALID_PARAMETER);
+
+    if ((0 == portCount) || (portCount > NUM_PHYSICAL_PORTS_MAX))
+    {
+        HDCP_ASSERTMESSAGE("Invalid port count");
+        return HDCP_STATUS_ERROR_INVALID_PARAMETER;
+    }
+
+    HdcpSession *session = HdcpSessionManager::GetInstance(hdcpHandle);
+    if (nullptr == session)
+    {
+        HDCP_ASSERTMESSAGE("Session is invalid!");
+        return HDCP_STATUS_ERROR_INTERNAL;
+    }
+
+    HDCP_STATUS ret = session->SetProtectionLevelBatch(
+                                            portCount,
+                                            portIds,
+                                            levels,
+                                            portResults);
+    HdcpSessionManager::PutInstance(hdcpHandle);
+
+    HDCP_FUNCTION_EXIT(ret);
+    return ret;
+}
+
 HDCP_STATUS HDCPGetStatus(
                     const uint32_t hdcpHandle,
                     const uint32_t portId,
@@ -189,6 +226,80 @@ HDCP_STATUS HDCPGetStatus(
     return ret;
 }
 
+HDCP_STATUS HDCPGetStatusBatch(
+                    const uint32_t hdcpHandle,
+                    const uint32_t portCount,
+                    const uint32_t *portIds,
+                    PORT_STATUS *portStatus,
+                    HDCP_STATUS *portResults)
+{
+    HDCP_FUNCTION_ENTER;
+
+    CHECK_PARAM_NULL(portIds, HDCP_STATUS_ERROR_INVALID_PARAMETER);
+    CHECK_PARAM_NULL(portStatus, HDCP_STATUS_ERROR_INVALID_PARAMETER);
+    CHECK_PARAM_NULL(portResults, HDCP_STATUS_ERROR_INVALID_PARAMETER);
+
+    if ((0 == portCount) || (portCount > NUM_PHYSICAL_PORTS_MAX))
+    {
+        HDCP_ASSERTMESSAGE("Invalid port count");
+        return HDCP_STATUS_ERROR_INVALID_PARAMETER;
+    }
+
+    HdcpSession *session = HdcpSessionManager::GetInstance(hdcpHandle);
+    if (nullptr == session)
+    {
+        HDCP_ASSERTMESSAGE("Session is invalid!");
+        return HDCP_STATUS_ERROR_INTERNAL;
+    }
+
+    HDCP_STATUS ret = session->GetStatusBatch(
+                                    portCount,
+                                    portIds,
+                                    portStatus,
+                                    portResults);
+    HdcpSessionManager::PutInstance(hdcpHandle);
+
+    HDCP_FUNCTION_EXIT(ret);
+    return ret;
+}
+
+HDCP_STATUS HDCPWaitForStatus(
+                    const uint32_t hdcpHandle,
+                    const uint32_t portId,
+                    const PORT_STATUS statusMask,
+                    const PORT_STATUS status,
+                    const uint32_t timeoutMs,
+                    PORT_STATUS *portStatus)
+{
+    HDCP_FUNCTION_ENTER;
+
+    CHECK_PARAM_NULL(portStatus, HDCP_STATUS_ERROR_INVALID_PARAMETER);
+
+    if (portId > NUM_PHYSICAL_PORTS_MAX)
+    {
+        HDCP_ASSERTMESSAGE("Invalid port id");
+        return HDCP_STATUS_ERROR_INVALID_PARAMETER;
+    }
+
+    HdcpSession *session = HdcpSessionManager::GetInstance(hdcpHandle);
+    if (nullptr == session)
+    {
+        HDCP_ASSERTMESSAGE("Session is invalid!");
+        return HDCP_STATUS_ERROR_INTERNAL;
+    }
+
+    HDCP_STATUS ret = session->WaitForStatus(
+                                    portId,
+                                    statusMask,
+                                    status,
+                                    timeoutMs,
+                                    portStatus);
+    HdcpSessionManager::PutInstance(hdcpHandle);
+
+    HDCP_FUNCTION_EXIT(ret);
+    return ret;
+}
+
 HDCP_STATUS HDCPGetKsvList(
                     const uint32_t hdcpHandle,
                     const uint32_t portId,
@@ -297,6 +408,46 @@ HDCP_STATUS HDCPConfig(const uint32_t hdcpHandle, HDCP_CONFIG Config)
     return ret;
 }
 
+HDCP_STATUS HDCPGetEventFd(const uint32_t hdcpHandle, int32_t *pEventFd)
+{
+    HDCP_FUNCTION_ENTER;
+
+    CHECK_PARAM_NULL(pEventFd, HDCP_STATUS_ERROR_INVALID_PARAMETER);
+
+    HdcpSession *session = HdcpSessionManager::GetInstance(hdcpHandle);
+    if (nullptr == session)
+    {
+        HDCP_ASSERTMESSAGE("Session is invalid!");
+        return HDCP_STATUS_ERROR_INTERNAL;
+    }
+
+    HDCP_STATUS ret = session->GetEventFd(pEventFd);
+
+    HdcpSessionManager::PutInstance(hdcpHandle);
+
+    HDCP_FUNCTION_EXIT(ret);
+    return ret;
+}
+
+HDCP_STATUS HDCPDispatchEvents(const uint32_t hdcpHandle)
+{
+    HDCP_FUNCTION_ENTER;
+
+    HdcpSession *session = HdcpSessionManager::GetInstance(hdcpHandle);
+    if (nullptr == session)
+    {
+        HDCP_ASSERTMESSAGE("Session is invalid!");
+        return HDCP_STATUS_ERROR_INTERNAL;
+    }
+
+    session->DispatchEvents(false);
+
+    HdcpSessionManager::PutInstance(hdcpHandle);
+
+    HDCP_FUNCTION_EXIT(HDCP_STATUS_SUCCESSFUL);
+    return HDCP_STATUS_SUCCESSFUL;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -75,6 +75,10 @@ typedef unsigned int PORT_STATUS;   // each bit represents one status
 /// \brief A repeater is connected to this port.
 #define PORT_STATUS_REPEATER_ATTACHED   0x08
 
+/// \define PORT_STATUS_REVOKED_DEVICE_ATTACHED
+/// \brief A device of the authenticated topology is revoked by the SRM.
+#define PORT_STATUS_REVOKED_DEVICE_ATTACHED     0x10
+
 /// \define PORT_STATUS_INVALID
 /// \brief The port is pending disable or Meta status
 #define PORT_STATUS_INVALID             ((PORT_STATUS) - 1)
@@ -88,6 +92,7 @@ typedef enum _PORT_EVENT
     PORT_EVENT_PLUG_IN,         // hot plug in
     PORT_EVENT_PLUG_OUT,        // hot plug out
     PORT_EVENT_LINK_LOST,       // HDCP authentication step3 fail
+    PORT_EVENT_LINK_RESTORED,   // HDCP re-enabled by the daemon after link lost
 } PORT_EVENT;
 
 /// \typedef Port
@@ -115,14 +120,24 @@ enum HDCP_CONFIG_TYPE
 {
     INVALID_CONFIG = 0,             // invalid configure type
     SRM_STORAGE_CONFIG,             // config to disable/enable SRM storage
+    AUTO_REAUTH_CONFIG,             // config to re-enable HDCP after link lost
+    DISABLE_LINGER_CONFIG,          // config to delay disabling HDCP
 };
 
 /// \typedef HDCP_CONFIG
 /// \brief Customer can pass configuration to HDCP daemon via this structure.
+///         Only the setting of the given type is read. The settings share
+///         one slot, so the structure keeps the size and layout it had
+///         when it only carried disableSrmStorage.
 typedef struct _HDCP_CONFIG
 {
     enum HDCP_CONFIG_TYPE type;
-    bool disableSrmStorage;
+    union
+    {
+        bool disableSrmStorage;         // SRM_STORAGE_CONFIG
+        bool enableAutoReauth;          // AUTO_REAUTH_CONFIG
+        unsigned int disableLingerMs;   // DISABLE_LINGER_CONFIG
+    };
 } HDCP_CONFIG;
 
 /// \typedef HDCP_STATUS
@@ -167,6 +182,9 @@ typedef enum _HDCP_STATUS
 
     // socket channel is broken
     HDCP_STATUS_ERROR_MSG_TRANSACTION,
+
+    // the port did not reach the awaited status in time
+    HDCP_STATUS_ERROR_TIMEOUT,
 } HDCP_STATUS;
 
 /// \enum HDCP level 0 means disable HDCP,
@@ -269,6 +287,32 @@ HDCP_STATUS HDCPSetProtectionLevel(
                     const uint32_t portId,
                     const HDCP_LEVEL level);
 
+////////////////////////////////////////////////////////////////////////////////
+/// \brief      Enable/Disable the HDCP link on several ports at once.
+/// \par        Details:
+/// \li         Same as calling HDCPSetProtectionLevel for each port, but in a
+///             single request, and the ports authenticate at the same time.
+/// \li         Ports that failed to enable are disabled again, like
+///             HDCPSetProtectionLevel does.
+///
+/// \param[in]  hdcpHandle The HDCP handle.
+/// \param[in]  portCount Number of ports, up to NUM_PHYSICAL_PORTS_MAX.
+/// \param[in]  portIds The identifiers of the ports, each listed once.
+/// \param[in]  levels The level for each port, see HDCPSetProtectionLevel.
+/// \param[out] portResults receives the result for each port.
+/// \return     HDCP_STATUS_SUCCESSFUL if successful for every port
+/// \return     HDCP_STATUS_ERROR_INVALID_PARAMETER
+///             if HDCPContext or an array is NULL, or portCount is out of
+///             range.
+/// \return     The result of the first port that failed otherwise.
+////////////////////////////////////////////////////////////////////////////////
+HDCP_STATUS HDCPSetProtectionLevelBatch(
+                    const uint32_t hdcpHandle,
+                    const uint32_t portCount,
+                    const uint32_t *portIds,
+                    const HDCP_LEVEL *levels,
+                    HDCP_STATUS *portResults);
+
 ////////////////////////////////////////////////////////////////////////////////
 /// \brief      Get the status of the specified port.
 ///
@@ -285,6 +329,62 @@ HDCP_STATUS HDCPGetStatus(
                     const uint32_t portId,
                     PORT_STATUS *portStatus);
 
+////////////////////////////////////////////////////////////////////////////////
+/// \brief      Get the status of several ports at once.
+///
+/// \param[in]  hdcpHandle The HDCP handle.
+/// \param[in]  portCount Number of ports, up to NUM_PHYSICAL_PORTS_MAX.
+/// \param[in]  portIds The identifiers of the ports.
+/// \param[out] portStatus receives the status of each port.
+/// \param[out] portResults receives the result for each port.
+/// \return     HDCP_STATUS_SUCCESSFUL if successful for every port
+/// \return     HDCP_STATUS_ERROR_INVALID_PARAMETER
+///             if HDCPContext or an array is NULL, or portCount is out of
+///             range.
+/// \return     The result of the first port that failed otherwise.
+////////////////////////////////////////////////////////////////////////////////
+HDCP_STATUS HDCPGetStatusBatch(
+                    const uint32_t hdcpHandle,
+                    const uint32_t portCount,
+                    const uint32_t *portIds,
+                    PORT_STATUS *portStatus,
+                    HDCP_STATUS *portResults);
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief      Wait until the status of the specified port matches.
+/// \par        Details:
+/// \li         Returns as soon as the bits of the port status selected by
+///             statusMask are equal to those of status, e.g. statusMask and
+///             status PORT_STATUS_HDCP_TYPE1_ENABLED to wait for the port to be
+///             enabled for type 1 content, or statusMask
+///             PORT_STATUS_CONNECTED and status PORT_STATUS_DISCONNECTED to
+///             wait for an unplug.
+/// \li         The daemon answers on the transition itself, there is no need
+///             to poll HDCPGetStatus.
+/// \li         Other requests of the same session wait for this one to return.
+///
+/// \param[in]  hdcpHandle The HDCP handle.
+/// \param[in]  portId The identifier of the port.
+/// \param[in]  statusMask PORT_STATUS bits to compare.
+/// \param[in]  status Awaited value of those bits.
+/// \param[in]  timeoutMs Time to wait at most, in milliseconds.
+/// \param[out] portStatus receives the last port status.
+/// \return     HDCP_STATUS_SUCCESSFUL if the status matches
+/// \return     HDCP_STATUS_ERROR_TIMEOUT if it did not match in time, the
+///             last status is still returned.
+/// \return     HDCP_STATUS_ERROR_INVALID_PARAMETER
+///             if HDCPContext or portStatus are NULL, or portId out of range.
+/// \return     HDCP_STATUS_ERROR_NO_DISPLAY if there is no such port.
+/// \return     HDCP_STATUS_ERROR_INTERNAL for any other error.
+////////////////////////////////////////////////////////////////////////////////
+HDCP_STATUS HDCPWaitForStatus(
+                    const uint32_t hdcpHandle,
+                    const uint32_t portId,
+                    const PORT_STATUS statusMask,
+                    const PORT_STATUS status,
+                    const uint32_t timeoutMs,
+                    PORT_STATUS *portStatus);
+
 ////////////////////////////////////////////////////////////////////////////////
 /// \brief      Get the ksv list of connected/enabled HDCP devices
 ///             in the topology by big endian format
@@ -299,6 +399,9 @@ HDCP_STATUS HDCPGetStatus(
 ///             if HDCPContext or portStatus are NULL, or portId out of range.
 /// \return     HDCP_STATUS_ERROR_MAX_DEVICES_EXCEEDED
 ///             more than 127 downstream devices are attached.
+/// \return     HDCP_STATUS_ERROR_REVOKED_DEVICE
+///             the SRM revokes a device of the topology, the outputs are
+///             still filled in.
 /// \return     HDCP_STATUS_ERROR_INTERNAL for any other error.
 ////////////////////////////////////////////////////////////////////////////////
 HDCP_STATUS HDCPGetKsvList(
@@ -357,6 +460,35 @@ HDCP_STATUS HDCPGetSRMVersion(const uint32_t hdcpHandle, uint16_t *version);
 ////////////////////////////////////////////////////////////////////////////////
 HDCP_STATUS HDCPConfig(const uint32_t hdcpHandle, HDCP_CONFIG Config);
 
+////////////////////////////////////////////////////////////////////////////////
+/// \brief      Get a file descriptor to poll for the events of a session.
+/// \par        Details:
+/// \li         The fd becomes readable when events are pending for the
+///             session, so it can be added to the app's own event loop.
+/// \li         From the first call on, the callback function is no longer
+///             executed on a thread of the SDK. The app calls
+///             HDCPDispatchEvents once the fd is readable instead.
+/// \li         Every call returns the same fd. It belongs to the session and
+///             is closed by HDCPDestroy, the app must not close it.
+///
+/// \param[in]  hdcpHandle The HDCP handle.
+/// \param[out] pEventFd receives the file descriptor.
+/// \return     HDCP_STATUS_SUCCESSFUL if successful
+/// \return     HDCP_STATUS_ERROR_INVALID_PARAMETER if pEventFd is NULL.
+/// \return     HDCP_STATUS_ERROR_INTERNAL for any other error.
+////////////////////////////////////////////////////////////////////////////////
+HDCP_STATUS HDCPGetEventFd(const uint32_t hdcpHandle, int32_t *pEventFd);
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief      Execute the callback function for the pending events of a
+///             session on the calling thread.
+///
+/// \param[in]  hdcpHandle The HDCP handle.
+/// \return     HDCP_STATUS_SUCCESSFUL if successful, also without any event.
+/// \return     HDCP_STATUS_ERROR_INTERNAL for any other error.
+////////////////////////////////////////////////////////////////////////////////
+HDCP_STATUS HDCPDispatchEvents(const uint32_t hdcpHandle);
+
 #ifdef __cplusplus
 }
 #endif  // __cplusplus
@@ -29,6 +29,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <sys/eventfd.h>
 
 #include "session.h"
 #include "hdcpdef.h"
@@ -48,7 +49,11 @@ HdcpSession::HdcpSession(
     m_Handle(handle),
     m_Context(ctx),    
     m_IsValid(true),
-    m_ActiveReferences(0)
+    m_IsKnownToDaemon(false),
+    m_IsResponseReady(false),
+    m_IsDisconnected(false),
+    m_KsvList(nullptr),
+    m_EventFd(-1)
 {
     HDCP_FUNCTION_ENTER;
 
@@ -59,9 +64,10 @@ HdcpSession::HdcpSession(
     }
 #endif
 
-    if ((SUCCESS != pthread_mutex_init(&m_ReferenceMutex, nullptr)) ||
-        (SUCCESS != pthread_cond_init(&m_ReferenceCV, nullptr))     ||
-        (SUCCESS != pthread_mutex_init(&m_SocketMutex, nullptr)))
+    if ((SUCCESS != pthread_mutex_init(&m_SocketMutex, nullptr))      ||
+        (SUCCESS != pthread_mutex_init(&m_ResponseMutex, nullptr))    ||
+        (SUCCESS != pthread_cond_init(&m_ResponseCV, nullptr))        ||
+        (SUCCESS != pthread_mutex_init(&m_EventMutex, nullptr)))
     {
         m_IsValid = false;
     }
@@ -74,97 +80,328 @@ HdcpSession::~HdcpSession()
 {
     HDCP_FUNCTION_ENTER;
 
-    ACQUIRE_LOCK(&m_ReferenceMutex);
-    if (m_ActiveReferences > 0)
+    DESTROY_LOCK(&m_SocketMutex);
+    DESTROY_LOCK(&m_ResponseMutex);
+    DESTROY_CV(&m_ResponseCV);
+    DESTROY_LOCK(&m_EventMutex);
+
+    if ((0 <= m_EventFd) && (ERROR == close(m_EventFd)))
     {
-        WAIT_CV(&m_ReferenceCV, &m_ReferenceMutex);
+        HDCP_ASSERTMESSAGE(
+                "Failed to close event fd! Err: %s",
+                strerror(errno));
     }
-    RELEASE_LOCK(&m_ReferenceMutex);
 
-    DESTROY_LOCK(&m_ReferenceMutex);
-    DESTROY_CV(&m_ReferenceCV);
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
 
-    DESTROY_LOCK(&m_SocketMutex);
+HDCP_STATUS HdcpSession::Create(void)
+{
+    HDCP_FUNCTION_ENTER;
+
+    // Connect to the daemon socket
+    int32_t sts = HdcpSessionManager::Connect();
+    if (SUCCESS != sts)
+    {
+        HDCP_ASSERTMESSAGE("Failed to connect to daemon socket!");
+        return HDCP_STATUS_ERROR_MSG_TRANSACTION;
+    }
+
+    HDCP_FUNCTION_EXIT(HDCP_STATUS_SUCCESSFUL);
+    return HDCP_STATUS_SUCCESSFUL;
+}
+
+void HdcpSession::Destroy(void)
+{
+    HDCP_FUNCTION_ENTER;
+
+    if (!m_IsKnownToDaemon)
+    {
+        return;
+    }
+
+    SocketData  data;
+
+    data.Size       = sizeof(SocketData);
+    data.Command    = HDCP_API_DESTROY;
+    data.SessionId  = m_Handle;
+
+    // Without a connection the daemon has already released everything
+    LocalClientSocket *socket = HdcpSessionManager::AcquireSocket();
+    if (nullptr == socket)
+    {
+        return;
+    }
+
+    if (SUCCESS != socket->SendMessage(data))
+    {
+        HDCP_ASSERTMESSAGE("Failed to send destroy request to daemon!");
+    }
+
+    HdcpSessionManager::ReleaseSocket();
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
+
+void HdcpSession::DeliverResponse(const SocketData& rsp)
+{
+    HDCP_FUNCTION_ENTER;
+
+    ACQUIRE_LOCK(&m_ResponseMutex);
+    m_Response          = rsp;
+    m_IsResponseReady   = true;
+    pthread_cond_signal(&m_ResponseCV);
+    RELEASE_LOCK(&m_ResponseMutex);
 
     HDCP_FUNCTION_EXIT(SUCCESS);
 }
 
-void HdcpSession::IncreaseReference(void)
+void HdcpSession::Disconnect(void)
 {
     HDCP_FUNCTION_ENTER;
 
-    ACQUIRE_LOCK(&m_ReferenceMutex);
-    ++m_ActiveReferences;
-    RELEASE_LOCK(&m_ReferenceMutex);
+    ACQUIRE_LOCK(&m_ResponseMutex);
+    m_IsDisconnected = true;
+    pthread_cond_signal(&m_ResponseCV);
+    RELEASE_LOCK(&m_ResponseMutex);
 
     HDCP_FUNCTION_EXIT(SUCCESS);
 }
 
-void HdcpSession::DecreaseReference(void)
+bool HdcpSession::QueueEvent(const uint32_t portId, const PORT_EVENT event)
 {
     HDCP_FUNCTION_ENTER;
 
-    ACQUIRE_LOCK(&m_ReferenceMutex);
-    --m_ActiveReferences;
+    ACQUIRE_LOCK(&m_EventMutex);
+
+    if (m_Events.size() >= SESSION_EVENT_MAX)
+    {
+        HDCP_WARNMESSAGE("Session 0x%x dropped an event", m_Handle);
+        m_Events.pop_front();
+    }
+    m_Events.push_back({portId, event});
+
+    bool isCallBackEvent = (0 > m_EventFd);
+    if (!isCallBackEvent)
+    {
+        // Only fails once the counter would overflow, it is readable then
+        uint64_t count = 1;
+        if (ERROR == write(m_EventFd, &count, sizeof(count)))
+        {
+            HDCP_WARNMESSAGE(
+                    "Failed to signal event fd! Err: %s",
+                    strerror(errno));
+        }
+    }
+
+    RELEASE_LOCK(&m_EventMutex);
+
+    HDCP_FUNCTION_EXIT(isCallBackEvent);
+    return isCallBackEvent;
+}
+
+void HdcpSession::DispatchEvents(const bool isCallBackThread)
+{
+    HDCP_FUNCTION_ENTER;
+
+    std::deque<HdcpEvent> events;
+
+    // Don't hold the lock while calling out, the app may take long
+    ACQUIRE_LOCK(&m_EventMutex);
+
+    if (0 <= m_EventFd)
+    {
+        if (isCallBackThread)
+        {
+            RELEASE_LOCK(&m_EventMutex);
+            return;
+        }
+
+        // Everything queued so far is dispatched below, so the fd must stop
+        // being readable. It is non-blocking, EAGAIN just means no events.
+        uint64_t count = 0;
+        if ((ERROR == read(m_EventFd, &count, sizeof(count))) &&
+            (EAGAIN != errno))
+        {
+            HDCP_WARNMESSAGE(
+                    "Failed to reset event fd! Err: %s",
+                    strerror(errno));
+        }
+    }
+
+    events.swap(m_Events);
+    RELEASE_LOCK(&m_EventMutex);
 
-    if (m_ActiveReferences == 0)
+    if (nullptr == m_CallBack)
     {
-        pthread_cond_signal(&m_ReferenceCV);
+        return;
+    }
+
+    for (auto& entry : events)
+    {
+        m_CallBack(m_Handle, entry.portId, entry.event, m_Context);
     }
-    RELEASE_LOCK(&m_ReferenceMutex);
 
     HDCP_FUNCTION_EXIT(SUCCESS);
 }
 
-HDCP_STATUS HdcpSession::Create(void)
+HDCP_STATUS HdcpSession::GetEventFd(int32_t *eventFd)
 {
     HDCP_FUNCTION_ENTER;
 
-    // Connect to the daemon socket
-    ACQUIRE_LOCK(&m_SocketMutex);
-    int32_t sts = m_SdkSocket.Connect(HDCP_SDK_SOCKET_PATH);
-    RELEASE_LOCK(&m_SocketMutex);
+    CHECK_PARAM_NULL(eventFd, HDCP_STATUS_ERROR_INVALID_PARAMETER);
 
-    if (SUCCESS != sts)
+    ACQUIRE_LOCK(&m_EventMutex);
+
+    if (0 > m_EventFd)
     {
-        HDCP_ASSERTMESSAGE("Failed to connect to daemon socket!");
-        return HDCP_STATUS_ERROR_MSG_TRANSACTION;
+        m_EventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (0 > m_EventFd)
+        {
+            RELEASE_LOCK(&m_EventMutex);
+            HDCP_ASSERTMESSAGE(
+                    "Failed to create event fd! Err: %s",
+                    strerror(errno));
+            return HDCP_STATUS_ERROR_INTERNAL;
+        }
+
+        // Events the callback thread did not get to yet are the app's now
+        if (!m_Events.empty())
+        {
+            uint64_t count = 1;
+            if (ERROR == write(m_EventFd, &count, sizeof(count)))
+            {
+                HDCP_WARNMESSAGE(
+                        "Failed to signal event fd! Err: %s",
+                        strerror(errno));
+            }
+        }
     }
 
+    *eventFd = m_EventFd;
+
+    RELEASE_LOCK(&m_EventMutex);
+
     HDCP_FUNCTION_EXIT(HDCP_STATUS_SUCCESSFUL);
     return HDCP_STATUS_SUCCESSFUL;
 }
 
-HDCP_STATUS HdcpSession::PerformMessageTransaction(SocketData &data)
+uint8_t *HdcpSession::GetKsvListBuffer(void)
 {
     HDCP_FUNCTION_ENTER;
 
-    // Send the request to daemon
-    int32_t sts = m_SdkSocket.SendMessage(data);
+    ACQUIRE_LOCK(&m_ResponseMutex);
+    uint8_t *ksvList = m_KsvList;
+    RELEASE_LOCK(&m_ResponseMutex);
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return ksvList;
+}
+
+HDCP_STATUS HdcpSession::SendRequest(
+                            LocalClientSocket& socket,
+                            SocketData& data)
+{
+    return SendRequest(socket, data, nullptr);
+}
+
+HDCP_STATUS HdcpSession::SendRequest(
+                            LocalClientSocket& socket,
+                            SocketData& data,
+                            const uint8_t *srmData)
+{
+    HDCP_FUNCTION_ENTER;
+
+    data.SessionId      = m_Handle;
+    m_IsKnownToDaemon   = true;
+
+    ACQUIRE_LOCK(&m_ResponseMutex);
+    m_IsResponseReady = false;
+    RELEASE_LOCK(&m_ResponseMutex);
+
+    int32_t sts = (nullptr == srmData) ?
+                    socket.SendMessage(data) :
+                    socket.SendSrmData(
+                                data,
+                                srmData,
+                                data.SrmOrKsvListDataSz);
     if (SUCCESS != sts)
     {
         HDCP_ASSERTMESSAGE("Failed to send request to daemon!");
         return HDCP_STATUS_ERROR_MSG_TRANSACTION;
     }
 
-    // Get reply from daemon
-    sts = m_SdkSocket.GetMessage(data);
-    if (SUCCESS != sts)
+    HDCP_FUNCTION_EXIT(HDCP_STATUS_SUCCESSFUL);
+    return HDCP_STATUS_SUCCESSFUL;
+}
+
+HDCP_STATUS HdcpSession::WaitResponse(SocketData& data)
+{
+    HDCP_FUNCTION_ENTER;
+
+    ACQUIRE_LOCK(&m_ResponseMutex);
+
+    while (!m_IsResponseReady && !m_IsDisconnected)
     {
+        WAIT_CV(&m_ResponseCV, &m_ResponseMutex);
+    }
+
+    if (!m_IsResponseReady)
+    {
+        RELEASE_LOCK(&m_ResponseMutex);
         HDCP_ASSERTMESSAGE("Failed to get response from daemon!");
         return HDCP_STATUS_ERROR_MSG_TRANSACTION;
     }
 
+    data                = m_Response;
+    m_IsResponseReady   = false;
+
+    RELEASE_LOCK(&m_ResponseMutex);
+
     HDCP_FUNCTION_EXIT(data.Status);
     return data.Status;
 }
 
+HDCP_STATUS HdcpSession::PerformMessageTransaction(SocketData &data)
+{
+    HDCP_FUNCTION_ENTER;
+
+    LocalClientSocket *socket = HdcpSessionManager::AcquireSocket();
+    if (nullptr == socket)
+    {
+        HDCP_ASSERTMESSAGE("Not connected to daemon!");
+        return HDCP_STATUS_ERROR_MSG_TRANSACTION;
+    }
+
+    // Send the request to daemon
+    HDCP_STATUS ret = SendRequest(*socket, data);
+    HdcpSessionManager::ReleaseSocket();
+
+    if (HDCP_STATUS_SUCCESSFUL != ret)
+    {
+        return ret;
+    }
+
+    // Get reply from daemon
+    ret = WaitResponse(data);
+
+    HDCP_FUNCTION_EXIT(ret);
+    return ret;
+}
+
 HDCP_STATUS HdcpSession::EnumerateDisplay(PortList *portList)
 {
     HDCP_FUNCTION_ENTER;
 
     CHECK_PARAM_NULL(portList, HDCP_STATUS_ERROR_INVALID_PARAMETER);
 
+    // No need to ask the daemon as long as it reported no change since
+    if (HdcpSessionManager::GetCachedPortList(portList))
+    {
+        HDCP_FUNCTION_EXIT(HDCP_STATUS_SUCCESSFUL);
+        return HDCP_STATUS_SUCCESSFUL;
+    }
+
     SocketData  data;
 
     data.Size       = sizeof(SocketData);
@@ -230,6 +467,70 @@ HDCP_STATUS HdcpSession::SetProtectionLevel(
     return HDCP_STATUS_SUCCESSFUL;
 }
 
+HDCP_STATUS HdcpSession::SetProtectionLevelBatch(
+                            const uint32_t portCount,
+                            const uint32_t *portIds,
+                            const HDCP_LEVEL *levels,
+                            HDCP_STATUS *portResults)
+{
+    HDCP_FUNCTION_ENTER;
+
+    SocketData  data;
+
+    data.Size           = sizeof(SocketData);
+    data.Command        = HDCP_API_SET_PROTECTION_LEVEL_BATCH;
+    data.PortCount      = portCount;
+    for (uint32_t i = 0; i < portCount; ++i)
+    {
+        data.Ports[i].Id    = portIds[i];
+        data.Levels[i]      = levels[i];
+    }
+
+    ACQUIRE_LOCK(&m_SocketMutex);
+    HDCP_STATUS ret = PerformMessageTransaction(data);
+    RELEASE_LOCK(&m_SocketMutex);
+
+    if (HDCP_STATUS_ERROR_MSG_TRANSACTION == ret)
+    {
+        HDCP_ASSERTMESSAGE("Message transactions failed!");
+        for (uint32_t i = 0; i < portCount; ++i)
+        {
+            portResults[i] = ret;
+        }
+        return ret;
+    }
+
+    // Like SetProtectionLevel, don't leave the ports that failed to enable
+    // half way there, in one more request for all of them
+    SocketData  rollback;
+
+    rollback.Size       = sizeof(SocketData);
+    rollback.Command    = HDCP_API_SET_PROTECTION_LEVEL_BATCH;
+    for (uint32_t i = 0; i < portCount; ++i)
+    {
+        portResults[i] = data.PortResults[i];
+
+        if ((HDCP_STATUS_SUCCESSFUL != portResults[i])          &&
+            (HDCP_STATUS_ERROR_INVALID_PARAMETER != portResults[i]) &&
+            (HDCP_LEVEL0 != levels[i]))
+        {
+            rollback.Ports[rollback.PortCount].Id   = portIds[i];
+            rollback.Levels[rollback.PortCount]     = HDCP_LEVEL0;
+            ++rollback.PortCount;
+        }
+    }
+
+    if (rollback.PortCount > 0)
+    {
+        ACQUIRE_LOCK(&m_SocketMutex);
+        PerformMessageTransaction(rollback);
+        RELEASE_LOCK(&m_SocketMutex);
+    }
+
+    HDCP_FUNCTION_EXIT(ret);
+    return ret;
+}
+
 HDCP_STATUS HdcpSession::GetStatus(
                             const uint32_t portId,
                             PORT_STATUS *portStatus)
@@ -238,6 +539,13 @@ HDCP_STATUS HdcpSession::GetStatus(
 
     CHECK_PARAM_NULL(portStatus, HDCP_STATUS_ERROR_INVALID_PARAMETER);
 
+    // No need to ask the daemon as long as it reported no change since
+    if (HdcpSessionManager::GetCachedStatus(portId, portStatus))
+    {
+        HDCP_FUNCTION_EXIT(HDCP_STATUS_SUCCESSFUL);
+        return HDCP_STATUS_SUCCESSFUL;
+    }
+
     SocketData  data;
 
     data.Size           = sizeof(SocketData);
@@ -264,6 +572,108 @@ HDCP_STATUS HdcpSession::GetStatus(
     return HDCP_STATUS_SUCCESSFUL;
 }
 
+HDCP_STATUS HdcpSession::GetStatusBatch(
+                            const uint32_t portCount,
+                            const uint32_t *portIds,
+                            PORT_STATUS *portStatus,
+                            HDCP_STATUS *portResults)
+{
+    HDCP_FUNCTION_ENTER;
+
+    // No need to ask the daemon if it reported no change for any of them
+    uint32_t cachedCount = 0;
+    while ((cachedCount < portCount) &&
+        HdcpSessionManager::GetCachedStatus(
+                                    portIds[cachedCount],
+                                    &portStatus[cachedCount]))
+    {
+        portResults[cachedCount] = HDCP_STATUS_SUCCESSFUL;
+        ++cachedCount;
+    }
+
+    if (portCount == cachedCount)
+    {
+        HDCP_FUNCTION_EXIT(HDCP_STATUS_SUCCESSFUL);
+        return HDCP_STATUS_SUCCESSFUL;
+    }
+
+    SocketData  data;
+
+    data.Size           = sizeof(SocketData);
+    data.Command        = HDCP_API_GETSTATUS_BATCH;
+    data.PortCount      = portCount;
+    for (uint32_t i = 0; i < portCount; ++i)
+    {
+        data.Ports[i].Id = portIds[i];
+    }
+
+    ACQUIRE_LOCK(&m_SocketMutex);
+    HDCP_STATUS ret = PerformMessageTransaction(data);
+    RELEASE_LOCK(&m_SocketMutex);
+
+    for (uint32_t i = 0; i < portCount; ++i)
+    {
+        portResults[i] = (HDCP_STATUS_ERROR_MSG_TRANSACTION == ret) ?
+                            ret :
+                            data.PortResults[i];
+        portStatus[i]  = data.Ports[i].status;
+    }
+
+    if (HDCP_STATUS_SUCCESSFUL != ret)
+    {
+        HDCP_ASSERTMESSAGE("Message transactions failed!");
+    }
+
+    HDCP_FUNCTION_EXIT(ret);
+    return ret;
+}
+
+HDCP_STATUS HdcpSession::WaitForStatus(
+                            const uint32_t portId,
+                            const PORT_STATUS statusMask,
+                            const PORT_STATUS status,
+                            const uint32_t timeoutMs,
+                            PORT_STATUS *portStatus)
+{
+    HDCP_FUNCTION_ENTER;
+
+    CHECK_PARAM_NULL(portStatus, HDCP_STATUS_ERROR_INVALID_PARAMETER);
+
+    // Nothing to wait for if the status known to be current already matches
+    if (HdcpSessionManager::GetCachedStatus(portId, portStatus) &&
+        (0 == ((*portStatus ^ status) & statusMask)))
+    {
+        HDCP_FUNCTION_EXIT(HDCP_STATUS_SUCCESSFUL);
+        return HDCP_STATUS_SUCCESSFUL;
+    }
+
+    SocketData  data;
+
+    data.Size               = sizeof(SocketData);
+    data.Command            = HDCP_API_WAIT_STATUS;
+    data.PortCount          = 1;
+    data.SinglePort.Id      = portId;
+    data.SinglePort.status  = status;
+    data.StatusMask         = statusMask;
+    data.TimeoutMs          = timeoutMs;
+
+    ACQUIRE_LOCK(&m_SocketMutex);
+    HDCP_STATUS ret = PerformMessageTransaction(data);
+    RELEASE_LOCK(&m_SocketMutex);
+
+    // The last status comes along with a timeout as well
+    if ((HDCP_STATUS_SUCCESSFUL != ret) && (HDCP_STATUS_ERROR_TIMEOUT != ret))
+    {
+        HDCP_ASSERTMESSAGE("Message transactions failed!");
+        return ret;
+    }
+
+    *portStatus = data.SinglePort.status;
+
+    HDCP_FUNCTION_EXIT(ret);
+    return ret;
+}
+
 HDCP_STATUS HdcpSession::GetKsvList(
                             const uint32_t portId,
                             uint8_t *ksvCount,
@@ -291,10 +701,21 @@ HDCP_STATUS HdcpSession::GetKsvList(
     
     ACQUIRE_LOCK(&m_SocketMutex);
 
+    // The receive thread fills in the KSV LIST that follows the response
+    ACQUIRE_LOCK(&m_ResponseMutex);
+    m_KsvList = ksvList;
+    RELEASE_LOCK(&m_ResponseMutex);
+
     HDCP_STATUS ret = PerformMessageTransaction(data);
+
+    ACQUIRE_LOCK(&m_ResponseMutex);
+    m_KsvList = nullptr;
+    RELEASE_LOCK(&m_ResponseMutex);
+
+    RELEASE_LOCK(&m_SocketMutex);
+
     if (HDCP_STATUS_SUCCESSFUL != ret)
     {
-        RELEASE_LOCK(&m_SocketMutex);
         HDCP_ASSERTMESSAGE("Message transactions failed!");
         return ret;
     }
@@ -302,17 +723,14 @@ HDCP_STATUS HdcpSession::GetKsvList(
     *depth = data.Depth;
     *ksvCount = data.KsvCount;
 
-    // Receive the KSV LIST from the daemon
-    int32_t sts = m_SdkSocket.ReceiveKsvList(ksvList, data.KsvCount);
-    if (SUCCESS != sts)
+    if (data.RevokedKsvCount > 0)
     {
-        RELEASE_LOCK(&m_SocketMutex);
-        HDCP_ASSERTMESSAGE("Failed to receive ksv list from daemon!");
-        return HDCP_STATUS_ERROR_MSG_TRANSACTION;
+        HDCP_WARNMESSAGE(
+                    "%d devices of the topology are revoked",
+                    data.RevokedKsvCount);
+        return HDCP_STATUS_ERROR_REVOKED_DEVICE;
     }
 
-    RELEASE_LOCK(&m_SocketMutex);
-
     HDCP_FUNCTION_EXIT(HDCP_STATUS_SUCCESSFUL);
     return HDCP_STATUS_SUCCESSFUL;
 }
@@ -325,40 +743,51 @@ HDCP_STATUS HdcpSession::SendSRMData(
 
     CHECK_PARAM_NULL(pSrmData, HDCP_STATUS_ERROR_INVALID_PARAMETER);
 
+    // The daemon would have to drop the connection, it can't skip past
+    // SRM data larger than that
+    if (srmSize > MAX_SRM_DATA_SZ)
+    {
+        HDCP_ASSERTMESSAGE("SRM message size %d is too large!", srmSize);
+        return HDCP_STATUS_ERROR_INVALID_PARAMETER;
+    }
+
     SocketData  data;
 
     data.Size               = sizeof(SocketData);
-    data.Command            = HDCP_API_SENDSRMDATA;
+    data.Command            = HDCP_API_SENDSRMDATA_STREAM;
     data.SrmOrKsvListDataSz = srmSize;
 
     ACQUIRE_LOCK(&m_SocketMutex);
 
-    HDCP_STATUS ret = PerformMessageTransaction(data);
-    if (HDCP_STATUS_SUCCESSFUL != ret)
+    LocalClientSocket *socket = HdcpSessionManager::AcquireSocket();
+    if (nullptr == socket)
     {
         RELEASE_LOCK(&m_SocketMutex);
-        HDCP_ASSERTMESSAGE("Message transactions failed!");
-        return ret;
+        HDCP_ASSERTMESSAGE("Not connected to daemon!");
+        return HDCP_STATUS_ERROR_MSG_TRANSACTION;
     }
 
-    // Send SRM data to daemon
-    int32_t sts = m_SdkSocket.SendSrmData(pSrmData, srmSize);
-    if (SUCCESS != sts)
+    // Size and SRM data go out together, so there is no acknowledgement of
+    // the size to wait for
+    HDCP_STATUS ret = SendRequest(*socket, data, pSrmData);
+    HdcpSessionManager::ReleaseSocket();
+
+    if (HDCP_STATUS_SUCCESSFUL != ret)
     {
         RELEASE_LOCK(&m_SocketMutex);
         HDCP_ASSERTMESSAGE("Failed to send SRM data to daemon!");
-        return HDCP_STATUS_ERROR_MSG_TRANSACTION;
+        return ret;
     }
 
     // Get reply from daemon
-    sts = m_SdkSocket.GetMessage(data);
-    if (SUCCESS != sts)
+    ret = WaitResponse(data);
+    if (HDCP_STATUS_ERROR_MSG_TRANSACTION == ret)
     {
         RELEASE_LOCK(&m_SocketMutex);
         HDCP_ASSERTMESSAGE("Failed to get response from daemon!");
-        return HDCP_STATUS_ERROR_MSG_TRANSACTION;
+        return ret;
     }
-   
+
     RELEASE_LOCK(&m_SocketMutex);
 
     if (SUCCESS != data.Status)
@@ -415,6 +844,12 @@ HDCP_STATUS HdcpSession::Config(const HDCP_CONFIG config)
         case SRM_STORAGE_CONFIG:
             data.Config.disableSrmStorage = config.disableSrmStorage;
             break;
+        case AUTO_REAUTH_CONFIG:
+            data.Config.enableAutoReauth = config.enableAutoReauth;
+            break;
+        case DISABLE_LINGER_CONFIG:
+            data.Config.disableLingerMs = config.disableLingerMs;
+            break;
         default:
             HDCP_ASSERTMESSAGE("Input config type is invalid!");
             return HDCP_STATUS_ERROR_INVALID_PARAMETER;
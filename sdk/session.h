@@ -28,6 +28,7 @@
 #define __HDCP_SESSION_H__
 
 #include <string>
+#include <deque>
 #include <pthread.h>
 
 #include "hdcpdef.h"
@@ -37,6 +38,15 @@
 
 #define SOCKET_NAME_RETRY_MAX   10
 
+// Events a session keeps until they are dispatched, the oldest are dropped
+#define SESSION_EVENT_MAX       64
+
+typedef struct _HdcpEvent
+{
+    uint32_t    portId;
+    PORT_EVENT  event;
+} HdcpEvent;
+
 class HdcpSession
 {
 public:
@@ -55,10 +65,8 @@ public:
     ///
     /// \return     Nothing
     ///
-    /// Attempts to delete the session will be blocked in the destructor if
-    /// there are still active references on the Session. When the number of
-    /// active references falls to 0, the destructor get's signalled to
-    /// proceed.
+    /// The session manager only deletes a session once its last reference
+    /// has been released, so no call can still be using it.
     //////////////////////////////////////////////////////////////////////////
     ~HdcpSession();
 
@@ -70,36 +78,86 @@ public:
     bool IsValid(void) {return m_IsValid;}
 
     //////////////////////////////////////////////////////////////////////////
-    /// \brief      Synchronously increase the number of active references.
+    /// \brief  Make sure the process is connected to the daemon
+    ///
+    /// \return     HDCP_STATUS_SUCCESSFUL
+    ///             HDCP_STATUS_ERROR_MSG_TRANSACTION
+    ///
+    /// The connection is shared by all sessions of the process, so this only
+    /// connects for the first session.
+    //////////////////////////////////////////////////////////////////////////
+    HDCP_STATUS Create(void);
+
+    //////////////////////////////////////////////////////////////////////////
+    /// \brief  Let the daemon release what the session held
+    ///
+    /// \return     Nothing
+    ///
+    /// Called by the session manager once the last reference is gone. There
+    /// is no response, and nothing to do for a session that never sent a
+    /// request.
+    //////////////////////////////////////////////////////////////////////////
+    void Destroy(void);
+
+    //////////////////////////////////////////////////////////////////////////
+    /// \brief  Hand over the response to the request the session sent
+    ///
+    /// \param[in]  rsp     Response received on the connection
+    /// \return     Nothing
+    //////////////////////////////////////////////////////////////////////////
+    void DeliverResponse(const SocketData& rsp);
+
+    //////////////////////////////////////////////////////////////////////////
+    /// \brief  Fail the request in flight and any later one, the connection
+    ///         is gone
     ///
     /// \return     Nothing
     //////////////////////////////////////////////////////////////////////////
-    void IncreaseReference(void);
+    void Disconnect(void);
 
     //////////////////////////////////////////////////////////////////////////
-    /// \brief      Synchronously decrease the number of active references.
-    ///             Active references will block destruction of the session,
-    ///             and once all references are released, a thread attempting
-    ///             destruction will be allowed to proceed.
+    /// \brief  Keep an event for the session until it is dispatched
     ///
+    /// \param[in]  portId  Port on which the event has occurred
+    /// \param[in]  event   Event reported by the daemon
+    /// \return     true if the callback thread has to dispatch it, false if
+    ///             the app was signalled through the event fd
+    //////////////////////////////////////////////////////////////////////////
+    bool QueueEvent(const uint32_t portId, const PORT_EVENT event);
+
+    //////////////////////////////////////////////////////////////////////////
+    /// \brief  Execute the callback function for each queued event
+    ///
+    /// \param[in]  isCallBackThread    true when called by the callback
+    ///                                 thread, which leaves the events of a
+    ///                                 session with an event fd to the app
     /// \return     Nothing
+    ///
+    /// Runs on the caller's thread, so the callback function may call the
+    /// API again.
     //////////////////////////////////////////////////////////////////////////
-    void DecreaseReference(void);
+    void DispatchEvents(const bool isCallBackThread);
 
     //////////////////////////////////////////////////////////////////////////
-    /// \brief  Open a new connection with the daemon's main socket
+    /// \brief  Get the fd signalling the events of the session
     ///
+    /// \param[out] eventFd     fd readable while events are queued
     /// \return     HDCP_STATUS_SUCCESSFUL
     ///             HDCP_STATUS_ERROR_INVALID_PARAMETER
     ///             HDCP_STATUS_ERROR_INTERNAL
-    ///             HDCP_STATUS_ERROR_INSUFFICIENT_MEMORY
     ///
-    /// Note, there is no corresponding Destroy call within the Session module
-    /// because closing the socket (which is done when session's socket gets
-    /// closed in the destructor) will create an event for the Daemon's main
-    /// socket to operate on.
+    /// The fd is created on the first call and from then on the app
+    /// dispatches the events of the session itself.
     //////////////////////////////////////////////////////////////////////////
-    HDCP_STATUS Create(void);
+    HDCP_STATUS GetEventFd(int32_t *eventFd);
+
+    //////////////////////////////////////////////////////////////////////////
+    /// \brief  Get the buffer to receive the ksv list of a response into
+    ///
+    /// \return     Buffer for MAX_KSV_COUNT ksvs, or nullptr if the session
+    ///             is not waiting for a ksv list
+    //////////////////////////////////////////////////////////////////////////
+    uint8_t *GetKsvListBuffer(void);
 
     //////////////////////////////////////////////////////////////////////////
     /// \brief  Get the ports' connection statuses
@@ -126,6 +184,23 @@ public:
     //////////////////////////////////////////////////////////////////////////
     HDCP_STATUS SetProtectionLevel(const uint32_t portId, HDCP_LEVEL level);
 
+    //////////////////////////////////////////////////////////////////////////
+    /// \brief  Enable/Disable HDCP on several ports in one request
+    ///
+    /// \param[in]  portCount   Number of ports
+    /// \param[in]  portIds     Id of each port
+    /// \param[in]  levels      Level for each port
+    /// \param[out] portResults Result for each port, the status of the
+    ///                         whole request if it failed as such
+    /// \return     HDCP_STATUS_SUCCESSFUL
+    ///             Result of the first port that failed otherwise
+    //////////////////////////////////////////////////////////////////////////
+    HDCP_STATUS SetProtectionLevelBatch(
+                        const uint32_t portCount,
+                        const uint32_t *portIds,
+                        const HDCP_LEVEL *levels,
+                        HDCP_STATUS *portResults);
+
     //////////////////////////////////////////////////////////////////////////
     /// \brief  Get the port connection and encryption status
     ///
@@ -138,6 +213,49 @@ public:
     //////////////////////////////////////////////////////////////////////////
     HDCP_STATUS GetStatus(const uint32_t portId, PORT_STATUS *portStatus);
 
+    //////////////////////////////////////////////////////////////////////////
+    /// \brief  Get the status of several ports in one request
+    ///
+    /// \param[in]  portCount   Number of ports
+    /// \param[in]  portIds     Id of each port
+    /// \param[out] portStatus  PORT_STATUS bitfield of each port
+    /// \param[out] portResults Result for each port, the status of the
+    ///                         whole request if it failed as such
+    /// \return     HDCP_STATUS_SUCCESSFUL
+    ///             Result of the first port that failed otherwise
+    ///
+    /// Does not ask the daemon if all the ports are cached.
+    //////////////////////////////////////////////////////////////////////////
+    HDCP_STATUS GetStatusBatch(
+                        const uint32_t portCount,
+                        const uint32_t *portIds,
+                        PORT_STATUS *portStatus,
+                        HDCP_STATUS *portResults);
+
+    //////////////////////////////////////////////////////////////////////////
+    /// \brief  Wait until the status of a port matches
+    ///
+    /// \param[in]  PortId      Id of the desired port
+    /// \param[in]  statusMask  PORT_STATUS bits to compare
+    /// \param[in]  status      Awaited value of those bits
+    /// \param[in]  timeoutMs   Time the daemon waits at most
+    /// \param[out] portStatus  Last PORT_STATUS bitfield
+    /// \return     HDCP_STATUS_SUCCESSFUL
+    ///             HDCP_STATUS_ERROR_TIMEOUT
+    ///             HDCP_STATUS_ERROR_INVALID_PARAMETER
+    ///             HDCP_STATUS_ERROR_NO_DISPLAY
+    ///             HDCP_STATUS_ERROR_INTERNAL
+    ///
+    /// A cached status that already matches is returned right away,
+    /// otherwise the daemon parks the request until the port gets there.
+    //////////////////////////////////////////////////////////////////////////
+    HDCP_STATUS WaitForStatus(
+                        const uint32_t portId,
+                        const PORT_STATUS statusMask,
+                        const PORT_STATUS status,
+                        const uint32_t timeoutMs,
+                        PORT_STATUS *portStatus);
+
     //////////////////////////////////////////////////////////////////////////
     /// \brief  Get the ksv list of connected/enabled devices in HDCP1 topology
     ///
@@ -219,18 +337,62 @@ private:
     //////////////////////////////////////////////////////////////////////////
     HDCP_STATUS PerformMessageTransaction(SocketData &data);
 
+    //////////////////////////////////////////////////////////////////////////
+    /// \brief  Tag a request with the session and send it
+    ///
+    /// \param[in]  socket  Connection acquired from the session manager
+    /// \param[in]  data    SocketData holding the request details
+    /// \return     HDCP_STATUS_SUCCESSFUL
+    ///             HDCP_STATUS_ERROR_MSG_TRANSACTION
+    //////////////////////////////////////////////////////////////////////////
+    HDCP_STATUS SendRequest(LocalClientSocket& socket, SocketData& data);
+
+    //////////////////////////////////////////////////////////////////////////
+    /// \brief  Tag a request with the session and send it, immediately
+    ///         followed by SRM data
+    ///
+    /// \param[in]  socket  Connection acquired from the session manager
+    /// \param[in]  data    SocketData holding the request details
+    /// \param[in]  srmData SRM data of data.SrmOrKsvListDataSz bytes
+    /// \return     HDCP_STATUS_SUCCESSFUL
+    ///             HDCP_STATUS_ERROR_MSG_TRANSACTION
+    //////////////////////////////////////////////////////////////////////////
+    HDCP_STATUS SendRequest(
+                        LocalClientSocket& socket,
+                        SocketData& data,
+                        const uint8_t *srmData);
+
+    //////////////////////////////////////////////////////////////////////////
+    /// \brief  Block until the response to the request sent arrives
+    ///
+    /// \param[out] data    SocketData filled with the response
+    /// \return     Status of the response, or
+    ///             HDCP_STATUS_ERROR_MSG_TRANSACTION if the connection is gone
+    //////////////////////////////////////////////////////////////////////////
+    HDCP_STATUS WaitResponse(SocketData& data);
+
     // Private member variables
-    LocalClientSocket   m_SdkSocket;
+
+    // Serializes the requests of the session, there is one response slot
     pthread_mutex_t     m_SocketMutex;
 
     CallBackFunction    m_CallBack;         // callback function pointer of app
     uint32_t            m_Handle;           // ctx handle
     void                *m_Context;          // object pointer of app
     bool                m_IsValid;
+    bool                m_IsKnownToDaemon;
+
+    // Rendezvous with the receive thread of the session manager
+    pthread_mutex_t     m_ResponseMutex;
+    pthread_cond_t      m_ResponseCV;
+    SocketData          m_Response;
+    bool                m_IsResponseReady;
+    bool                m_IsDisconnected;
+    uint8_t             *m_KsvList;
 
-    uint32_t            m_ActiveReferences;
-    pthread_mutex_t     m_ReferenceMutex;
-    pthread_cond_t      m_ReferenceCV;
+    std::deque<HdcpEvent>   m_Events;
+    int32_t                 m_EventFd;      // eventfd, -1 until the app asks
+    pthread_mutex_t         m_EventMutex;
 };
 
 #endif  // __HDCP_SESSION_H__
@@ -24,8 +24,7 @@
 //! \brief
 //!
 
-#include <forward_list>
-#include <list>
+#include <atomic>
 #include <new>
 #include <algorithm>
 #include <unistd.h>
@@ -41,190 +40,407 @@
 #include "clientsock.h"
 #include "session.h"
 
-std::forward_list<HdcpSession *> HdcpSessionManager::m_SessionList;
-std::list<HdcpSession *>         HdcpSessionManager::m_PendingDestroyQueue;
+SessionSlot         HdcpSessionManager::m_Slots[SESSION_TABLE_SIZE] = {};
+pthread_mutex_t     HdcpSessionManager::m_SlotMutex = PTHREAD_MUTEX_INITIALIZER;
 
-CallBackFunction    HdcpSessionManager::m_CallBack = nullptr;
-LocalClientSocket   *HdcpSessionManager::m_CallBackSocket = nullptr;
-bool                HdcpSessionManager::m_IsCallBackInitialized = false;
+static_assert(
+        SESSION_TABLE_SIZE <= CONNECTION_SESSION_MAX,
+        "the daemon does not accept that many sessions per connection!");
 
-pthread_t           HdcpSessionManager::m_SocketThread;
+LocalClientSocket   *HdcpSessionManager::m_Socket = nullptr;
+std::atomic<bool>   HdcpSessionManager::m_IsConnected(false);
 
-// Avoid starting the incrementer at 0 since some implementers might
-// initialize their data with 0.
-uint32_t            HdcpSessionManager::m_HandleIncrementor = 1;
-pthread_mutex_t     HdcpSessionManager::m_HandleIncrementorMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_t           HdcpSessionManager::m_ReceiveThread;
+pthread_mutex_t     HdcpSessionManager::m_ConnectMutex =
+                                                PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t     HdcpSessionManager::m_SendMutex =
+                                                PTHREAD_MUTEX_INITIALIZER;
 
-uint32_t            HdcpSessionManager::m_IteratorReference = 0;
-pthread_mutex_t     HdcpSessionManager::m_IteratorMutex = PTHREAD_MUTEX_INITIALIZER;
+bool                HdcpSessionManager::m_IsCallBackRunning = false;
+pthread_t           HdcpSessionManager::m_CallBackThread;
 
+bool                HdcpSessionManager::m_IsEventPending = false;
+pthread_mutex_t     HdcpSessionManager::m_EventMutex =
+                                                PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t      HdcpSessionManager::m_EventCV = PTHREAD_COND_INITIALIZER;
 
-void HdcpSessionManager::IteratorCriticalSectionEnter(void)
-{
-    HDCP_FUNCTION_ENTER;
-
-    ACQUIRE_LOCK(&m_IteratorMutex);
-    ++m_IteratorReference;
-    RELEASE_LOCK(&m_IteratorMutex);
-
-    HDCP_FUNCTION_EXIT(SUCCESS);
-}
+uint32_t            HdcpSessionManager::m_StatusVersion = STATUS_VERSION_NONE;
+PortStatusEntry     HdcpSessionManager::m_PortStatus[PORT_ID_MAX + 1] = {};
+PortList            HdcpSessionManager::m_PortList = {};
+uint32_t            HdcpSessionManager::m_PortListVersion =
+                                                STATUS_VERSION_NONE;
+pthread_mutex_t     HdcpSessionManager::m_StatusMutex =
+                                                PTHREAD_MUTEX_INITIALIZER;
 
-void HdcpSessionManager::IteratorCriticalSectionExit(void)
+void HdcpSessionManager::ReleaseSlot(SessionSlot& slot)
 {
     HDCP_FUNCTION_ENTER;
 
-    ACQUIRE_LOCK(&m_IteratorMutex);
-    --m_IteratorReference;
-
-    if (0 == m_IteratorReference)
+    if (1 != slot.references.fetch_sub(1, std::memory_order_acq_rel))
     {
-        // Destroy each session that might have been queued up for
-        // destruction while threads were iterating
-        for (auto session : m_PendingDestroyQueue)
-        {
-            delete session;
-            m_SessionList.remove(session);
-        }
-        m_PendingDestroyQueue.clear();
+        HDCP_FUNCTION_EXIT(SUCCESS);
+        return;
     }
-    RELEASE_LOCK(&m_IteratorMutex);
+
+    // That was the last reference, the session is destroyed and nobody can
+    // take a new reference on it, so free it and hand the slot back
+    slot.session->Destroy();
+    delete slot.session;
+
+    ACQUIRE_LOCK(&m_SlotMutex);
+    slot.session = nullptr;
+    RELEASE_LOCK(&m_SlotMutex);
 
     HDCP_FUNCTION_EXIT(SUCCESS);
 }
 
-uint32_t HdcpSessionManager::GetUniqueHandle(void)
+int32_t HdcpSessionManager::Connect(void)
 {
     HDCP_FUNCTION_ENTER;
 
-    uint32_t ret = BAD_SESSION_HANDLE;
-
-    ACQUIRE_LOCK(&m_HandleIncrementorMutex);
-    ret = m_HandleIncrementor++;
-    RELEASE_LOCK(&m_HandleIncrementorMutex);
-
-    HDCP_FUNCTION_EXIT(ret);
-    return ret;
-}
+    // This is a 0->1 transition but for a lost connection. Checking here is
+    // safe without a lock as long as we lock and check again before actually
+    // connecting.
+    if (m_IsConnected.load(std::memory_order_acquire))
+    {
+        return SUCCESS;
+    }
 
-int32_t HdcpSessionManager::InitCallBack(void)
-{
-    HDCP_FUNCTION_ENTER;
+    ACQUIRE_LOCK(&m_ConnectMutex);
 
-    if (m_IsCallBackInitialized)
+    if (m_IsConnected.load(std::memory_order_relaxed))
     {
-        // Thread is already launched
+        RELEASE_LOCK(&m_ConnectMutex);
         return SUCCESS;
     }
 
-    m_CallBackSocket = new (std::nothrow) LocalClientSocket;
-    if (nullptr == m_CallBackSocket)
+    LocalClientSocket *socket = new (std::nothrow) LocalClientSocket;
+    if (nullptr == socket)
     {
+        RELEASE_LOCK(&m_ConnectMutex);
         return ENOMEM;
     }
 
-    int32_t ret = m_CallBackSocket->Connect(HDCP_SDK_SOCKET_PATH);
+    int32_t ret = socket->Connect(HDCP_SDK_SOCKET_PATH);
     if (SUCCESS != ret)
     {
         HDCP_ASSERTMESSAGE("Failed to Connect!");
+        delete socket;
+        RELEASE_LOCK(&m_ConnectMutex);
         return ret;
     }
 
+    // Events for all sessions come over this same connection
     SocketData  data;
     data.Size       = sizeof(SocketData);
     data.Command    = HDCP_API_CREATE_CALLBACK;
 
-    ret = m_CallBackSocket->SendMessage(data);
+    ret = socket->SendMessage(data);
     if (SUCCESS != ret)
     {
         HDCP_ASSERTMESSAGE("SendMessage failed for creating Callback!");
+        delete socket;
+        RELEASE_LOCK(&m_ConnectMutex);
         return ret;
     }
 
-    ret = pthread_create(&m_SocketThread,
+    m_Socket = socket;
+
+    ret = pthread_create(&m_ReceiveThread,
             nullptr,
-            reinterpret_cast<void* (*)(void*)>(CallBackManager),
+            reinterpret_cast<void* (*)(void*)>(ReceiveManager),
             nullptr);
     if (0 != ret)
     {
         HDCP_ASSERTMESSAGE(
-                    "Failed to create callback handler thread! Err: %s",
+                    "Failed to create receive thread! Err: %s",
                     strerror(ret));
-        delete m_CallBackSocket;
-        m_CallBackSocket = nullptr;
-        return errno;
+        m_Socket = nullptr;
+        delete socket;
+        RELEASE_LOCK(&m_ConnectMutex);
+        return ret;
     }
 
-    m_IsCallBackInitialized = true;
+    m_IsConnected.store(true, std::memory_order_release);
 
-    HDCP_FUNCTION_EXIT(ret);
-    return ret;
+    RELEASE_LOCK(&m_ConnectMutex);
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return SUCCESS;
 }
 
-void HdcpSessionManager::DestroyCallback(void)
+LocalClientSocket *HdcpSessionManager::AcquireSocket(void)
 {
     HDCP_FUNCTION_ENTER;
 
-    ACQUIRE_LOCK(&m_IteratorMutex);
+    ACQUIRE_LOCK(&m_SendMutex);
 
-    while (!m_SessionList.empty())
+    // Once the connection is lost nothing may be sent that would wait for a
+    // response, Disconnect only fails the requests already sent
+    if (!m_IsConnected.load(std::memory_order_acquire) ||
+        (nullptr == m_Socket))
     {
-        delete m_SessionList.front();
-        m_SessionList.remove(m_SessionList.front());
+        RELEASE_LOCK(&m_SendMutex);
+        return nullptr;
     }
 
-    delete m_CallBackSocket;
-    m_CallBackSocket = nullptr;
-    m_CallBack = nullptr;
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return m_Socket;
+}
 
-    RELEASE_LOCK(&m_IteratorMutex);
+void HdcpSessionManager::ReleaseSocket(void)
+{
+    HDCP_FUNCTION_ENTER;
 
-    // REVIEW: pthread_join here for callback thread?
-    //pthread_join(m_SocketThread, nullptr);
+    RELEASE_LOCK(&m_SendMutex);
 
     HDCP_FUNCTION_EXIT(SUCCESS);
 }
 
-uint32_t HdcpSessionManager::CreateSession(
-                                const CallBackFunction func,
-                                const Context ctx)
+void HdcpSessionManager::Disconnect(void)
 {
     HDCP_FUNCTION_ENTER;
 
-    uint32_t handle = GetUniqueHandle();
+    // A session created meanwhile waits here to connect again
+    ACQUIRE_LOCK(&m_ConnectMutex);
 
-    // Check if the call back has been created
-    // This is a 0->1 _ONLY_ transition. Checking here is safe without
-    // a lock as long as we are guaranteed to lock and check state before
-    // actually initializing.
-    if (!m_IsCallBackInitialized)
+    m_IsConnected.store(false, std::memory_order_release);
+
+    ClearStatusCache();
+
+    // Every request sent so far belongs to a session in the table, possibly
+    // one already destroyed. Fail them, which also lets a sender holding the
+    // socket go, and drop the reference each open session holds; sessions
+    // still in use are freed when their last caller puts them.
+    for (auto& slot : m_Slots)
     {
-        ACQUIRE_LOCK(&m_HandleIncrementorMutex);
-        int32_t sts = InitCallBack();
-        RELEASE_LOCK(&m_HandleIncrementorMutex);
+        HdcpSession *session = ReferenceSlot(slot);
+        if (nullptr == session)
+        {
+            continue;
+        }
 
-        if (SUCCESS != sts)
+        // Read while referenced, the slot may be reused once released
+        uint32_t handle = slot.handle.load(std::memory_order_acquire);
+
+        session->Disconnect();
+        ReleaseSlot(slot);
+
+        DestroySession(handle);
+    }
+
+    ACQUIRE_LOCK(&m_SendMutex);
+    delete m_Socket;
+    m_Socket = nullptr;
+    RELEASE_LOCK(&m_SendMutex);
+
+    RELEASE_LOCK(&m_ConnectMutex);
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
+
+bool HdcpSessionManager::GetCachedStatus(
+                            const uint32_t portId,
+                            PORT_STATUS *portStatus)
+{
+    HDCP_FUNCTION_ENTER;
+
+    if ((nullptr == portStatus) || (portId > PORT_ID_MAX))
+    {
+        return false;
+    }
+
+    bool isCached = false;
+
+    ACQUIRE_LOCK(&m_StatusMutex);
+    const PortStatusEntry& entry = m_PortStatus[portId];
+    if ((STATUS_VERSION_NONE != entry.version) &&
+        (m_StatusVersion == entry.version) &&
+        (0 == (entry.status & PORT_STATUS_HDCP_ENABLED_MASK)))
+    {
+        *portStatus = entry.status;
+        isCached    = true;
+    }
+    RELEASE_LOCK(&m_StatusMutex);
+
+    HDCP_FUNCTION_EXIT(isCached);
+    return isCached;
+}
+
+bool HdcpSessionManager::GetCachedPortList(PortList *portList)
+{
+    HDCP_FUNCTION_ENTER;
+
+    if (nullptr == portList)
+    {
+        return false;
+    }
+
+    bool isCached = false;
+
+    ACQUIRE_LOCK(&m_StatusMutex);
+    if ((STATUS_VERSION_NONE != m_PortListVersion) &&
+        (m_StatusVersion == m_PortListVersion))
+    {
+        isCached = true;
+        for (uint32_t i = 0; i < m_PortList.PortCount; ++i)
+        {
+            if (0 != (m_PortList.Ports[i].status &
+                        PORT_STATUS_HDCP_ENABLED_MASK))
+            {
+                isCached = false;
+                break;
+            }
+        }
+        if (isCached)
         {
-            HDCP_ASSERTMESSAGE("Failed to init callback when first create!");
-            return BAD_SESSION_HANDLE;
+            *portList = m_PortList;
         }
     }
+    RELEASE_LOCK(&m_StatusMutex);
 
-    HdcpSession *session = new (std::nothrow) HdcpSession(handle, func, ctx);
-    if (nullptr == session)
+    HDCP_FUNCTION_EXIT(isCached);
+    return isCached;
+}
+
+void HdcpSessionManager::UpdateStatusCache(const SocketData& data)
+{
+    HDCP_FUNCTION_ENTER;
+
+    // Only status responses and reports are stamped
+    if (STATUS_VERSION_NONE == data.StatusVersion)
+    {
+        return;
+    }
+
+    ACQUIRE_LOCK(&m_StatusMutex);
+
+    // A response may have been stamped before a change that was reported
+    // ahead of it, so only ever move forward. Everything cached at an older
+    // version is stale from here on.
+    if ((STATUS_VERSION_NONE == m_StatusVersion) ||
+        (static_cast<int32_t>(data.StatusVersion - m_StatusVersion) > 0))
+    {
+        m_StatusVersion = data.StatusVersion;
+    }
+
+    if (HDCP_STATUS_SUCCESSFUL == data.Status)
+    {
+        if (((HDCP_API_GETSTATUS == data.Command)       ||
+            (HDCP_API_WAIT_STATUS == data.Command))     &&
+            (ONE_PORT == data.PortCount)                &&
+            (data.SinglePort.Id <= PORT_ID_MAX))
+        {
+            PortStatusEntry& entry = m_PortStatus[data.SinglePort.Id];
+            entry.status    = data.SinglePort.status;
+            entry.version   = data.StatusVersion;
+        }
+        else if ((HDCP_API_ENUMERATE_HDCP_DISPLAY == data.Command) &&
+                (data.PortCount <= NUM_PHYSICAL_PORTS_MAX))
+        {
+            m_PortList.PortCount = data.PortCount;
+            for (uint32_t i = 0; i < data.PortCount; ++i)
+            {
+                m_PortList.Ports[i].Id      = data.Ports[i].Id;
+                m_PortList.Ports[i].status  = data.Ports[i].status;
+            }
+            m_PortListVersion = data.StatusVersion;
+        }
+    }
+
+    // A batch can fail as a whole and still carry good status for some ports
+    if ((HDCP_API_GETSTATUS_BATCH == data.Command) &&
+        (data.PortCount <= NUM_PHYSICAL_PORTS_MAX))
+    {
+        for (uint32_t i = 0; i < data.PortCount; ++i)
+        {
+            if ((HDCP_STATUS_SUCCESSFUL == data.PortResults[i]) &&
+                (data.Ports[i].Id <= PORT_ID_MAX))
+            {
+                PortStatusEntry& entry = m_PortStatus[data.Ports[i].Id];
+                entry.status    = data.Ports[i].status;
+                entry.version   = data.StatusVersion;
+            }
+        }
+    }
+
+    RELEASE_LOCK(&m_StatusMutex);
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
+
+void HdcpSessionManager::ClearStatusCache(void)
+{
+    HDCP_FUNCTION_ENTER;
+
+    ACQUIRE_LOCK(&m_StatusMutex);
+    m_StatusVersion     = STATUS_VERSION_NONE;
+    m_PortListVersion   = STATUS_VERSION_NONE;
+    for (auto& entry : m_PortStatus)
     {
-        return BAD_SESSION_HANDLE;
+        entry.version = STATUS_VERSION_NONE;
     }
+    RELEASE_LOCK(&m_StatusMutex);
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
+
+uint32_t HdcpSessionManager::CreateSession(
+                                const CallBackFunction func,
+                                const Context ctx)
+{
+    HDCP_FUNCTION_ENTER;
+
+    uint32_t handle = BAD_SESSION_HANDLE;
 
-    if (!session->IsValid())
+    ACQUIRE_LOCK(&m_SlotMutex);
+
+    for (uint32_t index = 0; index < SESSION_TABLE_SIZE; ++index)
     {
-        delete session;
-        return BAD_SESSION_HANDLE;
+        SessionSlot& slot = m_Slots[index];
+        if (nullptr != slot.session)
+        {
+            continue;
+        }
+
+        uint32_t generation = slot.generation + 1;
+        if (generation > SESSION_GENERATION_MAX)
+        {
+            generation = 1;
+        }
+
+        uint32_t newHandle = (generation << SESSION_INDEX_BITS) | index;
+
+        HdcpSession *session =
+                new (std::nothrow) HdcpSession(newHandle, func, ctx);
+        if (nullptr == session)
+        {
+            break;
+        }
+
+        if (!session->IsValid())
+        {
+            delete session;
+            break;
+        }
+
+        slot.generation = generation;
+        slot.session    = session;
+        slot.handle.store(newHandle, std::memory_order_relaxed);
+
+        // Publishing the open reference makes the slot visible to lookups
+        slot.references.store(1, std::memory_order_release);
+
+        handle = newHandle;
+        break;
     }
 
-    ACQUIRE_LOCK(&m_IteratorMutex);
-    m_SessionList.push_front(session);
-    RELEASE_LOCK(&m_IteratorMutex);
+    RELEASE_LOCK(&m_SlotMutex);
+
+    if (BAD_SESSION_HANDLE == handle)
+    {
+        HDCP_ASSERTMESSAGE("Failed to allocate a session!");
+    }
 
     HDCP_FUNCTION_EXIT(handle);
     return handle;
@@ -234,153 +450,313 @@ void HdcpSessionManager::DestroySession(const uint32_t handle)
 {
     HDCP_FUNCTION_ENTER;
 
-    HdcpSession* session = nullptr;
+    if ((0 == handle) || (BAD_SESSION_HANDLE == handle))
+    {
+        return;
+    }
+
+    SessionSlot& slot = m_Slots[handle & SESSION_INDEX_MASK];
 
-    ACQUIRE_LOCK(&m_IteratorMutex);
+    // Only one caller can retire a handle, and lookups fail from here on
+    uint32_t expected = handle;
+    if (slot.handle.compare_exchange_strong(
+                                    expected,
+                                    0,
+                                    std::memory_order_acq_rel))
+    {
+        ReleaseSlot(slot);
+    }
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
+
+HdcpSession *HdcpSessionManager::ReferenceSlot(SessionSlot& slot)
+{
+    HDCP_FUNCTION_ENTER;
 
-    for (auto tempSession : m_SessionList)
+    // Take a reference unless the slot is already free, so the session
+    // cannot be deleted under us while we check it
+    uint32_t references = slot.references.load(std::memory_order_relaxed);
+    do
     {
-        if (handle == tempSession->GetHandle())
+        if (0 == references)
         {
-            session = tempSession;
-            break;
+            return nullptr;
         }
+    } while (!slot.references.compare_exchange_weak(
+                                    references,
+                                    references + 1,
+                                    std::memory_order_acquire,
+                                    std::memory_order_relaxed));
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return slot.session;
+}
+
+HdcpSession* HdcpSessionManager::GetInstance(const uint32_t handle)
+{
+    HDCP_FUNCTION_ENTER;
+
+    // A destroyed slot holds handle 0 until its last reference is put
+    if ((0 == handle) || (BAD_SESSION_HANDLE == handle))
+    {
+        return nullptr;
+    }
+
+    SessionSlot& slot = m_Slots[handle & SESSION_INDEX_MASK];
+    if (nullptr == ReferenceSlot(slot))
+    {
+        return nullptr;
+    }
+
+    if (handle != slot.handle.load(std::memory_order_acquire))
+    {
+        // Stale handle or a session that is being destroyed
+        ReleaseSlot(slot);
+        return nullptr;
+    }
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return slot.session;
+}
+
+HdcpSession *HdcpSessionManager::GetPendingInstance(const uint32_t handle)
+{
+    HDCP_FUNCTION_ENTER;
+
+    if ((0 == handle) || (BAD_SESSION_HANDLE == handle))
+    {
+        return nullptr;
+    }
+
+    uint32_t index      = handle & SESSION_INDEX_MASK;
+    SessionSlot& slot   = m_Slots[index];
+    if (nullptr == ReferenceSlot(slot))
+    {
+        return nullptr;
+    }
+
+    // The generation of a referenced slot can't change anymore
+    if (handle != ((slot.generation << SESSION_INDEX_BITS) | index))
+    {
+        ReleaseSlot(slot);
+        return nullptr;
     }
 
-    if (nullptr != session)
+    HDCP_FUNCTION_EXIT(SUCCESS);
+    return slot.session;
+}
+
+void HdcpSessionManager::PutInstance(const uint32_t handle)
+{
+    HDCP_FUNCTION_ENTER;
+
+    ReleaseSlot(m_Slots[handle & SESSION_INDEX_MASK]);
+
+    HDCP_FUNCTION_EXIT(SUCCESS);
+}
+
+void HdcpSessionManager::DeliverResponse(SocketData& data)
+{
+    HDCP_FUNCTION_ENTER;
+
+    HdcpSession *session = GetPendingInstance(data.SessionId);
+
+    // A successful GetKsvList response is followed by the list itself
+    if ((HDCP_API_GETKSVLIST == data.Command)           &&
+        (HDCP_STATUS_SUCCESSFUL == data.Status)         &&
+        (data.KsvCount > 0))
     {
-        if (m_IteratorReference > 0)
+        uint8_t discard[MAX_KSV_COUNT * KSV_SIZE];
+        uint8_t *ksvList = nullptr;
+
+        if (nullptr != session)
         {
-            m_PendingDestroyQueue.push_back(session);
+            ksvList = session->GetKsvListBuffer();
         }
-        else
+
+        if (nullptr == ksvList)
         {
-            // It is safe to manipulate the list memory, so free it now
-            delete session;
-            m_SessionList.remove(session);
+            ksvList = discard;
         }
+
+        int32_t sts = m_Socket->ReceiveKsvList(ksvList, data.KsvCount);
+        if (SUCCESS != sts)
+        {
+            HDCP_ASSERTMESSAGE("Failed to receive ksv list from daemon!");
+            data.Status = HDCP_STATUS_ERROR_MSG_TRANSACTION;
+        }
+    }
+
+    if (nullptr == session)
+    {
+        HDCP_WARNMESSAGE(
+                "Dropped a response for unknown session 0x%x",
+                data.SessionId);
+        return;
     }
 
-    RELEASE_LOCK(&m_IteratorMutex);
+    session->DeliverResponse(data);
+    PutInstance(data.SessionId);
 
     HDCP_FUNCTION_EXIT(SUCCESS);
 }
 
-HdcpSession* HdcpSessionManager::GetInstance(const uint32_t handle)
+void HdcpSessionManager::ReportStatus(const SocketData& data)
 {
     HDCP_FUNCTION_ENTER;
 
-    HdcpSession* session = nullptr;
+    bool isCallBackEvent = false;
 
-    IteratorCriticalSectionEnter();
-    for (auto tempSession : m_SessionList)
+    // Queue the event for each session handle we have.
+    // A session destroyed meanwhile simply fails the lookup.
+    for (auto& slot : m_Slots)
     {
-        if (handle == tempSession->GetHandle())
+        uint32_t handle = slot.handle.load(std::memory_order_acquire);
+        if (0 == handle)
         {
-            session = tempSession;
-            break;
+            continue;
+        }
+
+        HdcpSession *session = GetInstance(handle);
+        if (nullptr == session)
+        {
+            continue;
+        }
+
+        if (session->QueueEvent(data.SinglePort.Id, data.SinglePort.Event))
+        {
+            isCallBackEvent = true;
         }
+        PutInstance(handle);
     }
 
-    if (nullptr == session)
+    // Apps that dispatch all events themselves never need the thread
+    if (!isCallBackEvent)
     {
-        IteratorCriticalSectionExit();
-        return nullptr;
+        HDCP_FUNCTION_EXIT(SUCCESS);
+        return;
     }
 
-    // Check if the handle has been added to the destroy queue
-    // This isn't critical for thread safety, it is just an attempt
-    // to improve QoS slightly.
-    // No elements of the destroy queue could be deleted as long as
-    // this thread holds a reference to the iterator CS, so there
-    // is no data race around that list.
-    for (auto tempSession : m_PendingDestroyQueue)
+    ACQUIRE_LOCK(&m_EventMutex);
+
+    if (!m_IsCallBackRunning)
     {
-        if (tempSession == session)
+        int32_t ret = pthread_create(&m_CallBackThread,
+                nullptr,
+                reinterpret_cast<void* (*)(void*)>(CallBackManager),
+                nullptr);
+        if (0 != ret)
         {
-            IteratorCriticalSectionExit();
-            return nullptr;
+            // The events stay queued for the next attempt
+            RELEASE_LOCK(&m_EventMutex);
+            HDCP_ASSERTMESSAGE(
+                        "Failed to create callback handler thread! Err: %s",
+                        strerror(ret));
+            return;
         }
+
+        m_IsCallBackRunning = true;
     }
 
-    // We found the session and it is not queued up for removal
-    session->IncreaseReference();
+    m_IsEventPending = true;
+    pthread_cond_signal(&m_EventCV);
+    RELEASE_LOCK(&m_EventMutex);
 
-    IteratorCriticalSectionExit();
     HDCP_FUNCTION_EXIT(SUCCESS);
-    return session;
 }
 
-void HdcpSessionManager::PutInstance(const uint32_t handle)
+void *HdcpSessionManager::CallBackManager(void *dummy)
 {
     HDCP_FUNCTION_ENTER;
 
-    IteratorCriticalSectionEnter();
-    for (auto session : m_SessionList)
+    // Nobody waits for this thread, it serves the process until it exits
+    pthread_detach(pthread_self());
+
+    while (true)
     {
-        if (handle == session->GetHandle())
+        ACQUIRE_LOCK(&m_EventMutex);
+        while (!m_IsEventPending)
         {
-            session->DecreaseReference();
-            break;
+            WAIT_CV(&m_EventCV, &m_EventMutex);
+        }
+        m_IsEventPending = false;
+        RELEASE_LOCK(&m_EventMutex);
+
+        // Execute the callback function for each session handle we have
+        for (auto& slot : m_Slots)
+        {
+            uint32_t handle = slot.handle.load(std::memory_order_acquire);
+            if (0 == handle)
+            {
+                continue;
+            }
+
+            HdcpSession *session = GetInstance(handle);
+            if (nullptr == session)
+            {
+                continue;
+            }
+
+            session->DispatchEvents(true);
+            PutInstance(handle);
         }
     }
-    IteratorCriticalSectionExit();
 
     HDCP_FUNCTION_EXIT(SUCCESS);
+    return nullptr;
 }
 
-void *HdcpSessionManager::CallBackManager(void *dummy)
+void *HdcpSessionManager::ReceiveManager(void *dummy)
 {
     HDCP_FUNCTION_ENTER;
 
     SocketData  data;
     int32_t     sts = EINVAL;
 
+    // Nobody waits for this thread, it ends with its connection
+    pthread_detach(pthread_self());
+
     while (true)
     {
         data = {};
 
-        sts = m_CallBackSocket->GetMessage(data);
+        // Only this thread replaces the socket once connected
+        sts = m_Socket->GetMessage(data);
         if (SUCCESS != sts)
         {
             if (ENOTCONN == sts)
             {
                 // The connection has disconnected and we should exit
-                DestroyCallback(); 
+                Disconnect();
                 break;
             }
 
-            HDCP_ASSERTMESSAGE("GetMessage failed on callback socket!");
+            HDCP_ASSERTMESSAGE("GetMessage failed on daemon socket!");
             continue;
         }
 
         if (data.Size != sizeof(data))
         {
             HDCP_ASSERTMESSAGE(
-                "Received a message with invalid size %d on callback socket!",
+                "Received a message with invalid size %d on daemon socket!",
                 data.Size);
             continue;
         }
 
-        if (HDCP_API_REPORTSTATUS != data.Command)
-        {
-            HDCP_WARNMESSAGE("Received an unknown request on callback socket!");
-            continue;
-        }
+        UpdateStatusCache(data);
 
-        // Execute the callback function for each session handle we have
-        IteratorCriticalSectionEnter();
-        for (auto session : m_SessionList)
+        if (HDCP_API_REPORTSTATUS == data.Command)
         {
-            if (nullptr != session->GetCallBackFunction())
+            // A change without an event only invalidates the status cache
+            if (PORT_EVENT_NONE != data.SinglePort.Event)
             {
-                (session->GetCallBackFunction())(session->GetHandle(),
-                                        data.SinglePort.Id,
-                                        data.SinglePort.Event,
-                                        session->GetContext());
+                ReportStatus(data);
             }
+            continue;
         }
-        IteratorCriticalSectionExit();
+
+        DeliverResponse(data);
     }
 
     HDCP_FUNCTION_EXIT(SUCCESS);
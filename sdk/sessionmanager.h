@@ -27,15 +27,56 @@
 #ifndef __HDCP_SESSIONMANAGER_H__
 #define __HDCP_SESSIONMANAGER_H__
 
-#include <forward_list>
-#include <list>
+#include <atomic>
 #include <pthread.h>
 
 #include "hdcpdef.h"
+#include "clientsock.h"
 #include "session.h"
 
 #define BAD_SESSION_HANDLE ((uint32_t)-1)
 
+// A handle is the index of its slot in the session table in the low bits and
+// the generation of the slot in the high bits, so a stale handle never finds
+// the session that reused its slot.
+// Handles double as the session ids on the daemon connection, so the table
+// can't hold more sessions than the daemon accepts per connection.
+#define SESSION_INDEX_BITS      5
+#define SESSION_TABLE_SIZE      (1 << SESSION_INDEX_BITS)
+#define SESSION_INDEX_MASK      (SESSION_TABLE_SIZE - 1)
+
+// Generations wrap before all their bits are set, so no handle is ever
+// BAD_SESSION_HANDLE, and start at 1, so no handle is ever 0
+#define SESSION_GENERATION_MAX  ((1u << (32 - SESSION_INDEX_BITS)) - 1)
+
+typedef struct _SessionSlot
+{
+    // Handle of the session in the slot, 0 once the session is destroyed
+    std::atomic<uint32_t>   handle;
+
+    // References taken by GetInstance, plus one held from CreateSession to
+    // DestroySession. The session is deleted when this drops to 0.
+    std::atomic<uint32_t>   references;
+
+    // Only changed under m_SlotMutex while references is 0
+    HdcpSession             *session;
+    uint32_t                generation;
+} SessionSlot;
+
+// The daemon reads the encryption bits live from the kernel, which can drop
+// encryption without a state change ever being reported. They are never
+// served from the cache.
+#define PORT_STATUS_HDCP_ENABLED_MASK   (PORT_STATUS_HDCP_TYPE0_ENABLED | \
+                                        PORT_STATUS_HDCP_TYPE1_ENABLED)
+
+// Status of a port as last answered by the daemon, only good as long as the
+// daemon reports no change after the version it was answered at
+typedef struct _PortStatusEntry
+{
+    PORT_STATUS             status;
+    uint32_t                version;
+} PortStatusEntry;
+
 class HdcpSessionManager
 {
 public:
@@ -53,6 +94,7 @@ public:
     /// can connect to the daemon).
     /// This handle is only meaningful within the context of the process, so
     /// there should be no reason to add obscurity to it.
+    /// The session does not talk to the daemon yet, see HdcpSession::Create.
     /// There are two situations to consider:
     /// 1) The sdk is a static library:
     ///     The sdk exists entirely within a process's address space. Every
@@ -75,6 +117,9 @@ public:
     ///
     /// \param[in]  handle      Handle associated with this session
     /// \return     None
+    ///
+    /// The handle stops resolving immediately; the session itself is deleted
+    /// once any thread still using it calls PutInstance.
     ///////////////////////////////////////////////////////////////////////////
     static void DestroySession(const uint32_t handle);
 
@@ -82,9 +127,12 @@ public:
     /// \brief  Get a reference to the session associated with the handle
     ///
     /// \param[in]  handle      Handle associated with this session
-    /// \return     HdcpSession allocated for that Handle
+    /// \return     HdcpSession allocated for that Handle, or nullptr if the
+    ///             handle is unknown or destroyed
     ///
-    /// Note, this does not address synchronization over the session map.
+    /// This never locks: it indexes the slot with the handle and takes a
+    /// reference with a compare-and-swap. The session stays alive until the
+    /// matching PutInstance.
     ///////////////////////////////////////////////////////////////////////////
     static HdcpSession* GetInstance(const uint32_t handle);
 
@@ -94,34 +142,65 @@ public:
     /// \param[in]  handle      Handle associated with this session
     /// \return     None
     ///
-    /// Note, this does not address synchronization over the session map.
+    /// Must match a successful GetInstance. Releasing the last reference of a
+    /// destroyed session deletes it.
     ///////////////////////////////////////////////////////////////////////////
     static void PutInstance(const uint32_t handle);
 
     ///////////////////////////////////////////////////////////////////////////
-    /// \brief  Initialize the callback thread and socket connection
+    /// \brief  Connect the process to the daemon unless it is already
     ///
     /// \return     SUCCESS or errno otherwise
+    ///
+    /// All sessions of the process share a single connection, which carries
+    /// their requests and responses tagged with the session handle, as well as
+    /// the events for all of them. Only the first call makes any syscalls.
     ///////////////////////////////////////////////////////////////////////////
-    static int32_t InitCallBack(void);
+    static int32_t Connect(void);
 
     ///////////////////////////////////////////////////////////////////////////
-    /// \brief  Destroy the callback thread and socket; release any sessions
+    /// \brief  Get exclusive use of the connection for sending
     ///
-    /// \return     Nothing
+    /// \return     Socket of the connection, or nullptr if there is none
+    ///
+    /// Must be matched by ReleaseSocket unless it returns nullptr. Responses
+    /// are still delivered while a caller holds the socket.
     ///////////////////////////////////////////////////////////////////////////
-    static void DestroyCallback(void);
+    static LocalClientSocket *AcquireSocket(void);
 
     ///////////////////////////////////////////////////////////////////////////
-    /// \brief  Main function of the callback thread
+    /// \brief  Give up the use of the connection for sending
     ///
-    /// \param[in]  pData   Not used, but required for pthread_create
     /// \return     Nothing
+    ///////////////////////////////////////////////////////////////////////////
+    static void ReleaseSocket(void);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Get the status of a port without asking the daemon
+    ///
+    /// \param[in]  portId      Port to get the status of
+    /// \param[out] portStatus  Status of the port
+    /// \return     true if the status is cached and still current, false if
+    ///             the daemon has to be asked
     ///
-    /// There is one callback thread per process. It will iterative over all
-    /// open sessions and execute the provided callback function for each one.
+    /// The cache is shared by all sessions of the process. It is filled from
+    /// the status responses and dropped as a whole as soon as the daemon
+    /// reports any change of a port status, with or without an event. A
+    /// status with HDCP enabled is never cached, see
+    /// PORT_STATUS_HDCP_ENABLED_MASK.
     ///////////////////////////////////////////////////////////////////////////
-    static void *CallBackManager(void *pData);
+    static bool GetCachedStatus(const uint32_t portId, PORT_STATUS *portStatus);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Get the port list without asking the daemon
+    ///
+    /// \param[out] portList    List of the ports
+    /// \return     true if the list is cached and still current, false if
+    ///             the daemon has to be asked
+    ///
+    /// Follows the same rules as GetCachedStatus.
+    ///////////////////////////////////////////////////////////////////////////
+    static bool GetCachedPortList(PortList *portList);
 
 private:
     HdcpSessionManager();
@@ -129,56 +208,144 @@ private:
     HdcpSessionManager& operator=(HdcpSessionManager&);
 
     ///////////////////////////////////////////////////////////////////////////
-    /// \brief  Get a new handle for a new session
+    /// \brief  Drop a reference on a slot, freeing it with the last one
+    ///
+    /// \param[in]  slot    slot to release
+    /// \return     Nothing
+    ///////////////////////////////////////////////////////////////////////////
+    static void ReleaseSlot(SessionSlot& slot);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Take a reference on a slot unless it is free
+    ///
+    /// \param[in]  slot    slot to reference
+    /// \return     Session in the slot, or nullptr if the slot is free
+    ///
+    /// The session may already be destroyed. A returned session must be
+    /// released with ReleaseSlot.
+    ///////////////////////////////////////////////////////////////////////////
+    static HdcpSession *ReferenceSlot(SessionSlot& slot);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Get a reference to the session a response is tagged with
+    ///
+    /// \param[in]  handle      Handle associated with this session
+    /// \return     HdcpSession allocated for that Handle, or nullptr if it
+    ///             was deleted
+    ///
+    /// Unlike GetInstance this also finds a session that was destroyed while
+    /// one of its requests was in flight, the caller still waits for the
+    /// response. Must be matched by PutInstance.
+    ///////////////////////////////////////////////////////////////////////////
+    static HdcpSession *GetPendingInstance(const uint32_t handle);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Tear down the connection after the daemon closed it
+    ///
+    /// \return     Nothing
     ///
-    /// \return     Unique handle
+    /// Fails the requests in flight and destroys every session, the next
+    /// session created connects again.
     ///////////////////////////////////////////////////////////////////////////
-    static uint32_t GetUniqueHandle(void);
+    static void Disconnect(void);
 
     ///////////////////////////////////////////////////////////////////////////
-    /// \brief  Synchronize manipulation or iteration over the session map
+    /// \brief  Main function of the receive thread
     ///
+    /// \param[in]  pData   Not used, but required for pthread_create
     /// \return     Nothing
     ///
-    /// New addtions to the map will be blocked while any thread is iterating.
-    /// Session removal will be queued in a garbage list until no threads are
-    /// iterating.
-    /// Attempts to look up sessions that have been moved to the garbage list
-    /// will return "not found."
+    /// There is one receive thread per connection. It hands each response to
+    /// the session it is tagged with, and queues each event for every open
+    /// session.
     ///////////////////////////////////////////////////////////////////////////
-    static void IteratorCriticalSectionEnter(void);
+    static void *ReceiveManager(void *pData);
 
     ///////////////////////////////////////////////////////////////////////////
-    /// \brief  Synchronize manipulation or iteration over the session map
+    /// \brief  Main function of the callback thread
     ///
+    /// \param[in]  pData   Not used, but required for pthread_create
     /// \return     Nothing
     ///
-    /// New addtions to the map will be blocked while any thread is iterating.
-    /// Session removal will be queued in a garbage list until no threads are
-    /// iterating.
-    /// When the last active critical section reference is done, any sessions
-    /// in the garbage list will finally be removed from the session map.
+    /// There is one callback thread per process, started for the first event
+    /// of a session without an event fd. It executes the callback functions
+    /// for the queued events, off the receive thread so that they can call
+    /// the API again.
     ///////////////////////////////////////////////////////////////////////////
-    static void IteratorCriticalSectionExit(void);
+    static void *CallBackManager(void *pData);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Hand a response over to the session waiting for it
+    ///
+    /// \param[in]  data    Response received from the daemon
+    /// \return     Nothing
+    ///
+    /// Also receives the data some responses are followed by, even when the
+    /// session is gone, to stay in sync with the connection.
+    ///////////////////////////////////////////////////////////////////////////
+    static void DeliverResponse(SocketData& data);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Queue an event for every open session, and wake the callback
+    ///         thread for the sessions without an event fd
+    ///
+    /// \param[in]  data    Event received from the daemon
+    /// \return     Nothing
+    ///////////////////////////////////////////////////////////////////////////
+    static void ReportStatus(const SocketData& data);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Keep the status cache up to date with a message received from
+    ///         the daemon
+    ///
+    /// \param[in]  data    Response or event received from the daemon
+    /// \return     Nothing
+    ///
+    /// Must see every message in the order the daemon sent them, so it only
+    /// runs on the receive thread.
+    ///////////////////////////////////////////////////////////////////////////
+    static void UpdateStatusCache(const SocketData& data);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Drop everything cached from the current connection
+    ///
+    /// \return     Nothing
+    ///
+    /// The versions of another connection, even to a restarted daemon, have
+    /// nothing to do with those seen so far.
+    ///////////////////////////////////////////////////////////////////////////
+    static void ClearStatusCache(void);
 
     // Declare member variables
 private:
-    static std::forward_list<HdcpSession*>  m_SessionList;
-
-    static CallBackFunction                 m_CallBack;
-    static LocalClientSocket                *m_CallBackSocket;
-    static bool                             m_IsCallBackInitialized;
-    static pthread_t                        m_SocketThread;
-
-    // This does not tell the number of active sessions, it is just used to
-    // prevent sessions from overlapping.
-    static uint32_t                         m_HandleIncrementor;
-    static pthread_mutex_t                  m_HandleIncrementorMutex;
-
-    static pthread_mutex_t                  m_IteratorMutex;
-    static uint32_t                         m_IteratorReference;
-    
-    static std::list<HdcpSession*>          m_PendingDestroyQueue;
+    static SessionSlot                      m_Slots[SESSION_TABLE_SIZE];
+
+    // Serializes claiming and freeing slots, never taken by lookups
+    static pthread_mutex_t                  m_SlotMutex;
+
+    // Only replaced by Connect and Disconnect, which are serialized by
+    // m_ConnectMutex; only written to under m_SendMutex
+    static LocalClientSocket                *m_Socket;
+    static std::atomic<bool>                m_IsConnected;
+    static pthread_t                        m_ReceiveThread;
+    static pthread_mutex_t                  m_ConnectMutex;
+    static pthread_mutex_t                  m_SendMutex;
+
+    // Wakes the callback thread when events were queued, and guards starting
+    // it on demand
+    static bool                             m_IsCallBackRunning;
+    static pthread_t                        m_CallBackThread;
+    static bool                             m_IsEventPending;
+    static pthread_mutex_t                  m_EventMutex;
+    static pthread_cond_t                   m_EventCV;
+
+    // Latest status version the daemon reported on the connection and what
+    // was cached at which version, all guarded by m_StatusMutex
+    static uint32_t                         m_StatusVersion;
+    static PortStatusEntry                  m_PortStatus[PORT_ID_MAX + 1];
+    static PortList                         m_PortList;
+    static uint32_t                         m_PortListVersion;
+    static pthread_mutex_t                  m_StatusMutex;
 };
 
 #endif // __HDCP_SESSIONMANAGER_H__